@@ -0,0 +1,991 @@
+#include "stdafx.h"
+
+#include "SpehsEngine/Core/CoreLib.h"
+#include "SpehsEngine/Core/WriteBuffer.h"
+#include "SpehsEngine/Core/ReadBuffer.h"
+#include "SpehsEngine/Core/StringOperations.h"
+#include "SpehsEngine/Core/StringUtilityFunctions.h"
+#include "SpehsEngine/Net/NetLib.h"
+#include "SpehsEngine/Net/ConnectionManager.h"
+#include "SpehsEngine/Net/ConnectionManager2.h"
+#include "SpehsEngine/Net/IOService.h"
+#include "Sandbox/ArraySerialization.h"
+#include "Sandbox/CongestionController.h"
+#include "Sandbox/LinkEmulator.h"
+#include "Sandbox/MessageStream.h"
+#include "Sandbox/TypelessMessageRouter.h"
+#include "NetBench/Report.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string.h>
+#include <thread>
+
+
+namespace
+{
+	enum class Side
+	{
+		Server,
+		Client,
+	};
+
+	typedef std::function<void(se::ReadBuffer&, const bool reliable)> ReceiveHandler;
+
+	/*
+		Both ends of a loopback connection, owned and updated by the same thread.
+		Running both ends in one process keeps runs reproducible and lets the receiver compare send timestamps directly.
+	*/
+	class Transport
+	{
+	public:
+		virtual ~Transport() = default;
+		virtual const char* getName() const = 0;
+		virtual bool start(const se::net::Port port) = 0;
+		virtual void update() = 0;
+		virtual bool isConnected() const = 0;
+		// Sends from the given side to the other side
+		virtual void send(const Side from, const se::WriteBuffer& writeBuffer, const bool reliable) = 0;
+		// Set before start()
+		virtual void setReceiveHandler(const Side receiver, const ReceiveHandler& receiveHandler) = 0;
+		// Reliable resends so far, -1 if the connection does not expose them. Connection2 does not.
+		virtual int64_t getRetransmits() const
+		{
+			return -1;
+		}
+	};
+
+	class ConnectionManagerTransport : public Transport
+	{
+	public:
+
+		ConnectionManagerTransport(const float loss)
+			: serverManager(ioService, "netbench server")
+			, clientManager(ioService, "netbench client")
+		{
+			if (loss > 0.0f)
+			{
+				se::net::ConnectionSimulationSettings connectionSimulationSettings;
+				connectionSimulationSettings.maximumSegmentSizeIncoming = 1500;
+				connectionSimulationSettings.maximumSegmentSizeOutgoing = 1500;
+				connectionSimulationSettings.chanceToDropIncoming = loss;
+				connectionSimulationSettings.chanceToDropOutgoing = loss;
+				serverManager.setDefaultConnectionSimulationSettings(connectionSimulationSettings);
+				clientManager.setDefaultConnectionSimulationSettings(connectionSimulationSettings);
+			}
+		}
+
+		const char* getName() const override
+		{
+			return "ConnectionManager";
+		}
+
+		bool start(const se::net::Port port) override
+		{
+			serverManager.connectToIncomingConnectionSignal(incomingConnection, [this](std::shared_ptr<se::net::Connection>& connection)
+				{
+					serverConnection = connection;
+					serverConnection->setReceiveHandler([this](se::ReadBuffer& readBuffer, const boost::asio::ip::udp::endpoint&, const bool reliable)
+						{
+							serverReceiveHandler(readBuffer, reliable);
+						});
+				});
+			serverManager.bind(port);
+			serverManager.startAccepting();
+			clientManager.bind();
+			clientConnection = clientManager.startConnecting(se::net::Endpoint(se::net::Address("127.0.0.1"), port));
+			return bool(clientConnection);
+		}
+
+		void update() override
+		{
+			serverManager.update();
+			clientManager.update();
+			if (!clientReceiveHandlerSet && clientConnection && clientConnection->getStatus() == se::net::Connection::Status::Connected)
+			{
+				clientConnection->setReceiveHandler([this](se::ReadBuffer& readBuffer, const boost::asio::ip::udp::endpoint&, const bool reliable)
+					{
+						clientReceiveHandler(readBuffer, reliable);
+					});
+				clientReceiveHandlerSet = true;
+			}
+		}
+
+		bool isConnected() const override
+		{
+			return serverConnection && clientReceiveHandlerSet && clientConnection->getStatus() == se::net::Connection::Status::Connected;
+		}
+
+		void send(const Side from, const se::WriteBuffer& writeBuffer, const bool reliable) override
+		{
+			(from == Side::Server ? serverConnection : clientConnection)->sendPacket(writeBuffer, reliable);
+		}
+
+		void setReceiveHandler(const Side receiver, const ReceiveHandler& receiveHandler) override
+		{
+			(receiver == Side::Server ? serverReceiveHandler : clientReceiveHandler) = receiveHandler;
+		}
+
+		// Both directions, from the reliable fragment send counters that ConnectionManagerVisualizer shows
+		int64_t getRetransmits() const override
+		{
+			return int64_t(getRetransmits(serverConnection.get()) + getRetransmits(clientConnection.get()));
+		}
+
+	private:
+
+		static uint64_t getRetransmits(const se::net::Connection* const connection)
+		{
+			// Keyed by how many times a fragment was sent, a fragment sent n times was resent n - 1 times
+			uint64_t retransmits = 0;
+			if (connection)
+			{
+				for (const auto& [sendCount, fragmentCount] : connection->getReliableFragmentSendCounters())
+				{
+					if (sendCount > 1)
+					{
+						retransmits += uint64_t(sendCount - 1) * uint64_t(fragmentCount);
+					}
+				}
+			}
+			return retransmits;
+		}
+
+		se::net::IOService ioService;
+		se::net::ConnectionManager serverManager;
+		se::net::ConnectionManager clientManager;
+		boost::signals2::scoped_connection incomingConnection;
+		std::shared_ptr<se::net::Connection> serverConnection;
+		std::shared_ptr<se::net::Connection> clientConnection;
+		ReceiveHandler serverReceiveHandler;
+		ReceiveHandler clientReceiveHandler;
+		bool clientReceiveHandlerSet = false;
+	};
+
+	class ConnectionManager2Transport : public Transport
+	{
+	public:
+
+		ConnectionManager2Transport()
+			: serverManager("netbench server")
+			, clientManager("netbench client")
+		{
+		}
+
+		const char* getName() const override
+		{
+			return "ConnectionManager2";
+		}
+
+		bool start(const se::net::Port port) override
+		{
+			serverManager.connectToIncomingConnectionSignal(incomingConnection, [this](std::shared_ptr<se::net::Connection2>& connection)
+				{
+					serverConnection = connection;
+					serverConnection->setReceiveHandler(serverReceiveHandler);
+				});
+			serverManager.startListening(port);
+			clientConnection = clientManager.connect(se::net::Endpoint(se::net::Address("127.0.0.1"), port));
+			if (!clientConnection)
+			{
+				return false;
+			}
+			clientConnection->setReceiveHandler(clientReceiveHandler);
+			return true;
+		}
+
+		void update() override
+		{
+			serverManager.update();
+			clientManager.update();
+		}
+
+		bool isConnected() const override
+		{
+			return serverConnection && serverConnection->isConnected() && clientConnection->isConnected();
+		}
+
+		void send(const Side from, const se::WriteBuffer& writeBuffer, const bool reliable) override
+		{
+			(from == Side::Server ? serverConnection : clientConnection)->sendPacket(writeBuffer, reliable);
+		}
+
+		void setReceiveHandler(const Side receiver, const ReceiveHandler& receiveHandler) override
+		{
+			(receiver == Side::Server ? serverReceiveHandler : clientReceiveHandler) = receiveHandler;
+		}
+
+	private:
+
+		se::net::ConnectionManager2 serverManager;
+		se::net::ConnectionManager2 clientManager;
+		boost::signals2::scoped_connection incomingConnection;
+		std::shared_ptr<se::net::Connection2> serverConnection;
+		std::shared_ptr<se::net::Connection2> clientConnection;
+		ReceiveHandler serverReceiveHandler;
+		ReceiveHandler clientReceiveHandler;
+	};
+
+	/*
+		Passes the packets of another transport through a LinkEmulator in each direction before they reach the connection.
+		The emulator only sees application packets, so it works the same for both connection managers.
+	*/
+	class EmulatedTransport : public Transport
+	{
+	public:
+
+		EmulatedTransport(std::unique_ptr<Transport>&& _transport, const se::LinkEmulator::Settings& serverToClientSettings, const se::LinkEmulator::Settings& clientToServerSettings)
+			: transport(std::move(_transport))
+			, serverToClient(serverToClientSettings, [this](const std::vector<uint8_t>& data, const bool reliable) { deliver(Side::Server, data, reliable); })
+			, clientToServer(clientToServerSettings, [this](const std::vector<uint8_t>& data, const bool reliable) { deliver(Side::Client, data, reliable); })
+		{
+		}
+
+		const char* getName() const override
+		{
+			return transport->getName();
+		}
+
+		bool start(const se::net::Port port) override
+		{
+			return transport->start(port);
+		}
+
+		void update() override
+		{
+			transport->update();
+			const se::LinkEmulator::Clock::time_point now = se::LinkEmulator::Clock::now();
+			serverToClient.update(now);
+			clientToServer.update(now);
+		}
+
+		bool isConnected() const override
+		{
+			return transport->isConnected();
+		}
+
+		void send(const Side from, const se::WriteBuffer& writeBuffer, const bool reliable) override
+		{
+			(from == Side::Server ? serverToClient : clientToServer).send(writeBuffer.getData(), writeBuffer.getSize(), reliable, se::LinkEmulator::Clock::now());
+		}
+
+		void setReceiveHandler(const Side receiver, const ReceiveHandler& receiveHandler) override
+		{
+			transport->setReceiveHandler(receiver, receiveHandler);
+		}
+
+		int64_t getRetransmits() const override
+		{
+			return transport->getRetransmits();
+		}
+
+		const se::LinkEmulator& getLinkEmulator(const Side from) const
+		{
+			return from == Side::Server ? serverToClient : clientToServer;
+		}
+
+	private:
+
+		void deliver(const Side from, const std::vector<uint8_t>& data, const bool reliable)
+		{
+			se::WriteBuffer writeBuffer;
+			writeBuffer.write(data.data(), data.size());
+			transport->send(from, writeBuffer, reliable);
+		}
+
+		std::unique_ptr<Transport> transport;
+		se::LinkEmulator serverToClient;
+		se::LinkEmulator clientToServer;
+	};
+
+	struct Options
+	{
+		int manager = 2;
+		std::string scenario = "stream";
+		bool reliable = true;
+		uint64_t size = 0;					// Payload bytes per packet or stream, 0 picks a scenario default
+		uint64_t rate = 1024 * 1024;		// Target bytes per second, stream only
+		double duration = 10.0;				// Seconds, stream and congestion only
+		uint64_t count = 100;				// Packets, large and echo only
+		uint16_t port = 41680;
+		float loss = 0.0f;					// Simulated packet loss, ConnectionManager only
+		bool emulateLink = false;			// Set by any of the link emulator options
+		se::LinkEmulator::Settings link;	// Server to client, the client to server direction uses the next seed
+		std::string linkTracePath;
+		std::string recordLinkTracePath;
+		double timeout = 60.0;				// Seconds, for connecting and for the scenario itself
+		double idleSleep = 0.0001;			// Seconds to sleep between updates when nothing was sent
+		std::string jsonPath;
+	};
+
+	// Every packet starts with this header so that the receiver can measure one way latency and detect gaps
+	struct PacketHeader
+	{
+		uint64_t sequence = 0;
+		int64_t sendTime = 0;
+	};
+
+	void writePacket(se::WriteBuffer& writeBuffer, const PacketHeader& header, const std::vector<uint8_t>& payload)
+	{
+		writeBuffer.write(header.sequence);
+		writeBuffer.write(header.sendTime);
+		se::writeArray(writeBuffer, payload);
+	}
+
+	bool readPacketHeader(se::ReadBuffer& readBuffer, PacketHeader& header)
+	{
+		return readBuffer.read(header.sequence) && readBuffer.read(header.sendTime);
+	}
+
+	std::vector<uint8_t> makePayload(const uint64_t size)
+	{
+		std::vector<uint8_t> payload(size);
+		uint8_t byte = 0;
+		for (uint8_t& value : payload)
+		{
+			value = byte++;
+		}
+		return payload;
+	}
+
+	bool isTimedOut(const int64_t beginTime, const Options& options)
+	{
+		return double(netbench::nowNanoseconds() - beginTime) / 1e9 > options.timeout;
+	}
+
+	void idle(const Options& options)
+	{
+		if (options.idleSleep > 0.0)
+		{
+			std::this_thread::sleep_for(std::chrono::duration<double>(options.idleSleep));
+		}
+	}
+
+	bool connect(Transport& transport, const Options& options)
+	{
+		const int64_t beginTime = netbench::nowNanoseconds();
+		if (!transport.start(se::net::Port(options.port)))
+		{
+			se::log::error("Failed to start loopback connection on port " + std::to_string(options.port));
+			return false;
+		}
+		while (!transport.isConnected())
+		{
+			if (isTimedOut(beginTime, options))
+			{
+				se::log::error("Timed out while connecting");
+				return false;
+			}
+			transport.update();
+			idle(options);
+		}
+		return true;
+	}
+
+	// Measures wall and process CPU time of the scenario body
+	struct ScopedMeasurement
+	{
+		ScopedMeasurement(netbench::Report& _report)
+			: report(_report)
+			, beginTime(netbench::nowNanoseconds())
+			, beginCpuTime(netbench::getProcessCpuNanoseconds())
+		{
+		}
+		~ScopedMeasurement()
+		{
+			report.durationSeconds = double(netbench::nowNanoseconds() - beginTime) / 1e9;
+			report.cpuNanoseconds = netbench::getProcessCpuNanoseconds() - beginCpuTime;
+		}
+		netbench::Report& report;
+		const int64_t beginTime;
+		const int64_t beginCpuTime;
+	};
+
+	void sendPacket(Transport& transport, const Side from, const Options& options, const std::vector<uint8_t>& payload, netbench::Report& report)
+	{
+		se::WriteBuffer writeBuffer;
+		writePacket(writeBuffer, PacketHeader{ report.packetsSent, netbench::nowNanoseconds() }, payload);
+		transport.send(from, writeBuffer, options.reliable);
+		report.packetsSent++;
+		report.bytesSent += writeBuffer.getSize();
+	}
+
+	ReceiveHandler makeOneWayReceiveHandler(netbench::Report& report)
+	{
+		return [&report](se::ReadBuffer& readBuffer, const bool)
+		{
+			PacketHeader header;
+			if (readPacketHeader(readBuffer, header))
+			{
+				report.latency.add(netbench::nowNanoseconds() - header.sendTime);
+				report.packetsReceived++;
+				report.bytesReceived += readBuffer.getSize();
+			}
+		};
+	}
+
+	// Server streams packets to the client at the target rate for the duration, then waits for outstanding packets to drain
+	bool runStream(Transport& transport, const Options& options, netbench::Report& report)
+	{
+		const std::vector<uint8_t> payload = makePayload(options.size ? options.size : 1024);
+		report.payloadBytes = payload.size();
+		report.targetBytesPerSecond = options.rate;
+		transport.setReceiveHandler(Side::Client, makeOneWayReceiveHandler(report));
+		if (!connect(transport, options))
+		{
+			return false;
+		}
+
+		const ScopedMeasurement scopedMeasurement(report);
+		const int64_t beginTime = netbench::nowNanoseconds();
+		const int64_t endTime = beginTime + int64_t(options.duration * 1e9);
+		int64_t now = beginTime;
+		while (now < endTime && !isTimedOut(beginTime, options))
+		{
+			transport.update();
+			now = netbench::nowNanoseconds();
+			const uint64_t bytesDue = uint64_t(double(options.rate) * double(now - beginTime) / 1e9);
+			if (report.bytesSent >= bytesDue)
+			{
+				idle(options);
+			}
+			while (report.bytesSent < bytesDue)
+			{
+				sendPacket(transport, Side::Server, options, payload, report);
+			}
+		}
+		// Unreliable packets that are still missing after the drain period are lost
+		const int64_t drainEndTime = netbench::nowNanoseconds() + int64_t(2e9);
+		while (report.packetsReceived < report.packetsSent && netbench::nowNanoseconds() < drainEndTime)
+		{
+			transport.update();
+			idle(options);
+		}
+		report.completed = now >= endTime && (!options.reliable || report.packetsReceived == report.packetsSent);
+		return true;
+	}
+
+	// Server sends one large packet at a time, the next one after the client has received the previous one. Unreliable packets are considered lost after a second.
+	bool runLarge(Transport& transport, const Options& options, netbench::Report& report)
+	{
+		const std::vector<uint8_t> payload = makePayload(options.size ? options.size : 1024 * 1024);
+		report.payloadBytes = payload.size();
+		transport.setReceiveHandler(Side::Client, makeOneWayReceiveHandler(report));
+		if (!connect(transport, options))
+		{
+			return false;
+		}
+
+		const ScopedMeasurement scopedMeasurement(report);
+		const int64_t beginTime = netbench::nowNanoseconds();
+		int64_t lastSendTime = 0;
+		while (report.packetsReceived < options.count && !isTimedOut(beginTime, options))
+		{
+			if (report.packetsSent == report.packetsReceived || (!options.reliable && netbench::nowNanoseconds() - lastSendTime > int64_t(1e9)))
+			{
+				sendPacket(transport, Side::Server, options, payload, report);
+				lastSendTime = netbench::nowNanoseconds();
+			}
+			transport.update();
+			idle(options);
+		}
+		report.completed = report.packetsReceived == options.count;
+		return true;
+	}
+
+	// Client pings, server echoes the packet back as is. Latency is the round trip time. One ping is in flight at a time.
+	bool runEcho(Transport& transport, const Options& options, netbench::Report& report)
+	{
+		const std::vector<uint8_t> payload = makePayload(options.size ? options.size : 32);
+		report.payloadBytes = payload.size();
+		bool awaitingReply = false;
+		transport.setReceiveHandler(Side::Server, [&transport, &options](se::ReadBuffer& readBuffer, const bool)
+			{
+				se::WriteBuffer writeBuffer;
+				writeBuffer.write(readBuffer.getData(), readBuffer.getSize());
+				transport.send(Side::Server, writeBuffer, options.reliable);
+			});
+		transport.setReceiveHandler(Side::Client, [&report, &awaitingReply](se::ReadBuffer& readBuffer, const bool)
+			{
+				// Replies to lost and resent pings are ignored
+				PacketHeader header;
+				if (readPacketHeader(readBuffer, header) && awaitingReply && header.sequence + 1 == report.packetsSent)
+				{
+					report.latency.add(netbench::nowNanoseconds() - header.sendTime);
+					report.packetsReceived++;
+					report.bytesReceived += readBuffer.getSize();
+					awaitingReply = false;
+				}
+			});
+		if (!connect(transport, options))
+		{
+			return false;
+		}
+
+		const ScopedMeasurement scopedMeasurement(report);
+		const int64_t beginTime = netbench::nowNanoseconds();
+		int64_t lastSendTime = 0;
+		while (report.packetsReceived < options.count && !isTimedOut(beginTime, options))
+		{
+			// Unreliable pings are considered lost after a second
+			if (!awaitingReply || (!options.reliable && netbench::nowNanoseconds() - lastSendTime > int64_t(1e9)))
+			{
+				sendPacket(transport, Side::Client, options, payload, report);
+				lastSendTime = netbench::nowNanoseconds();
+				awaitingReply = true;
+			}
+			transport.update();
+			idle(options);
+		}
+		report.completed = report.packetsReceived == options.count;
+		return true;
+	}
+
+	/*
+		Server sends one stream of --size bytes to the client through a StreamMultiplexer.
+		The client verifies the data as it arrives and keeps none of it, so flow control bounds the memory that the transfer needs
+		to about one receive window on each side, regardless of the stream size. The peak resident memory in the report shows it.
+	*/
+	bool runStreamLarge(Transport& transport, const Options& options, netbench::Report& report)
+	{
+		const uint64_t streamSize = options.size ? options.size : 300ull * 1024 * 1024;
+		const se::StreamSettings streamSettings;
+		// Byte n of the stream is uint8_t(n), so any chunk can be written and verified against this pattern
+		const std::vector<uint8_t> pattern = makePayload(256 + streamSettings.chunkSize);
+		report.payloadBytes = streamSize;
+
+		se::TypelessMessageRouter serverRouter;
+		se::TypelessMessageRouter clientRouter;
+		se::StreamMultiplexer serverMultiplexer(serverRouter, [&transport](const se::WriteBuffer& writeBuffer) { transport.send(Side::Server, writeBuffer, true); }, streamSettings);
+		se::StreamMultiplexer clientMultiplexer(clientRouter, [&transport](const se::WriteBuffer& writeBuffer) { transport.send(Side::Client, writeBuffer, true); }, streamSettings);
+		transport.setReceiveHandler(Side::Server, serverRouter.makeReceiveHandler());
+		transport.setReceiveHandler(Side::Client, clientRouter.makeReceiveHandler());
+
+		std::shared_ptr<se::IncomingStream> incomingStream;
+		bool corrupted = false;
+		bool ended = false;
+		clientMultiplexer.setIncomingStreamHandler([&incomingStream, &corrupted, &ended, &pattern, &streamSettings, &report](const std::shared_ptr<se::IncomingStream>& stream)
+			{
+				incomingStream = stream;
+				stream->setChunkHandler([&corrupted, &pattern, &streamSettings, &report](const uint8_t* data, const size_t size)
+					{
+						for (size_t offset = 0; offset < size; offset += streamSettings.chunkSize)
+						{
+							const size_t pieceSize = std::min(streamSettings.chunkSize, size - offset);
+							if (memcmp(data + offset, pattern.data() + (report.bytesReceived + offset) % 256, pieceSize) != 0)
+							{
+								corrupted = true;
+							}
+						}
+						report.packetsReceived++;
+						report.bytesReceived += size;
+					});
+				stream->setEndHandler([&ended]()
+					{
+						ended = true;
+					});
+			});
+		if (!connect(transport, options))
+		{
+			return false;
+		}
+
+		const ScopedMeasurement scopedMeasurement(report);
+		const int64_t beginTime = netbench::nowNanoseconds();
+		const std::shared_ptr<se::OutgoingStream> stream = serverMultiplexer.openStream(streamSize);
+		while (!ended && !stream->isCanceled() && !isTimedOut(beginTime, options))
+		{
+			// Written as far as the receiver's window allows
+			bool wrote = false;
+			while (stream->isWritable() && stream->getBytesWritten() < streamSize)
+			{
+				const uint64_t offset = stream->getBytesWritten();
+				const size_t size = size_t(std::min(streamSize - offset, uint64_t(streamSettings.chunkSize)));
+				report.bytesSent += stream->write(pattern.data() + offset % 256, size);
+				report.packetsSent++;
+				wrote = true;
+			}
+			if (stream->getBytesWritten() == streamSize && !stream->isClosed())
+			{
+				stream->close();
+			}
+			transport.update();
+			if (!wrote)
+			{
+				idle(options);
+			}
+		}
+		if (corrupted)
+		{
+			se::log::error("Stream data was corrupted");
+		}
+		report.completed = ended && !corrupted && report.bytesReceived == streamSize;
+		return true;
+	}
+
+	/*
+		Server sends reliable --size byte packets to the client for --duration seconds, paced by a CongestionController.
+		The client feeds the controller with the number of bytes it has received, after every packet and every 50 ms, as NetClient does.
+		Run it with --bandwidth and --latency to see whether the controller fills the emulated link. Loss that the connection has to recover from
+		comes from --loss with --manager 1, the link emulator's loss options only drop the unreliable delivery feedback.
+	*/
+	bool runCongestion(Transport& transport, const Options& options, netbench::Report& report)
+	{
+		const std::vector<uint8_t> payload = makePayload(options.size ? options.size : 1024);
+		report.payloadBytes = payload.size();
+		se::CongestionController congestionController;
+		uint64_t deliveredBytes = 0;
+		int64_t lastDeliveryFeedbackTime = 0;
+		const auto sendDeliveryFeedback = [&transport, &deliveredBytes, &lastDeliveryFeedbackTime]()
+		{
+			se::WriteBuffer writeBuffer;
+			writeBuffer.write(deliveredBytes);
+			transport.send(Side::Client, writeBuffer, false);
+			lastDeliveryFeedbackTime = netbench::nowNanoseconds();
+		};
+		transport.setReceiveHandler(Side::Server, [&congestionController](se::ReadBuffer& readBuffer, const bool)
+			{
+				uint64_t feedback = 0;
+				if (readBuffer.read(feedback))
+				{
+					congestionController.onDelivered(feedback, se::CongestionController::Clock::now());
+				}
+			});
+		transport.setReceiveHandler(Side::Client, [&report, &deliveredBytes, &sendDeliveryFeedback](se::ReadBuffer& readBuffer, const bool)
+			{
+				PacketHeader header;
+				if (readPacketHeader(readBuffer, header))
+				{
+					report.latency.add(netbench::nowNanoseconds() - header.sendTime);
+					report.packetsReceived++;
+					report.bytesReceived += readBuffer.getSize();
+				}
+				deliveredBytes += readBuffer.getSize();
+				sendDeliveryFeedback();
+			});
+		if (!connect(transport, options))
+		{
+			return false;
+		}
+
+		const ScopedMeasurement scopedMeasurement(report);
+		const int64_t beginTime = netbench::nowNanoseconds();
+		const int64_t endTime = beginTime + int64_t(options.duration * 1e9);
+		int64_t now = beginTime;
+		while (now < endTime && !isTimedOut(beginTime, options))
+		{
+			transport.update();
+			bool sent = false;
+			while (congestionController.canSend(se::CongestionController::Clock::now()))
+			{
+				const uint64_t bytesSent = report.bytesSent;
+				sendPacket(transport, Side::Server, options, payload, report);
+				congestionController.onPacketSent(size_t(report.bytesSent - bytesSent), se::CongestionController::Clock::now());
+				sent = true;
+			}
+			now = netbench::nowNanoseconds();
+			// The controller stops sending once its window is full, so lost feedback must be repeated
+			if (now - lastDeliveryFeedbackTime > int64_t(50e6))
+			{
+				sendDeliveryFeedback();
+			}
+			if (!sent)
+			{
+				idle(options);
+			}
+		}
+		const int64_t drainEndTime = netbench::nowNanoseconds() + int64_t(2e9);
+		while (report.packetsReceived < report.packetsSent && netbench::nowNanoseconds() < drainEndTime)
+		{
+			transport.update();
+			idle(options);
+		}
+		report.completed = now >= endTime && report.packetsReceived == report.packetsSent;
+		se::log::info(se::formatString("\tcongestion controller: bandwidth %s/s, pacing %s/s, min rtt %.2f ms, window %s",
+			se::toByteString(congestionController.getBottleneckBandwidth()).c_str(), se::toByteString(congestionController.getPacingRate()).c_str(),
+			std::chrono::duration<double, std::milli>(congestionController.getMinRtt()).count(), se::toByteString(congestionController.getCongestionWindow()).c_str()));
+		return true;
+	}
+
+	bool parseOptions(const int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string argument = argv[i];
+			const bool hasValue = i + 1 < argc;
+			if (argument == "--manager" && hasValue)
+			{
+				options.manager = std::atoi(argv[++i]);
+			}
+			else if (argument == "--scenario" && hasValue)
+			{
+				options.scenario = argv[++i];
+			}
+			else if (argument == "--reliable" && hasValue)
+			{
+				options.reliable = std::atoi(argv[++i]) != 0;
+			}
+			else if (argument == "--size" && hasValue)
+			{
+				options.size = uint64_t(std::max(0ll, std::atoll(argv[++i])));
+			}
+			else if (argument == "--rate" && hasValue)
+			{
+				options.rate = uint64_t(std::max(1ll, std::atoll(argv[++i])));
+			}
+			else if (argument == "--duration" && hasValue)
+			{
+				options.duration = std::max(0.0, std::atof(argv[++i]));
+			}
+			else if (argument == "--count" && hasValue)
+			{
+				options.count = uint64_t(std::max(1ll, std::atoll(argv[++i])));
+			}
+			else if (argument == "--port" && hasValue)
+			{
+				options.port = uint16_t(std::atoi(argv[++i]));
+			}
+			else if (argument == "--loss" && hasValue)
+			{
+				options.loss = float(std::clamp(std::atof(argv[++i]), 0.0, 1.0));
+			}
+			else if (argument == "--seed" && hasValue)
+			{
+				options.link.seed = uint64_t(std::strtoull(argv[++i], nullptr, 10));
+			}
+			else if (argument == "--latency" && hasValue)
+			{
+				options.link.latency = std::chrono::microseconds(int64_t(std::max(0.0, std::atof(argv[++i])) * 1000.0));
+				options.emulateLink = true;
+			}
+			else if (argument == "--jitter" && hasValue)
+			{
+				options.link.jitter = std::chrono::microseconds(int64_t(std::max(0.0, std::atof(argv[++i])) * 1000.0));
+				options.emulateLink = true;
+			}
+			else if (argument == "--bandwidth" && hasValue)
+			{
+				options.link.bytesPerSecond = uint64_t(std::max(0ll, std::atoll(argv[++i])));
+				options.emulateLink = true;
+			}
+			else if (argument == "--queue" && hasValue)
+			{
+				options.link.queueBytes = size_t(std::max(0ll, std::atoll(argv[++i])));
+				options.emulateLink = true;
+			}
+			else if (argument == "--link-loss" && hasValue)
+			{
+				options.link.loss.goodLoss = std::clamp(std::atof(argv[++i]), 0.0, 1.0);
+				options.emulateLink = true;
+			}
+			else if (argument == "--burst-loss" && hasValue)
+			{
+				se::LinkEmulator::GilbertElliottLoss& loss = options.link.loss;
+				if (std::sscanf(argv[++i], "%lf,%lf,%lf", &loss.goodToBad, &loss.badToGood, &loss.badLoss) != 3)
+				{
+					se::log::error("--burst-loss expects <good to bad>,<bad to good>,<bad state loss>");
+					return false;
+				}
+				options.emulateLink = true;
+			}
+			else if (argument == "--duplicate" && hasValue)
+			{
+				options.link.duplicateChance = std::clamp(std::atof(argv[++i]), 0.0, 1.0);
+				options.emulateLink = true;
+			}
+			else if (argument == "--reorder" && hasValue)
+			{
+				options.link.reorderChance = std::clamp(std::atof(argv[++i]), 0.0, 1.0);
+				options.emulateLink = true;
+			}
+			else if (argument == "--link-trace" && hasValue)
+			{
+				options.linkTracePath = argv[++i];
+				options.emulateLink = true;
+			}
+			else if (argument == "--record-link-trace" && hasValue)
+			{
+				options.recordLinkTracePath = argv[++i];
+				options.link.recordTrace = true;
+				options.emulateLink = true;
+			}
+			else if (argument == "--timeout" && hasValue)
+			{
+				options.timeout = std::max(0.0, std::atof(argv[++i]));
+			}
+			else if (argument == "--idle-sleep" && hasValue)
+			{
+				options.idleSleep = std::max(0.0, std::atof(argv[++i]));
+			}
+			else if (argument == "--json" && hasValue)
+			{
+				options.jsonPath = argv[++i];
+			}
+			else
+			{
+				se::log::error("Unknown argument: " + argument);
+				return false;
+			}
+		}
+		if (options.manager != 1 && options.manager != 2)
+		{
+			se::log::error("--manager must be 1 or 2");
+			return false;
+		}
+		if (options.scenario != "stream" && options.scenario != "large" && options.scenario != "echo" && options.scenario != "stream-large" && options.scenario != "congestion")
+		{
+			se::log::error("--scenario must be stream, large, echo, stream-large or congestion");
+			return false;
+		}
+		if ((options.scenario == "stream-large" || options.scenario == "congestion") && !options.reliable)
+		{
+			se::log::error("--scenario " + options.scenario + " requires --reliable 1");
+			return false;
+		}
+		if (options.loss > 0.0f && options.manager != 1)
+		{
+			se::log::error("--loss is only supported with --manager 1");
+			return false;
+		}
+		if (!options.linkTracePath.empty())
+		{
+			std::vector<se::LinkEmulator::Fate> trace;
+			if (!se::LinkEmulator::readTrace(options.linkTracePath, trace) || trace.empty())
+			{
+				se::log::error("Failed to read link trace: " + options.linkTracePath);
+				return false;
+			}
+			options.link.replayTrace = std::make_shared<const std::vector<se::LinkEmulator::Fate>>(std::move(trace));
+		}
+		return true;
+	}
+}
+
+/*
+	Headless network benchmark, runs a server and a client in this process over loopback.
+	Only NetBench.vcxproj builds it, so it is Windows only for now. The code has no Windows dependencies,
+	but this tree has no Linux build of the engine libraries it links against.
+
+	Usage: NetBench [options]
+	--manager <1|2>						ConnectionManager or ConnectionManager2, default 2
+	--scenario <stream|large|echo|stream-large|congestion>	default stream
+		stream: the server sends --size byte packets at --rate bytes per second for --duration seconds
+		large: the server sends --count packets of --size bytes, one at a time
+		echo: the client sends --count pings of --size bytes, the server echoes them back
+		stream-large: the server sends one flow controlled stream of --size bytes, the report includes the peak resident memory
+		congestion: the server sends --size byte packets for --duration seconds as fast as a CongestionController allows, the client reports delivery back
+	--reliable <0|1>					default 1, stream-large and congestion are always reliable
+	--size <bytes>						payload per packet, defaults to 1 KiB for stream and congestion, 1 MiB for large and 32 B for echo. Stream size for stream-large, default 300 MiB
+	--rate <bytes per second>			default 1 MiB/s
+	--duration <seconds>				default 10, stream and congestion
+	--count <packets>					default 100
+	--port <port>						default 41680
+	--loss <0..1>						simulated packet loss, ConnectionManager only
+
+	Link emulation, for both managers. Applied to application packets before they are sent, reliable packets are only delayed and rate limited.
+	--seed <n>							link emulator seed, the same seed reproduces the same packet fates, default 1
+	--latency <ms>						one way latency
+	--jitter <ms>						uniform jitter, +-ms
+	--bandwidth <bytes per second>		link rate
+	--queue <bytes>						link queue size, unreliable packets that do not fit are dropped
+	--link-loss <0..1>					random loss, the loss rate of the good state of the burst loss model
+	--burst-loss <p>,<r>,<h>			Gilbert-Elliott loss: good to bad chance, bad to good chance, loss rate in the bad state
+	--duplicate <0..1>					duplication chance
+	--reorder <0..1>					chance that a packet skips the latency and overtakes earlier packets
+	--link-trace <path>					replay packet fates of the server to client direction from a trace file
+	--record-link-trace <path>			record packet fates of the server to client direction into a trace file
+
+	--timeout <seconds>					default 60
+	--idle-sleep <seconds>				sleep between idle updates, 0 to spin, default 0.0001
+	--json <path>						write the report as json
+
+	Exits with 1 on invalid arguments or connection failure, 2 if the scenario did not complete before the timeout.
+*/
+int main(int argc, char** argv)
+{
+	se::CoreLib core;
+	se::NetLib net(core);
+
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		return 1;
+	}
+	std::string arguments;
+	for (int i = 1; i < argc; i++)
+	{
+		arguments += (i > 1 ? " " : "") + std::string(argv[i]);
+	}
+
+	std::unique_ptr<Transport> transport;
+	if (options.manager == 1)
+	{
+		transport.reset(new ConnectionManagerTransport(options.loss));
+	}
+	else
+	{
+		transport.reset(new ConnectionManager2Transport());
+	}
+	EmulatedTransport* emulatedTransport = nullptr;
+	if (options.emulateLink)
+	{
+		se::LinkEmulator::Settings clientToServerSettings = options.link;
+		clientToServerSettings.seed = options.link.seed + 1;
+		clientToServerSettings.replayTrace.reset();
+		clientToServerSettings.recordTrace = false;
+		emulatedTransport = new EmulatedTransport(std::move(transport), options.link, clientToServerSettings);
+		transport.reset(emulatedTransport);
+	}
+
+	netbench::Report report;
+	report.manager = transport->getName();
+	report.scenario = options.scenario;
+	report.reliable = options.reliable;
+	bool connected = false;
+	if (options.scenario == "stream")
+	{
+		connected = runStream(*transport, options, report);
+	}
+	else if (options.scenario == "large")
+	{
+		connected = runLarge(*transport, options, report);
+	}
+	else if (options.scenario == "stream-large")
+	{
+		connected = runStreamLarge(*transport, options, report);
+	}
+	else if (options.scenario == "congestion")
+	{
+		connected = runCongestion(*transport, options, report);
+	}
+	else
+	{
+		connected = runEcho(*transport, options, report);
+	}
+	if (!connected)
+	{
+		return 1;
+	}
+	report.retransmits = transport->getRetransmits();
+	report.peakResidentBytes = netbench::getProcessPeakResidentBytes();
+
+	netbench::logReport(report);
+	if (emulatedTransport)
+	{
+		const se::LinkEmulator::Stats& stats = emulatedTransport->getLinkEmulator(Side::Server).getStats();
+		se::log::info(se::formatString("\tlink server to client: sent %llu, delivered %llu, lost %llu, queue dropped %llu, duplicated %llu, reordered %llu",
+			(unsigned long long)stats.packetsSent, (unsigned long long)stats.packetsDelivered, (unsigned long long)stats.packetsLost,
+			(unsigned long long)stats.packetsDropped, (unsigned long long)stats.packetsDuplicated, (unsigned long long)stats.packetsReordered));
+		if (!options.recordLinkTracePath.empty() && !se::LinkEmulator::writeTrace(options.recordLinkTracePath, emulatedTransport->getLinkEmulator(Side::Server).getRecordedTrace()))
+		{
+			return 1;
+		}
+	}
+	if (!options.jsonPath.empty() && !netbench::writeJson(report, arguments, options.jsonPath))
+	{
+		return 1;
+	}
+	return report.completed ? 0 : 2;
+}
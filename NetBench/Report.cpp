@@ -0,0 +1,167 @@
+#include "stdafx.h"
+#include "NetBench/Report.h"
+
+#include "SpehsEngine/Core/StringOperations.h"
+#include "SpehsEngine/Core/StringUtilityFunctions.h"
+#include "Sandbox/JsonUtilityFunctions.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+
+namespace netbench
+{
+	int64_t nowNanoseconds()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	int64_t getProcessCpuNanoseconds()
+	{
+#ifdef _WIN32
+		FILETIME creationTime, exitTime, kernelTime, userTime;
+		if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+		{
+			return 0;
+		}
+		const auto toNanoseconds = [](const FILETIME& fileTime)
+		{
+			return ((int64_t(fileTime.dwHighDateTime) << 32) | int64_t(fileTime.dwLowDateTime)) * 100;
+		};
+		return toNanoseconds(kernelTime) + toNanoseconds(userTime);
+#else
+		timespec time;
+		if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0)
+		{
+			return 0;
+		}
+		return int64_t(time.tv_sec) * 1000000000ll + int64_t(time.tv_nsec);
+#endif
+	}
+
+	uint64_t getProcessPeakResidentBytes()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		{
+			return 0;
+		}
+		return uint64_t(counters.PeakWorkingSetSize);
+#else
+		rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+		{
+			return 0;
+		}
+#ifdef __APPLE__
+		return uint64_t(usage.ru_maxrss);
+#else
+		return uint64_t(usage.ru_maxrss) * 1024; // Kilobytes on Linux
+#endif
+#endif
+	}
+
+	void LatencyRecorder::add(const int64_t nanoseconds)
+	{
+		samples.push_back(nanoseconds);
+		sorted = false;
+	}
+
+	int64_t LatencyRecorder::getPercentile(const double percentile) const
+	{
+		if (samples.empty())
+		{
+			return 0;
+		}
+		if (!sorted)
+		{
+			std::sort(samples.begin(), samples.end());
+			sorted = true;
+		}
+		const double rank = std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * double(samples.size()));
+		return samples[std::max(size_t(1), size_t(rank)) - 1];
+	}
+
+	int64_t LatencyRecorder::getMax() const
+	{
+		return getPercentile(100.0);
+	}
+
+	void logReport(const Report& report)
+	{
+		const double seconds = std::max(report.durationSeconds, 1e-9);
+		se::log::info(se::formatString("%s %s %s: %s in %.2f s",
+			report.manager.c_str(), report.scenario.c_str(), report.reliable ? "reliable" : "unreliable", report.completed ? "completed" : "timed out", report.durationSeconds));
+		se::log::info(se::formatString("\tsent %llu packets (%s), received %llu packets (%s), %s/s",
+			(unsigned long long)report.packetsSent, se::toByteString(report.bytesSent).c_str(),
+			(unsigned long long)report.packetsReceived, se::toByteString(report.bytesReceived).c_str(),
+			se::toByteString(uint64_t(double(report.bytesReceived) / seconds)).c_str()));
+		se::log::info(se::formatString("\tlatency us p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f",
+			double(report.latency.getPercentile(50.0)) / 1000.0, double(report.latency.getPercentile(90.0)) / 1000.0,
+			double(report.latency.getPercentile(99.0)) / 1000.0, double(report.latency.getPercentile(99.9)) / 1000.0,
+			double(report.latency.getMax()) / 1000.0));
+		se::log::info(se::formatString("\tcpu %.3f s, %.2f ns/byte", double(report.cpuNanoseconds) / 1e9,
+			report.bytesReceived ? double(report.cpuNanoseconds) / double(report.bytesReceived) : 0.0));
+		if (report.peakResidentBytes)
+		{
+			se::log::info("\tpeak resident memory " + se::toByteString(report.peakResidentBytes));
+		}
+	}
+
+	bool writeJson(const Report& report, const std::string& arguments, const std::string& path)
+	{
+		std::ofstream file(path, std::ios::out | std::ios::trunc);
+		if (!file)
+		{
+			se::log::error("Failed to open netbench output file: " + path);
+			return false;
+		}
+		const double seconds = std::max(report.durationSeconds, 1e-9);
+		file << "{\n";
+		file << "\t\"arguments\": \"" << se::escapeJson(arguments) << "\",\n";
+		file << "\t\"manager\": \"" << se::escapeJson(report.manager) << "\",\n";
+		file << "\t\"scenario\": \"" << se::escapeJson(report.scenario) << "\",\n";
+		file << "\t\"reliable\": " << (report.reliable ? "true" : "false") << ",\n";
+		file << "\t\"completed\": " << (report.completed ? "true" : "false") << ",\n";
+		file << "\t\"payloadBytes\": " << report.payloadBytes << ",\n";
+		file << "\t\"targetBytesPerSecond\": " << report.targetBytesPerSecond << ",\n";
+		file << "\t\"durationSeconds\": " << se::formatJsonNumber(report.durationSeconds) << ",\n";
+		file << "\t\"packetsSent\": " << report.packetsSent << ",\n";
+		file << "\t\"packetsReceived\": " << report.packetsReceived << ",\n";
+		file << "\t\"bytesSent\": " << report.bytesSent << ",\n";
+		file << "\t\"bytesReceived\": " << report.bytesReceived << ",\n";
+		file << "\t\"throughputBytesPerSecond\": " << se::formatJsonNumber(double(report.bytesReceived) / seconds) << ",\n";
+		if (report.retransmits >= 0)
+		{
+			file << "\t\"retransmits\": " << report.retransmits << ",\n";
+		}
+		else
+		{
+			file << "\t\"retransmits\": null,\n";
+		}
+		file << "\t\"cpuNanoseconds\": " << report.cpuNanoseconds << ",\n";
+		file << "\t\"peakResidentBytes\": " << report.peakResidentBytes << ",\n";
+		file << "\t\"cpuNanosecondsPerByte\": " << se::formatJsonNumber(report.bytesReceived ? double(report.cpuNanoseconds) / double(report.bytesReceived) : 0.0) << ",\n";
+		file << "\t\"latencyNanoseconds\": { "
+			<< "\"count\": " << report.latency.getCount() << ", "
+			<< "\"p50\": " << report.latency.getPercentile(50.0) << ", "
+			<< "\"p90\": " << report.latency.getPercentile(90.0) << ", "
+			<< "\"p99\": " << report.latency.getPercentile(99.0) << ", "
+			<< "\"p999\": " << report.latency.getPercentile(99.9) << ", "
+			<< "\"max\": " << report.latency.getMax()
+			<< " }\n";
+		file << "}\n";
+		return bool(file);
+	}
+}
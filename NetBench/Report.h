@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+namespace netbench
+{
+	// Nanoseconds on the steady clock, shared by the sending and receiving side since both run in this process
+	int64_t nowNanoseconds();
+
+	// User and kernel CPU time consumed by the whole process
+	int64_t getProcessCpuNanoseconds();
+
+	// Highest resident memory of the whole process so far, 0 if unknown
+	uint64_t getProcessPeakResidentBytes();
+
+	class LatencyRecorder
+	{
+	public:
+
+		void add(const int64_t nanoseconds);
+
+		// 0 <= percentile <= 100. Returns 0 when empty.
+		int64_t getPercentile(const double percentile) const;
+		int64_t getMax() const;
+
+		inline size_t getCount() const
+		{
+			return samples.size();
+		}
+
+	private:
+
+		mutable std::vector<int64_t> samples; // Sorted lazily
+		mutable bool sorted = true;
+	};
+
+	struct Report
+	{
+		std::string manager;
+		std::string scenario;
+		bool reliable = true;
+		uint64_t payloadBytes = 0;			// Bytes per packet, excluding the benchmark header
+		uint64_t targetBytesPerSecond = 0;	// 0 if the scenario is not rate driven
+		double durationSeconds = 0.0;
+		uint64_t packetsSent = 0;
+		uint64_t packetsReceived = 0;
+		uint64_t bytesSent = 0;
+		uint64_t bytesReceived = 0;
+		int64_t retransmits = -1;			// -1 if the connection does not expose resend counters
+		int64_t cpuNanoseconds = 0;
+		uint64_t peakResidentBytes = 0;		// Process peak at the end of the scenario, 0 if unknown
+		bool completed = false;				// Did the scenario finish before the timeout
+		LatencyRecorder latency;
+	};
+
+	void logReport(const Report& report);
+	bool writeJson(const Report& report, const std::string& arguments, const std::string& path);
+}
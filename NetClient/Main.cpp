@@ -31,6 +31,18 @@
 #include "SpehsEngine/Debug/DebugLib.h"
 #include "SpehsEngine/Debug/ScopeProfilerVisualizer.h"
 #include "SpehsEngine/Debug/ConnectionManagerVisualizer.h"
+#include "Sandbox/ArraySerialization.h"
+#include "Sandbox/ConnectionMetrics.h"
+#include "Sandbox/IntegerCoding.h"
+#include "Sandbox/MessageStream.h"
+#include "Sandbox/PayloadVerification.h"
+#include "Sandbox/ScopeTrace.h"
+#include "Sandbox/TypelessMessageRouter.h"
+#include "Sandbox/TransferStats.h"
+#include "Sandbox/TypelessPointer.h"
+#include "Sandbox/UpdateLoop.h"
+#include "Sandbox/ShardedConnectionServer.h"
+#include <chrono>
 #include <thread>
 
 
@@ -46,18 +58,31 @@ int main()
 	se::GUILib gui(input, audio);
 	se::debug::DebugLib debug(gui);
 
+	// The server's directory assigns the shard
 	se::net::ConnectionManager2 connectionManager2("client");
-	std::shared_ptr<se::net::Connection2> connection2 = connectionManager2.connect(se::net::Endpoint(se::net::Address("192.168.100.41"), se::net::Port(41623)));
+	std::shared_ptr<se::net::Connection2> connection2 = se::ShardedConnectionServer::connect(connectionManager2, se::net::Address("192.168.100.41"), 41623);
 	if (connection2)
 	{
-		connection2->setReceiveHandler([](se::ReadBuffer& readBuffer, const bool reliable)
+		se::TypelessMessageRouter messageRouter;
+		// Answers the server's round trip time probes
+		se::ConnectionMetrics connectionMetrics("client");
+		connectionMetrics.setProbeHandlers(messageRouter, connection2);
+		messageRouter.setHandler<std::string>([](std::string& message, const bool)
 			{
-				se::log::info("Received handler");
+				se::log::info("Received message: " + message);
 			});
-		while (true)
-		{
-			connectionManager2.update();
-		}
+		messageRouter.setDefaultHandler([](se::TypelessPointer& message, const bool)
+			{
+				se::log::info(std::string("Received unhandled message of type: ") + message.getTypeInfo()->name);
+			});
+		se::UpdateLoop updateLoop([&connectionManager2]() { connectionManager2.update(); });
+		connection2->setReceiveHandler([&updateLoop, &connectionMetrics, receiveHandler = messageRouter.makeReceiveHandler()](se::ReadBuffer& readBuffer, const bool reliable)
+			{
+				updateLoop.notifyActivity();
+				connectionMetrics.recordReceived(readBuffer.getSize(), reliable);
+				receiveHandler(readBuffer, reliable);
+			});
+		updateLoop.run();
 	}
 	else
 	{
@@ -71,6 +96,9 @@ int main()
 	const se::net::Address serverAddress(inifile.get("network", "server_address", std::string("127.0.0.1")));
 	const se::net::Port serverPort(inifile.get("network", "server_port", uint16_t(41667)));
 	const se::net::Endpoint serverEndpoint(serverAddress, serverPort);
+	const bool deltaEncoding = inifile.get("network", "delta_encoding", true); // Must match the server
+	const bool scopeTrace = inifile.get("debug", "scope_trace", false);
+	se::ScopeTrace::setEnabled(scopeTrace);
 
 	const se::time::Time minFrameTime = se::time::fromSeconds(1.0f / float(limitFps));
 
@@ -116,37 +144,63 @@ int main()
 	scopeProfilerVisualizer.setTargetRootSectionWidth(&minFrameTime);
 	scopeProfilerVisualizer.setRenderState(false);
 
-	const se::time::Time beginTime = se::time::now();
-
 	if (false)
 	{
 		uint64_t dataIndex = 0u;
-		uint64_t reliableBytesReceived = 0u;
-		std::function<void(se::ReadBuffer&, const boost::asio::ip::udp::endpoint&, const bool)> receiveHandler = [&dataIndex, &reliableBytesReceived, beginTime](se::ReadBuffer& readBuffer, const boost::asio::ip::udp::endpoint&, const bool reliable)
+		uint64_t previousDecodedDataIndex = 0u;
+		std::vector<uint64_t> dataIndices;
+		// Rates are sampled once per window from the frame loop, the receive handler only counts
+		se::TransferStats transferStats;
+		// Delivery feedback for the server's congestion controller: the reliable bytes received on the current connection.
+		// It is sent unreliably after every reliable packet and repeated from the frame loop, because the server stops sending
+		// once its window is full, so losing the feedback for the last window would otherwise stall the transfer for good.
+		uint64_t deliveredBytes = 0u;
+		const std::chrono::steady_clock::duration deliveryFeedbackInterval = std::chrono::milliseconds(50);
+		std::chrono::steady_clock::time_point lastDeliveryFeedbackTime;
+		const std::function<void()> sendDeliveryFeedback = [&connection, &deliveredBytes, &lastDeliveryFeedbackTime]()
 		{
-			SE_SCOPE_PROFILER("packetsize : " + std::to_string(readBuffer.getSize()));
-			if (reliable)
+			se::WriteBuffer writeBuffer;
+			writeBuffer.write(deliveredBytes);
+			connection->sendPacket(writeBuffer, false);
+			lastDeliveryFeedbackTime = std::chrono::steady_clock::now();
+		};
+		std::function<void(se::ReadBuffer&, const boost::asio::ip::udp::endpoint&, const bool)> receiveHandler = [&dataIndex, &transferStats, &previousDecodedDataIndex, &dataIndices, &deliveredBytes, &sendDeliveryFeedback, deltaEncoding](se::ReadBuffer& readBuffer, const boost::asio::ip::udp::endpoint&, const bool reliable)
+		{
+			SE_SCOPE_TRACE("packetsize : {}", readBuffer.getSize());
+			transferStats.add(readBuffer.getSize(), reliable);
+
+			size_t count = 0;
+			size_t validCount = 0;
+			if (deltaEncoding)
 			{
-				reliableBytesReceived += readBuffer.getSize();
+				const bool decoded = se::readDeltaBlock(readBuffer, dataIndices, previousDecodedDataIndex);
+				se_assert(decoded && "Packet data is corrupt.");
+				count = dataIndices.size();
+				validCount = se::findSequenceMismatch(dataIndices.data(), count, dataIndex);
 			}
-
-			const size_t count = readBuffer.getSize() / sizeof(uint64_t);
-			for (size_t i = 0; i < count; i++)
+			else if (se::getNativeByteOrder() == se::ByteOrder::Little)
 			{
-				uint64_t data;
-				if (readBuffer.read(data))
-				{
-					se_assert(data == dataIndex);
-					dataIndex++;
-					const se::time::Time now = se::time::now();
-					const se::time::Time timeSinceBegin = now - beginTime;
-					const double reliableBytesPerSecond = double(reliableBytesReceived) / double(timeSinceBegin.asSeconds());
-					//se::log::info("Data index: " + std::to_string(dataIndex) +
-					//	"\trMB: " + std::to_string(reliableBytesReceived / 1024.0) +
-					//	"\trMBps: " + std::to_string(reliableBytesPerSecond / 1024.0));
-				}
+				// The wire format is little endian, so the packet can be verified in place without decoding it
+				count = readBuffer.getBytesRemaining() / sizeof(uint64_t);
+				validCount = se::findSequenceMismatch((const uint8_t*)readBuffer.getData() + readBuffer.getOffset(), count, dataIndex);
+				readBuffer.translate(int(count * sizeof(uint64_t)));
 			}
+			else
+			{
+				const bool read = se::readArray(readBuffer, dataIndices, readBuffer.getBytesRemaining() / sizeof(uint64_t));
+				se_assert(read && "Packet data is corrupt.");
+				count = dataIndices.size();
+				validCount = se::findSequenceMismatch(dataIndices.data(), count, dataIndex);
+			}
+			se_assert(validCount == count && "Packet data is out of sequence.");
+			dataIndex += count;
 			se_assert(readBuffer.getBytesRemaining() == 0);
+
+			if (reliable)
+			{
+				deliveredBytes += readBuffer.getSize();
+				sendDeliveryFeedback();
+			}
 		};
 
 		while (true)
@@ -159,17 +213,25 @@ int main()
 				connection = connectionManager.startConnecting(serverEndpoint);
 				if (connection)
 				{
-					connection->connectToStatusChangedSignal(connectionStatusChangedConnection, [&connection, receiveHandler](const se::net::Connection::Status oldStatus, const se::net::Connection::Status newStatus)
+					connection->connectToStatusChangedSignal(connectionStatusChangedConnection, [&connection, &dataIndex, &previousDecodedDataIndex, &deliveredBytes, receiveHandler](const se::net::Connection::Status oldStatus, const se::net::Connection::Status newStatus)
 						{
 							se::log::info("Client: connection status changed: " + se::toString(int(oldStatus)) + "->" + std::to_string(int(newStatus)));
 							if (newStatus == se::net::Connection::Status::Connected)
 							{
 								se_assert(connection);
+								// The server starts the sequence and its congestion controller over for every connection
+								dataIndex = 0u;
+								previousDecodedDataIndex = 0u;
+								deliveredBytes = 0u;
 								connection->setReceiveHandler(receiveHandler);
 							}
 						});
 				}
 			}
+			else if (connection->getStatus() == se::net::Connection::Status::Connected && std::chrono::steady_clock::now() - lastDeliveryFeedbackTime >= deliveryFeedbackInterval)
+			{
+				sendDeliveryFeedback();
+			}
 
 			//Input
 			input.update();
@@ -184,6 +246,17 @@ int main()
 			consoleVisualizer.update(deltaTimeSystem.deltaTime);
 			connectionManager.update();
 			scopeProfilerVisualizer.update(deltaTimeSystem.deltaTime);
+			if (scopeTrace)
+			{
+				se::ScopeTrace::appendChromeTraceFile("netclient_trace.json");
+			}
+			if (transferStats.update())
+			{
+				se::log::info("Data index: " + std::to_string(dataIndex) +
+					"\tReceived: " + se::toByteString(transferStats.getTotalBytes()) +
+					"\tReliable: " + se::toByteString(uint64_t(transferStats.getLastSample().reliableBytesPerSecond)) + "/s" +
+					"\tPackets: " + std::to_string(uint64_t(transferStats.getLastSample().packetsPerSecond)) + "/s");
+			}
 			if (inputManager.isKeyPressed(unsigned(se::input::Key::BACKSPACE)))
 			{
 				if (connection)
@@ -203,24 +276,31 @@ int main()
 	}
 	else
 	{
-		std::function<void(se::ReadBuffer&, const boost::asio::ip::udp::endpoint&, const bool)> receiveHandler = [beginTime](se::ReadBuffer& readBuffer, const boost::asio::ip::udp::endpoint&, const bool reliable)
-		{
-			SE_SCOPE_PROFILER("packetsize : " + std::to_string(readBuffer.getSize()));
-			se::log::info("Received packet that contains " + std::to_string(readBuffer.getSize()) + " bytes.");
-			uint8_t expectedDataIndex = 0;
-			while (readBuffer.getBytesRemaining())
+		// The server streams its payloads, each chunk is verified as it arrives and is not kept
+		se::TypelessMessageRouter messageRouter;
+		// Streams belong to a single connection and can't finish after it is gone, so they are dropped together with the multiplexer when reconnecting
+		std::unique_ptr<se::StreamMultiplexer> streamMultiplexer;
+		std::vector<std::shared_ptr<se::IncomingStream>> incomingStreams;
+		const std::function<void(const std::shared_ptr<se::IncomingStream>&)> incomingStreamHandler = [&incomingStreams](const std::shared_ptr<se::IncomingStream>& stream)
 			{
-				uint8_t dataIndex = 0;
-				if (readBuffer.read(dataIndex))
-				{
-					se_assert(dataIndex == expectedDataIndex);
-					expectedDataIndex++;
-				}
-				else
-				{
-					se_assert(false && "Packet data is corrupt.");
-				}
-			}
+				incomingStreams.push_back(stream);
+				se::IncomingStream& incomingStream = *stream;
+				incomingStream.setChunkHandler([&incomingStream](const uint8_t* data, const size_t size)
+					{
+						// The received byte count already includes this chunk
+						const uint64_t offset = incomingStream.getBytesReceived() - size;
+						const size_t validCount = se::findByteSequenceMismatch(data, size, uint8_t(offset));
+						se_assert(validCount == size && "Stream data is out of sequence.");
+					});
+				incomingStream.setEndHandler([&incomingStream]()
+					{
+						se::log::info("Received stream that contains " + std::to_string(incomingStream.getBytesReceived()) + " bytes.");
+					});
+			};
+		std::function<void(se::ReadBuffer&, const boost::asio::ip::udp::endpoint&, const bool)> receiveHandler = [&messageRouter](se::ReadBuffer& readBuffer, const boost::asio::ip::udp::endpoint&, const bool reliable)
+		{
+			SE_SCOPE_TRACE("packetsize : {}", readBuffer.getSize());
+			messageRouter.routeAll(readBuffer, reliable);
 		};
 
 		while (true)
@@ -231,8 +311,12 @@ int main()
 			if (!connection || connection->getStatus() == se::net::Connection::Status::Disconnected)
 			{
 				connection = connectionManager.startConnecting(serverEndpoint);
+				incomingStreams.clear();
+				streamMultiplexer.reset();
 				if (connection)
 				{
+					streamMultiplexer = std::make_unique<se::StreamMultiplexer>(messageRouter, connection);
+					streamMultiplexer->setIncomingStreamHandler(incomingStreamHandler);
 					connection->connectToStatusChangedSignal(connectionStatusChangedConnection, [&connection, receiveHandler](const se::net::Connection::Status oldStatus, const se::net::Connection::Status newStatus)
 						{
 							se::log::info("Client: connection status changed: " + se::toString(int(oldStatus)) + "->" + std::to_string(int(newStatus)));
@@ -258,6 +342,12 @@ int main()
 			consoleVisualizer.update(deltaTimeSystem.deltaTime);
 			connectionManager.update();
 			scopeProfilerVisualizer.update(deltaTimeSystem.deltaTime);
+			if (scopeTrace)
+			{
+				se::ScopeTrace::appendChromeTraceFile("netclient_trace.json");
+			}
+			incomingStreams.erase(std::remove_if(incomingStreams.begin(), incomingStreams.end(),
+				[](const std::shared_ptr<se::IncomingStream>& stream) { return stream->isFinished() || stream->isCanceled(); }), incomingStreams.end());
 			if (inputManager.isKeyPressed(unsigned(se::input::Key::BACKSPACE)))
 			{
 				if (connection)
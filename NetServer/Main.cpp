@@ -33,7 +33,19 @@
 #include "SpehsEngine/Debug/DebugLib.h"
 #include "SpehsEngine/Debug/ScopeProfilerVisualizer.h"
 #include "SpehsEngine/Debug/ConnectionManagerVisualizer.h"
+#include "Sandbox/ArraySerialization.h"
+#include "Sandbox/BroadcastGroup.h"
+#include "Sandbox/CongestionController.h"
+#include "Sandbox/ConnectionMetrics.h"
+#include "Sandbox/IntegerCoding.h"
+#include "Sandbox/MessageStream.h"
+#include "Sandbox/ShardedConnectionServer.h"
+#include "Sandbox/TypelessMessageRouter.h"
+#include "Sandbox/UpdateLoop.h"
+#include <atomic>
+#include <functional>
 #include <thread>
+#include <unordered_map>
 #pragma optimize("", off)
 
 int main()
@@ -48,17 +60,59 @@ int main()
 	se::GUILib gui(input, audio);
 	se::debug::DebugLib debug(gui);
 
-	se::net::ConnectionManager2 connectionManager2("server");
-	connectionManager2.startListening(41623);
-	boost::signals2::scoped_connection incomingConnectionScopedConnection;
-	std::vector<std::shared_ptr<se::net::Connection2>> connections;
-	connectionManager2.connectToIncomingConnectionSignal(incomingConnectionScopedConnection, [&connections](std::shared_ptr<se::net::Connection2>& connection)
+	// Clients ask the directory on the well-known port which shard port to connect to
+	se::ShardedConnectionServer::Settings shardedServerSettings;
+	shardedServerSettings.port = 41623;
+	shardedServerSettings.shardCount = 4;
+	// Per connection metrics, each map is only touched from its own shard thread
+	se::ConnectionMetricsRegistry metricsRegistry;
+	std::vector<std::unordered_map<const se::net::Connection2*, std::shared_ptr<se::ConnectionMetrics>>> shardConnectionMetrics(shardedServerSettings.shardCount);
+	std::atomic<uint64_t> connectionCounter = 0;
+	se::ShardedConnectionServer shardedServer(shardedServerSettings,
+		[&metricsRegistry, &shardConnectionMetrics, &connectionCounter](se::ShardedConnectionServer::Shard& shard, std::shared_ptr<se::net::Connection2>& connection)
 		{
-			connections.push_back(connection);
+			se::log::info("Server: incoming connection accepted on shard " + std::to_string(shard.getIndex()));
+			const std::shared_ptr<se::ConnectionMetrics> connectionMetrics = std::make_shared<se::ConnectionMetrics>(
+				"shard " + std::to_string(shard.getIndex()) + " connection " + std::to_string(connectionCounter++));
+			const std::shared_ptr<se::TypelessMessageRouter> messageRouter = std::make_shared<se::TypelessMessageRouter>();
+			connectionMetrics->setProbeHandlers(*messageRouter, connection);
+			shard.setReceiveHandler(*connection, [connectionMetrics, messageRouter](se::ReadBuffer& readBuffer, const bool reliable)
+				{
+					connectionMetrics->recordReceived(readBuffer.getSize(), reliable);
+					messageRouter->routeAll(readBuffer, reliable);
+				});
+			shardConnectionMetrics[shard.getIndex()][connection.get()] = connectionMetrics;
+			metricsRegistry.add(connectionMetrics);
+
+			se::WriteBuffer writeBuffer;
+			se::TypelessMessageRouter::write(writeBuffer, std::string("welcome to shard " + std::to_string(shard.getIndex())));
+			connectionMetrics->sendPacket(*connection, writeBuffer, true);
+		},
+		[&shardConnectionMetrics](se::ShardedConnectionServer::Shard& shard, std::shared_ptr<se::net::Connection2>& connection)
+		{
+			shardConnectionMetrics[shard.getIndex()].erase(connection.get());
 		});
+	shardedServer.start();
 	while (true)
 	{
-		connectionManager2.update();
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		shardedServer.postToAll([&shardConnectionMetrics](se::ShardedConnectionServer::Shard& shard)
+			{
+				for (const std::shared_ptr<se::net::Connection2>& connection : shard.getConnections())
+				{
+					const std::unordered_map<const se::net::Connection2*, std::shared_ptr<se::ConnectionMetrics>>::iterator it = shardConnectionMetrics[shard.getIndex()].find(connection.get());
+					if (it != shardConnectionMetrics[shard.getIndex()].end() && connection->isConnected())
+					{
+						se::WriteBuffer writeBuffer;
+						it->second->writePing(writeBuffer);
+						it->second->sendPacket(*connection, writeBuffer, false);
+						it->second->sampleConnection(*connection);
+						it->second->publish();
+					}
+				}
+			});
+		// Picked up by the node exporter textfile collector, or read directly
+		metricsRegistry.writePrometheusFile("netserver_connections.prom");
 	}
 
 	se::Inifile inifile("netserver");
@@ -67,6 +121,7 @@ int main()
 	se::Inivar<unsigned>& windowHeight = inifile.get("video", "window_height", 900u);
 	se::Inivar<unsigned>& limitFps = inifile.get("video", "limit_fps", 60u);
 	const se::net::Port port(inifile.get("network", "port", uint16_t(41667)));
+	const bool deltaEncoding = inifile.get("network", "delta_encoding", true); // Must match the client
 	inifile.write();
 	
 	const se::time::Time minFrameTime = se::time::fromSeconds(1.0f / float(limitFps));
@@ -124,115 +179,202 @@ int main()
 	if (false)
 	{
 		// Continuous file transfer
+		// The send rate of each connection is set by its congestion controller, which the client feeds with the number of bytes it has received.
+		// Sends are driven by a per connection timer that waits for the pacer, so packets go out spread evenly instead of in one burst per frame.
+		const se::CongestionController::Settings congestionSettings;
+		const size_t indicesPerPacket = congestionSettings.maxPacketSize / sizeof(uint64_t);
 		struct Connection
 		{
+			Connection(const se::CongestionController::Settings& congestionSettings, const std::string& name)
+				: congestionController(congestionSettings)
+				, metrics(std::make_shared<se::ConnectionMetrics>(name))
+			{
+			}
 			uint64_t dataIndex = 0u;
+			uint64_t previousEncodedDataIndex = 0u;
+			std::vector<uint64_t> dataIndices;
 			std::shared_ptr<se::net::Connection> connection;
+			se::CongestionController congestionController;
+			se::UpdateLoop::TimerId sendTimerId = 0; // 0 while window limited
+			std::shared_ptr<se::ConnectionMetrics> metrics;
+		};
+		std::vector<std::unique_ptr<Connection>> connections;
+		se::UpdateLoop updateLoop([&connectionManager]() { connectionManager.update(); });
+		std::function<void(Connection&)> sendPackets;
+		sendPackets = [&sendPackets, &updateLoop, deltaEncoding, indicesPerPacket](Connection& connection)
+		{
+			connection.sendTimerId = 0;
+			se::CongestionController::Clock::time_point now = se::CongestionController::Clock::now();
+			while (connection.congestionController.canSend(now))
+			{
+				se::WriteBuffer writeBuffer;
+				connection.dataIndices.resize(indicesPerPacket);
+				for (uint64_t& dataIndex : connection.dataIndices)
+				{
+					dataIndex = connection.dataIndex++;
+				}
+				if (deltaEncoding)
+				{
+					se::writeDeltaBlock(writeBuffer, connection.dataIndices.data(), indicesPerPacket, connection.previousEncodedDataIndex);
+				}
+				else
+				{
+					se::writeArray(writeBuffer, connection.dataIndices);
+				}
+				connection.metrics->sendPacket(*connection.connection, writeBuffer, true);
+				connection.congestionController.onPacketSent(writeBuffer.getSize(), now);
+				now = se::CongestionController::Clock::now();
+			}
+			const se::CongestionController::Clock::duration sendDelay = connection.congestionController.getSendDelay(now);
+			if (sendDelay > se::CongestionController::Clock::duration::zero())
+			{
+				connection.sendTimerId = updateLoop.addTimer(sendDelay, [&sendPackets, &connection]() { sendPackets(connection); });
+			}
+			// Otherwise the congestion window is full, delivery feedback resumes sending
 		};
-		std::vector<Connection> connections;
 		boost::signals2::scoped_connection incomingConnection;
-		connectionManager.connectToIncomingConnectionSignal(incomingConnection, [&guiContext, &connections](std::shared_ptr<se::net::Connection>& connection)
+		connectionManager.connectToIncomingConnectionSignal(incomingConnection, [&connections, &congestionSettings, &updateLoop, &sendPackets, &metricsRegistry](std::shared_ptr<se::net::Connection>& connection)
 			{
-				connections.push_back(Connection());
-				connections.back().connection = connection;
+				connections.push_back(std::make_unique<Connection>(congestionSettings, connection->debugEndpoint));
+				Connection& newConnection = *connections.back();
+				newConnection.connection = connection;
+				metricsRegistry.add(newConnection.metrics);
+				connection->setReceiveHandler([&newConnection, &updateLoop, &sendPackets](se::ReadBuffer& readBuffer, const boost::asio::ip::udp::endpoint&, const bool reliable)
+					{
+						updateLoop.notifyActivity();
+						newConnection.metrics->recordReceived(readBuffer.getSize(), reliable);
+						// Delivery feedback: the total number of reliable bytes the client has received
+						uint64_t deliveredBytes = 0;
+						if (readBuffer.read(deliveredBytes))
+						{
+							newConnection.congestionController.onDelivered(deliveredBytes, se::CongestionController::Clock::now());
+							if (newConnection.sendTimerId == 0)
+							{
+								sendPackets(newConnection);
+							}
+						}
+					});
 				se::log::info("Server: incoming connection accepted: " + connection->debugEndpoint);
+				sendPackets(newConnection);
 			});
 
-		uint64_t targetBytesPerSecond = 1024 * 1024;
-		const se::time::Time sendInterval = se::time::fromSeconds(1.0f / 30.0f);
-		se::time::Time lastSendTime;
-		while (true)
-		{
-			const se::time::ScopedFrameLimiter frameLimiter(minFrameTime);
-
-			connectionManager.update();
-			for (Connection& connection : connections)
+		// The window is rendered from a timer so that it does not hold up the send timers
+		const se::UpdateLoop::Clock::duration frameInterval = std::chrono::duration_cast<se::UpdateLoop::Clock::duration>(std::chrono::duration<float>(minFrameTime.asSeconds()));
+		updateLoop.addTimer(std::chrono::seconds(1), [&connections, &metricsRegistry]()
+			{
+				for (const std::unique_ptr<Connection>& connection : connections)
+				{
+					connection->metrics->sampleConnection(*connection->connection);
+					connection->metrics->publish();
+				}
+				metricsRegistry.writePrometheusFile("netserver_connections.prom");
+			}, std::chrono::seconds(1));
+		updateLoop.addTimer(se::UpdateLoop::Clock::duration::zero(), [&]()
 			{
-				if (se::time::now() - lastSendTime > sendInterval)
+				//Input
+				input.update();
+				audio.update();
+				eventCatcher.pollEvents();
+				eventSignaler.signalEvents(eventCatcher);
+				inputManager.update(eventCatcher);
+
+				//Update
+				deltaTimeSystem.deltaTimeSystemUpdate();
+				inifile.update();
+				consoleVisualizer.update(deltaTimeSystem.deltaTime);
+				scopeProfilerVisualizer.update(deltaTimeSystem.deltaTime);
+				if (inputManager.isKeyPressed(unsigned(se::input::Key::BACKSPACE)))
 				{
-					se::WriteBuffer writeBuffer;
-					const size_t count = size_t(float(targetBytesPerSecond) * sendInterval.asSeconds());
-					for (size_t i = 0; i < count; i++)
+					for (const std::unique_ptr<Connection>& connection : connections)
 					{
-						writeBuffer.write(connection.dataIndex++);
+						connection->connection->resetReliableFragmentSendCounters();
+						connection->connection->resetMutexTimes();
 					}
-					connection.connection->sendPacket(writeBuffer, true);
-					lastSendTime = se::time::now();
 				}
-			}
 
-			//Input
-			input.update();
-			audio.update();
-			eventCatcher.pollEvents();
-			eventSignaler.signalEvents(eventCatcher);
-			inputManager.update(eventCatcher);
-
-			//Update
-			deltaTimeSystem.deltaTimeSystemUpdate();
-			inifile.update();
-			consoleVisualizer.update(deltaTimeSystem.deltaTime);
-			connectionManager.update();
-			scopeProfilerVisualizer.update(deltaTimeSystem.deltaTime);
-			if (inputManager.isKeyPressed(unsigned(se::input::Key::UP)))
-			{
-				targetBytesPerSecond = targetBytesPerSecond << 1;
-			}
-			if (inputManager.isKeyPressed(unsigned(se::input::Key::DOWN)))
-			{
-				targetBytesPerSecond = targetBytesPerSecond >> 1;
-			}
-			if (inputManager.isKeyPressed(unsigned(se::input::Key::BACKSPACE)))
-			{
-				for (Connection& connection : connections)
+				std::string string;
+				for (const std::unique_ptr<Connection>& connection : connections)
 				{
-					connection.connection->resetReliableFragmentSendCounters();
-					connection.connection->resetMutexTimes();
+					const se::CongestionController& congestionController = connection->congestionController;
+					string += (string.empty() ? "" : "\n") + connection->connection->debugEndpoint +
+						"  Rate: " + se::toByteString(congestionController.getPacingRate()) + "/s" +
+						"  Bandwidth: " + se::toByteString(congestionController.getBottleneckBandwidth()) + "/s" +
+						"  RTT: " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(congestionController.getMinRtt()).count()) + " ms" +
+						"  In flight: " + se::toByteString(congestionController.getBytesInFlight());
 				}
-			}
-			std::string string;
-			string = "Target Bps: " + se::toByteString(targetBytesPerSecond);
-			text.setString(string);
-			updateTextPosition();
+				text.setString(string);
+				updateTextPosition();
 
-			//Render
-			window.renderBegin();
-			imGuiBackendWrapper.render();
-			consoleVisualizer.render();
-			batchManager2D.render();
-			window.renderEnd();
-		}
+				//Render
+				window.renderBegin();
+				imGuiBackendWrapper.render();
+				consoleVisualizer.render();
+				batchManager2D.render();
+				window.renderEnd();
+			}, frameInterval);
+		updateLoop.run();
 	}
 	else
 	{
 		// Single packet transfer
+		// Payloads are streamed, neither end holds more than one flow control window of a transfer in memory regardless of the packet size
 		uint64_t packetSize = 4096;
+		const auto makePacketData = [](const uint64_t size)
+		{
+			std::vector<uint8_t> data(size);
+			uint8_t dataIndex = 0;
+			for (uint8_t& byte : data)
+			{
+				byte = dataIndex++;
+			}
+			return data;
+		};
+		const se::StreamSettings streamSettings;
+		// Byte n of a payload is uint8_t(n)
+		const std::vector<uint8_t> payloadPattern = makePacketData(256);
+		const auto makePayload = [&payloadPattern](const uint64_t size)
+		{
+			const std::shared_ptr<se::WriteBuffer> payload = std::make_shared<se::WriteBuffer>();
+			for (uint64_t offset = 0; offset < size; offset += payloadPattern.size())
+			{
+				payload->write(payloadPattern.data(), size_t(std::min(size - offset, uint64_t(payloadPattern.size()))));
+			}
+			return se::BroadcastGroup::Payload(payload);
+		};
 		struct Connection
 		{
 			std::shared_ptr<se::net::Connection> connection;
+			std::shared_ptr<se::TypelessMessageRouter> messageRouter;
+			std::unique_ptr<se::StreamMultiplexer> streamMultiplexer;
 		};
 		std::vector<Connection> connections;
+		// Every connection's stream multiplexer is a member
+		se::BroadcastGroup broadcastGroup;
 		boost::signals2::scoped_connection incomingConnection;
-		connectionManager.connectToIncomingConnectionSignal(incomingConnection, [&packetSize, &connections](std::shared_ptr<se::net::Connection>& connection)
+		connectionManager.connectToIncomingConnectionSignal(incomingConnection, [&connections, &streamSettings, &broadcastGroup, &makePayload, &packetSize](std::shared_ptr<se::net::Connection>& connection)
 			{
 				connections.push_back(Connection());
-				connections.back().connection = connection;
+				Connection& newConnection = connections.back();
+				newConnection.connection = connection;
+				newConnection.messageRouter = std::make_shared<se::TypelessMessageRouter>();
+				newConnection.streamMultiplexer = std::make_unique<se::StreamMultiplexer>(*newConnection.messageRouter, connection, streamSettings);
+				connection->setReceiveHandler([messageRouter = newConnection.messageRouter](se::ReadBuffer& readBuffer, const boost::asio::ip::udp::endpoint&, const bool reliable)
+					{
+						messageRouter->routeAll(readBuffer, reliable);
+					});
+				broadcastGroup.add(*newConnection.streamMultiplexer);
 				se::log::info("Server: incoming connection accepted: " + connection->debugEndpoint);
 
 				// Send data
-				se::WriteBuffer writeBuffer;
-				uint8_t dataIndex = 0;
-				for (uint64_t i = 0; i < packetSize; i++)
-				{
-					writeBuffer.write(dataIndex++);
-				}
-				connection->sendPacket(writeBuffer, true);
+				broadcastGroup.send(makePayload(packetSize), *newConnection.streamMultiplexer);
 			});
 		while (true)
 		{
 			const se::time::ScopedFrameLimiter frameLimiter(minFrameTime);
 
 			connectionManager.update();
+			// Written as far as each receiver's window allows, the rest is written on later frames
+			broadcastGroup.update();
 
 			//Input
 			input.update();
@@ -257,16 +399,8 @@ int main()
 			}
 			if (inputManager.isKeyPressed(unsigned(se::input::Key::RETURN)))
 			{
-				se::WriteBuffer writeBuffer;
-				uint8_t dataIndex = 0;
-				for (uint64_t i = 0; i < packetSize; i++)
-				{
-					writeBuffer.write(dataIndex++);
-				}
-				for (Connection& connection : connections)
-				{
-					connection.connection->sendPacket(writeBuffer, true);
-				}
+				// Serialized once, every connection streams from the same payload
+				broadcastGroup.send(makePayload(packetSize));
 			}
 			if (inputManager.isKeyPressed(unsigned(se::input::Key::BACKSPACE)))
 			{
@@ -278,6 +412,15 @@ int main()
 			}
 			std::string string;
 			string += "\nPacket size: " + se::toByteString(packetSize);
+			broadcastGroup.forEachTransfer([&connections, &string](const se::StreamMultiplexer& member, const se::OutgoingStream& stream)
+				{
+					const std::vector<Connection>::const_iterator it = std::find_if(connections.begin(), connections.end(),
+						[&member](const Connection& connection) { return connection.streamMultiplexer.get() == &member; });
+					if (it != connections.end())
+					{
+						string += "\n" + it->connection->debugEndpoint + "  Streaming: " + se::toByteString(stream.getBytesWritten()) + " / " + se::toByteString(stream.getExpectedSize());
+					}
+				});
 			text.setString(string);
 			updateTextPosition();
 
@@ -0,0 +1,474 @@
+#pragma once
+
+#include "SpehsEngine/Core/WriteBuffer.h"
+#include "SpehsEngine/Core/ReadBuffer.h"
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace se
+{
+	// Specialize as std::true_type to keep an aggregate from being reflected. Required for aggregates with anonymous unions that have no write/read functions, they can't be decomposed.
+	template<typename T>
+	struct DisableAggregateReflection : std::false_type
+	{
+	};
+
+	/*
+		Compile time reflection of plain aggregates, used to serialize aggregates that have no write/read functions of their own.
+		Fields are counted by brace initializing the aggregate with empty initializers and visited through structured bindings, up to maxFieldCount fields.
+		An aggregate is reflectable if all of its fields are arithmetic, enums, types with write/read functions, types that WriteBuffer and ReadBuffer
+		serialize themselves (such as std::string and std::vector), reflectable aggregates, or C arrays of any of these. Const fields are not supported.
+		Reflectable aggregates that are trivially copyable and have no padding are "packed" and serialized with a single memory copy.
+		Aggregates with base classes, or with fields that cannot be initialized from {}, are not reflected.
+		Tuple-like aggregates such as std::array are not reflected either, structured bindings would decompose them through std::tuple_size instead of by field.
+		Bit-fields can't be bound to references, so fields are only ever passed on as const references. Aggregates are read by reading every field into
+		a temporary and brace initializing the aggregate from them. Aggregates with C arrays can't be initialized that way, their fields are read in place,
+		which doesn't work for bit-fields: aggregates that have both C arrays and bit-fields fail to read.
+	*/
+	class AggregateReflection
+	{
+	public:
+
+		static constexpr size_t maxFieldCount = 16;
+
+		template<typename T>
+		static constexpr bool isReflectable()
+		{
+			return Reflectable<T>::value;
+		}
+
+		template<typename T>
+		static constexpr bool isPacked()
+		{
+			return Packed<T>::value;
+		}
+
+		template<typename T>
+		static constexpr size_t getFieldCount()
+		{
+			return FieldCount<T>::value;
+		}
+
+		// Does the type hold pointers, looking through arrays and the fields of reflected aggregates. Pointers inside other classes, including aggregates that serialize themselves, can't be seen.
+		template<typename T>
+		static constexpr bool hasPointers()
+		{
+			return HasPointers<T>::value;
+		}
+
+		/*
+			Hash of the memory layout: size, alignment and the offset and layout of each field, recursively through the fields of reflected aggregates as in hasPointers().
+			Other types contribute only their size, alignment and kind of value.
+		*/
+		template<typename T>
+		static uint64_t getLayoutFingerprint()
+		{
+			uint64_t hash = 14695981039346656037ull;
+			hashLayout<T>(hash);
+			return hash;
+		}
+
+		// Calls function(field) for each field of an aggregate
+		template<typename T, typename Function>
+		static void forEachField(const T& t, Function&& function)
+		{
+			constexpr size_t fieldCount = getFieldCount<T>();
+			static_assert(fieldCount > 0 && fieldCount <= maxFieldCount, "Type is not a reflectable aggregate.");
+			bindFields<fieldCount>(t, [&function](const auto&... fields)
+				{
+					(function(fields), ...);
+				});
+		}
+
+		template<typename T>
+		static void write(WriteBuffer& writeBuffer, const T& t)
+		{
+			static_assert(isReflectable<T>(), "Type is not reflectable.");
+			if constexpr (isPacked<T>())
+			{
+				writeBuffer.write(&t, sizeof(T));
+			}
+			else
+			{
+				forEachField(t, [&writeBuffer](const auto& field)
+					{
+						writeField(writeBuffer, field);
+					});
+			}
+		}
+
+		template<typename T>
+		static bool read(ReadBuffer& readBuffer, T& t)
+		{
+			static_assert(isReflectable<T>(), "Type is not reflectable.");
+			if constexpr (isPacked<T>())
+			{
+				return readBuffer.read(&t, sizeof(T));
+			}
+			else if constexpr (IsBraceConstructibleFrom<T, FieldTuple<T>>::value)
+			{
+				FieldTuple<T> values;
+				const bool result = std::apply([&readBuffer](auto&... fields)
+					{
+						return (readField(readBuffer, fields) && ...);
+					}, values);
+				if (result)
+				{
+					t = std::apply([](auto&... fields)
+						{
+							return T{ std::move(fields)... };
+						}, values);
+				}
+				return result;
+			}
+			else
+			{
+				return bindFields<getFieldCount<T>()>(t, [&readBuffer, &t](const auto&... fields)
+					{
+						return (readFieldInPlace(readBuffer, t, fields) && ...);
+					});
+			}
+		}
+
+	private:
+
+		// Binds the fields of t and calls function(fields...). This is the only place that decomposes aggregates.
+		template<size_t fieldCount, typename T, typename Function>
+		static decltype(auto) bindFields(T& t, Function&& function)
+		{
+#define SE_BIND_AGGREGATE_FIELDS(p_FieldCount, ...) else if constexpr (fieldCount == p_FieldCount) { auto& [__VA_ARGS__] = t; return function(__VA_ARGS__); }
+			if constexpr (fieldCount == 0) { return function(); }
+			SE_BIND_AGGREGATE_FIELDS(1, a)
+			SE_BIND_AGGREGATE_FIELDS(2, a, b)
+			SE_BIND_AGGREGATE_FIELDS(3, a, b, c)
+			SE_BIND_AGGREGATE_FIELDS(4, a, b, c, d)
+			SE_BIND_AGGREGATE_FIELDS(5, a, b, c, d, e)
+			SE_BIND_AGGREGATE_FIELDS(6, a, b, c, d, e, f)
+			SE_BIND_AGGREGATE_FIELDS(7, a, b, c, d, e, f, g)
+			SE_BIND_AGGREGATE_FIELDS(8, a, b, c, d, e, f, g, h)
+			SE_BIND_AGGREGATE_FIELDS(9, a, b, c, d, e, f, g, h, i)
+			SE_BIND_AGGREGATE_FIELDS(10, a, b, c, d, e, f, g, h, i, j)
+			SE_BIND_AGGREGATE_FIELDS(11, a, b, c, d, e, f, g, h, i, j, k)
+			SE_BIND_AGGREGATE_FIELDS(12, a, b, c, d, e, f, g, h, i, j, k, l)
+			SE_BIND_AGGREGATE_FIELDS(13, a, b, c, d, e, f, g, h, i, j, k, l, m)
+			SE_BIND_AGGREGATE_FIELDS(14, a, b, c, d, e, f, g, h, i, j, k, l, m, n)
+			SE_BIND_AGGREGATE_FIELDS(15, a, b, c, d, e, f, g, h, i, j, k, l, m, n, o)
+			SE_BIND_AGGREGATE_FIELDS(16, a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p)
+#undef SE_BIND_AGGREGATE_FIELDS
+		}
+
+		// Field counting
+		template<typename T, size_t Count, typename = void>
+		struct IsBraceConstructible : std::false_type {};
+		template<typename T>
+		struct IsBraceConstructible<T, 1, std::void_t<decltype(T{ {} })>> : std::true_type {};
+		template<typename T>
+		struct IsBraceConstructible<T, 2, std::void_t<decltype(T{ {}, {} })>> : std::true_type {};
+		template<typename T>
+		struct IsBraceConstructible<T, 3, std::void_t<decltype(T{ {}, {}, {} })>> : std::true_type {};
+		template<typename T>
+		struct IsBraceConstructible<T, 4, std::void_t<decltype(T{ {}, {}, {}, {} })>> : std::true_type {};
+		template<typename T>
+		struct IsBraceConstructible<T, 5, std::void_t<decltype(T{ {}, {}, {}, {}, {} })>> : std::true_type {};
+		template<typename T>
+		struct IsBraceConstructible<T, 6, std::void_t<decltype(T{ {}, {}, {}, {}, {}, {} })>> : std::true_type {};
+		template<typename T>
+		struct IsBraceConstructible<T, 7, std::void_t<decltype(T{ {}, {}, {}, {}, {}, {}, {} })>> : std::true_type {};
+		template<typename T>
+		struct IsBraceConstructible<T, 8, std::void_t<decltype(T{ {}, {}, {}, {}, {}, {}, {}, {} })>> : std::true_type {};
+		template<typename T>
+		struct IsBraceConstructible<T, 9, std::void_t<decltype(T{ {}, {}, {}, {}, {}, {}, {}, {}, {} })>> : std::true_type {};
+		template<typename T>
+		struct IsBraceConstructible<T, 10, std::void_t<decltype(T{ {}, {}, {}, {}, {}, {}, {}, {}, {}, {} })>> : std::true_type {};
+		template<typename T>
+		struct IsBraceConstructible<T, 11, std::void_t<decltype(T{ {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {} })>> : std::true_type {};
+		template<typename T>
+		struct IsBraceConstructible<T, 12, std::void_t<decltype(T{ {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {} })>> : std::true_type {};
+		template<typename T>
+		struct IsBraceConstructible<T, 13, std::void_t<decltype(T{ {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {} })>> : std::true_type {};
+		template<typename T>
+		struct IsBraceConstructible<T, 14, std::void_t<decltype(T{ {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {} })>> : std::true_type {};
+		template<typename T>
+		struct IsBraceConstructible<T, 15, std::void_t<decltype(T{ {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {} })>> : std::true_type {};
+		template<typename T>
+		struct IsBraceConstructible<T, 16, std::void_t<decltype(T{ {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {} })>> : std::true_type {};
+		template<typename T>
+		struct IsBraceConstructible<T, 17, std::void_t<decltype(T{ {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {} })>> : std::true_type {};
+		template<typename T, size_t Count = maxFieldCount + 1>
+		struct CountFields : std::conditional<
+			IsBraceConstructible<T, Count>::value,
+				std::integral_constant<size_t, Count>,
+				CountFields<T, Count - 1>>::type {};
+		template<typename T>
+		struct CountFields<T, 0> : std::integral_constant<size_t, 0> {};
+
+		// Class types that serialize themselves
+		template<typename T, bool = std::is_class<T>::value>
+		struct HasMemberSerializeFunctions : std::false_type {};
+		template<typename T>
+		struct HasMemberSerializeFunctions<T, true> : std::integral_constant<bool,
+			WriteBuffer::has_member_write<T, void(T::*)(WriteBuffer&) const>::value && ReadBuffer::has_member_read<T, bool(T::*)(ReadBuffer&)>::value> {};
+		template<typename T, bool = std::is_class<T>::value>
+		struct HasFreeSerializeFunctions : std::false_type {};
+		template<typename T>
+		struct HasFreeSerializeFunctions<T, true> : std::integral_constant<bool,
+			WriteBuffer::has_free_write<T>::value && ReadBuffer::has_free_read<T>::value> {};
+		template<typename T, bool = std::is_class<T>::value>
+		struct HasAnySerializeFunction : std::false_type {};
+		template<typename T>
+		struct HasAnySerializeFunction<T, true> : std::integral_constant<bool,
+			WriteBuffer::has_member_write<T, void(T::*)(WriteBuffer&) const>::value || WriteBuffer::has_free_write<T>::value ||
+			ReadBuffer::has_member_read<T, bool(T::*)(ReadBuffer&)>::value || ReadBuffer::has_free_read<T>::value> {};
+
+		// Only converts to base classes of T. If it can initialize the first element of T, the first element is a base class.
+		template<typename T>
+		struct BaseClassProbe
+		{
+			template<typename U, typename = typename std::enable_if<std::is_base_of<U, T>::value && !std::is_same<U, T>::value>::type>
+			operator U() const;
+		};
+		template<typename T, typename = void>
+		struct HasBaseClass : std::false_type {};
+		template<typename T>
+		struct HasBaseClass<T, std::void_t<decltype(T{ BaseClassProbe<T>{} })>> : std::true_type {};
+
+		template<typename T, typename = void>
+		struct IsTupleLike : std::false_type {};
+		template<typename T>
+		struct IsTupleLike<T, std::void_t<decltype(std::tuple_size<T>::value)>> : std::true_type {};
+
+		/*
+			Aggregates without base classes that don't serialize themselves.
+			Only these are decomposed, also for layout queries, so that aggregates with their own write/read functions never need to support structured bindings.
+		*/
+		template<typename T, bool = std::is_class<T>::value && std::is_aggregate<T>::value>
+		struct IsAggregateCandidate : std::false_type {};
+		template<typename T>
+		struct IsAggregateCandidate<T, true> : std::integral_constant<bool,
+			!DisableAggregateReflection<T>::value && !IsTupleLike<T>::value && !HasAnySerializeFunction<T>::value && !HasBaseClass<T>::value> {};
+
+		template<typename T, typename = void>
+		struct FieldCount : std::integral_constant<size_t, 0> {};
+		template<typename T>
+		struct FieldCount<T, typename std::enable_if<IsAggregateCandidate<T>::value>::type> : CountFields<T> {};
+
+		// Field types as a tuple type. Taken from const references, which bit-fields can bind to as temporaries.
+		template<typename T, size_t fieldCount>
+		static auto getFieldTypes(T& t)
+		{
+			return bindFields<fieldCount>(t, [](const auto&... fields)
+				{
+					return (std::tuple<typename std::remove_const<typename std::remove_reference<decltype(fields)>::type>::type...>*)nullptr;
+				});
+		}
+
+		template<typename T>
+		using FieldTuple = typename std::remove_pointer<decltype(getFieldTypes<T, FieldCount<T>::value>(std::declval<T&>()))>::type;
+
+		// Class types that WriteBuffer and ReadBuffer serialize themselves, like std::string. Containers also need serializable elements.
+		template<typename T, typename = void>
+		struct HasBufferSerializeFunctions : std::false_type {};
+		template<typename T>
+		struct HasBufferSerializeFunctions<T, typename std::enable_if<std::is_class<T>::value && std::is_convertible<
+			decltype(std::declval<WriteBuffer&>().write(std::declval<const T&>()), std::declval<ReadBuffer&>().read(std::declval<T&>())), bool>::value>::type>
+			: std::true_type {};
+		template<typename T>
+		struct HasSerializableElements : std::true_type {};
+
+		// Field types that serialize without reflection
+		template<typename T>
+		struct HasSerializeFunctions : std::integral_constant<bool,
+			std::is_arithmetic<T>::value || std::is_enum<T>::value || HasMemberSerializeFunctions<T>::value || HasFreeSerializeFunctions<T>::value
+			|| (HasBufferSerializeFunctions<T>::value && HasSerializableElements<T>::value)> {};
+		template<typename T, typename Allocator>
+		struct HasSerializableElements<std::vector<T, Allocator>> : HasSerializeFunctions<T> {};
+
+		template<typename T, typename = void>
+		struct Reflectable : std::false_type {};
+		template<typename T, typename = void>
+		struct IsSerializableField : std::integral_constant<bool, HasSerializeFunctions<T>::value || Reflectable<T>::value> {};
+		template<typename T>
+		struct IsSerializableField<T, typename std::enable_if<std::is_array<T>::value>::type> : IsSerializableField<typename std::remove_extent<T>::type> {};
+		template<typename Tuple>
+		struct AllFieldsSerializable;
+		template<typename... Fields>
+		struct AllFieldsSerializable<std::tuple<Fields...>> : std::integral_constant<bool, (IsSerializableField<Fields>::value && ...)> {};
+		// Const fields make the aggregate unassignable, which leaves them out
+		template<typename T>
+		struct Reflectable<T, typename std::enable_if<FieldCount<T>::value >= 1 && FieldCount<T>::value <= maxFieldCount>::type>
+			: std::integral_constant<bool, std::is_move_assignable<T>::value && AllFieldsSerializable<FieldTuple<T>>::value> {};
+
+		template<typename T, typename Tuple, typename = void>
+		struct IsBraceConstructibleFrom : std::false_type {};
+		template<typename T, typename... Fields>
+		struct IsBraceConstructibleFrom<T, std::tuple<Fields...>, std::void_t<decltype(T{ std::declval<Fields>()... })>> : std::true_type {};
+
+		// Packed: memory layout equals the field-wise layout, bool is excluded because not every byte value is a valid bool
+		template<typename T, typename = void>
+		struct Packed : std::integral_constant<bool, (std::is_arithmetic<T>::value && !std::is_same<T, bool>::value) || std::is_enum<T>::value> {};
+		template<typename T>
+		struct Packed<T, typename std::enable_if<std::is_array<T>::value>::type> : Packed<typename std::remove_extent<T>::type> {};
+		template<typename T, typename Tuple>
+		struct PackedFields;
+		template<typename T, typename... Fields>
+		struct PackedFields<T, std::tuple<Fields...>> : std::integral_constant<bool,
+			(Packed<Fields>::value && ...) && (sizeof(Fields) + ...) == sizeof(T)> {};
+		template<typename T>
+		struct Packed<T, typename std::enable_if<Reflectable<T>::value>::type> : std::integral_constant<bool,
+			std::is_trivially_copyable<T>::value && PackedFields<T, FieldTuple<T>>::value> {};
+
+		template<typename T, typename = void>
+		struct HasPointers : std::integral_constant<bool, std::is_pointer<T>::value || std::is_member_pointer<T>::value> {};
+		template<typename T>
+		struct HasPointers<T, typename std::enable_if<std::is_array<T>::value>::type> : HasPointers<typename std::remove_cv<typename std::remove_all_extents<T>::type>::type> {};
+		template<typename Tuple>
+		struct AnyFieldHasPointers;
+		template<typename... Fields>
+		struct AnyFieldHasPointers<std::tuple<Fields...>> : std::integral_constant<bool,
+			(HasPointers<typename std::remove_cv<Fields>::type>::value || ...)> {};
+		template<typename T>
+		struct HasPointers<T, typename std::enable_if<FieldCount<T>::value >= 1 && FieldCount<T>::value <= maxFieldCount>::type>
+			: AnyFieldHasPointers<FieldTuple<T>> {};
+
+		// FNV-1a
+		static void hashValue(uint64_t& hash, const uint64_t value)
+		{
+			for (size_t i = 0; i < 8; i++)
+			{
+				hash = (hash ^ ((value >> (i * 8)) & 0xff)) * 1099511628211ull;
+			}
+		}
+
+		template<typename T>
+		static void hashLayout(uint64_t& hash)
+		{
+			hashValue(hash, sizeof(T));
+			hashValue(hash, alignof(T));
+			if constexpr (std::is_array<T>::value)
+			{
+				hashLayout<typename std::remove_cv<typename std::remove_extent<T>::type>::type>(hash);
+			}
+			else if constexpr (FieldCount<T>::value >= 1 && FieldCount<T>::value <= maxFieldCount)
+			{
+				hashValue(hash, FieldCount<T>::value);
+				const T t{};
+				forEachField(t, [&hash, &t](const auto& field)
+					{
+						hashValue(hash, isMember(t, field) ? uint64_t(uintptr_t(&field) - uintptr_t(&t)) : ~uint64_t(0));
+						hashLayout<typename std::remove_cv<typename std::remove_reference<decltype(field)>::type>::type>(hash);
+					});
+			}
+			else
+			{
+				hashValue(hash, uint64_t(std::is_floating_point<T>::value)
+					| uint64_t(std::is_signed<T>::value) << 1
+					| uint64_t(std::is_enum<T>::value) << 2
+					| uint64_t(std::is_same<T, bool>::value) << 3
+					| uint64_t(HasPointers<T>::value) << 4
+					| uint64_t(std::is_class<T>::value) << 5);
+			}
+		}
+
+		// Bit-fields are passed as temporaries that lie outside of the object
+		template<typename T, typename Field>
+		static bool isMember(const T& t, const Field& field)
+		{
+			const uintptr_t begin = uintptr_t(&t);
+			const uintptr_t address = uintptr_t(&field);
+			return address >= begin && address < begin + sizeof(T);
+		}
+
+		template<typename T, typename Field>
+		static bool readFieldInPlace(ReadBuffer& readBuffer, T& t, const Field& field)
+		{
+			if (!isMember(t, field))
+			{
+				se_assert(false && "Bit-fields can't be read in place, see AggregateReflection.");
+				return false;
+			}
+			// The field is a member of the non-const t
+			return readField(readBuffer, const_cast<Field&>(field));
+		}
+
+		template<typename Field>
+		static void writeField(WriteBuffer& writeBuffer, const Field& field)
+		{
+			if constexpr (std::is_array<Field>::value && Packed<Field>::value)
+			{
+				writeBuffer.write(&field, sizeof(Field));
+			}
+			else if constexpr (std::is_array<Field>::value)
+			{
+				for (const auto& element : field)
+				{
+					writeField(writeBuffer, element);
+				}
+			}
+			else if constexpr (!HasSerializeFunctions<Field>::value)
+			{
+				write(writeBuffer, field);
+			}
+			else if constexpr (!std::is_class<Field>::value)
+			{
+				writeBuffer.write(field);
+			}
+			else if constexpr (HasMemberSerializeFunctions<Field>::value)
+			{
+				field.write(writeBuffer);
+			}
+			else if constexpr (HasFreeSerializeFunctions<Field>::value)
+			{
+				writeToBuffer(writeBuffer, field);
+			}
+			else
+			{
+				writeBuffer.write(field);
+			}
+		}
+
+		template<typename Field>
+		static bool readField(ReadBuffer& readBuffer, Field& field)
+		{
+			if constexpr (std::is_array<Field>::value && Packed<Field>::value)
+			{
+				return readBuffer.read(&field, sizeof(Field));
+			}
+			else if constexpr (std::is_array<Field>::value)
+			{
+				for (auto& element : field)
+				{
+					if (!readField(readBuffer, element))
+					{
+						return false;
+					}
+				}
+				return true;
+			}
+			else if constexpr (!HasSerializeFunctions<Field>::value)
+			{
+				return read(readBuffer, field);
+			}
+			else if constexpr (!std::is_class<Field>::value)
+			{
+				return readBuffer.read(field);
+			}
+			else if constexpr (HasMemberSerializeFunctions<Field>::value)
+			{
+				return field.read(readBuffer);
+			}
+			else if constexpr (HasFreeSerializeFunctions<Field>::value)
+			{
+				return readFromBuffer(readBuffer, field);
+			}
+			else
+			{
+				return readBuffer.read(field);
+			}
+		}
+	};
+}
@@ -0,0 +1,147 @@
+#include "stdafx.h"
+#include "Sandbox/ArraySerialization.h"
+
+#include "SpehsEngine/Core/WriteBuffer.h"
+#include "SpehsEngine/Core/ReadBuffer.h"
+#include <algorithm>
+#include <string.h>
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <tmmintrin.h>
+#define SE_BYTE_SWAP_SSSE3
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+// MSVC never defines __SSSE3__ and defines __AVX__ only with /arch:AVX, but the intrinsics are available regardless, so SSSE3 is checked at run time
+#include <intrin.h>
+#include <tmmintrin.h>
+#define SE_BYTE_SWAP_SSSE3
+#define SE_BYTE_SWAP_SSSE3_CPUID
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define SE_BYTE_SWAP_NEON
+#endif
+
+
+namespace se
+{
+	namespace
+	{
+#if defined(SE_BYTE_SWAP_SSSE3_CPUID)
+		const bool ssse3Supported = []()
+		{
+			int cpuInfo[4];
+			__cpuid(cpuInfo, 1);
+			return (cpuInfo[2] & (1 << 9)) != 0;
+		}();
+#endif
+
+		// Written with shifts so that compilers emit a single byte swap instruction
+		inline uint16_t byteSwapScalar(const uint16_t value)
+		{
+			return uint16_t((value >> 8) | (value << 8));
+		}
+
+		inline uint32_t byteSwapScalar(const uint32_t value)
+		{
+			return (value >> 24) | ((value >> 8) & 0x0000ff00u) | ((value << 8) & 0x00ff0000u) | (value << 24);
+		}
+
+		inline uint64_t byteSwapScalar(const uint64_t value)
+		{
+			return (uint64_t(byteSwapScalar(uint32_t(value))) << 32) | byteSwapScalar(uint32_t(value >> 32));
+		}
+
+		template<typename T>
+		void byteSwapElements(uint8_t* const destination, const uint8_t* const source, const size_t count)
+		{
+			size_t i = 0;
+#if defined(SE_BYTE_SWAP_SSSE3)
+#if defined(SE_BYTE_SWAP_SSSE3_CPUID)
+			if (ssse3Supported)
+#endif
+			{
+				const __m128i shuffle = sizeof(T) == 2
+					? _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)
+					: sizeof(T) == 4
+						? _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)
+						: _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+				constexpr size_t elementsPerVector = 16 / sizeof(T);
+				for (; i + elementsPerVector <= count; i += elementsPerVector)
+				{
+					const __m128i vector = _mm_loadu_si128((const __m128i*)(source + i * sizeof(T)));
+					_mm_storeu_si128((__m128i*)(destination + i * sizeof(T)), _mm_shuffle_epi8(vector, shuffle));
+				}
+			}
+#elif defined(SE_BYTE_SWAP_NEON)
+			constexpr size_t elementsPerVector = 16 / sizeof(T);
+			for (; i + elementsPerVector <= count; i += elementsPerVector)
+			{
+				const uint8x16_t vector = vld1q_u8(source + i * sizeof(T));
+				const uint8x16_t swapped = sizeof(T) == 2 ? vrev16q_u8(vector) : sizeof(T) == 4 ? vrev32q_u8(vector) : vrev64q_u8(vector);
+				vst1q_u8(destination + i * sizeof(T), swapped);
+			}
+#endif
+			for (; i < count; i++)
+			{
+				T value;
+				memcpy(&value, source + i * sizeof(T), sizeof(T));
+				value = byteSwapScalar(value);
+				memcpy(destination + i * sizeof(T), &value, sizeof(T));
+			}
+		}
+	}
+
+	void byteSwap(void* const destination, const void* const source, const size_t count, const size_t elementSize)
+	{
+		switch (elementSize)
+		{
+		case 1:
+			if (destination != source)
+			{
+				memmove(destination, source, count);
+			}
+			break;
+		case 2: byteSwapElements<uint16_t>((uint8_t*)destination, (const uint8_t*)source, count); break;
+		case 4: byteSwapElements<uint32_t>((uint8_t*)destination, (const uint8_t*)source, count); break;
+		case 8: byteSwapElements<uint64_t>((uint8_t*)destination, (const uint8_t*)source, count); break;
+		default:
+			se_assert(false && "Unsupported element size.");
+			break;
+		}
+	}
+
+	void writeArrayBytes(WriteBuffer& writeBuffer, const void* const data, const size_t count, const size_t elementSize, const ByteOrder wireByteOrder)
+	{
+		if (wireByteOrder == getNativeByteOrder() || elementSize == 1)
+		{
+			writeBuffer.write(data, count * elementSize);
+			return;
+		}
+
+		// Swap through a stack chunk so that the source array is left untouched
+		uint8_t chunk[4096];
+		const size_t chunkCount = sizeof(chunk) / elementSize;
+		for (size_t offset = 0; offset < count; offset += chunkCount)
+		{
+			const size_t n = std::min(chunkCount, count - offset);
+			byteSwap(chunk, (const uint8_t*)data + offset * elementSize, n, elementSize);
+			writeBuffer.write(chunk, n * elementSize);
+		}
+	}
+
+	bool readArrayBytes(ReadBuffer& readBuffer, void* const data, const size_t count, const size_t elementSize, const ByteOrder wireByteOrder)
+	{
+		if (count > readBuffer.getBytesRemaining() / elementSize)
+		{
+			return false;
+		}
+		if (!readBuffer.read(data, count * elementSize))
+		{
+			return false;
+		}
+		if (wireByteOrder != getNativeByteOrder() && elementSize > 1)
+		{
+			byteSwap(data, data, count, elementSize);
+		}
+		return true;
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <type_traits>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace se
+{
+	class WriteBuffer;
+	class ReadBuffer;
+
+	enum class ByteOrder : uint8_t
+	{
+		Little,
+		Big,
+	};
+
+	// Byte order of the host
+	constexpr ByteOrder getNativeByteOrder()
+	{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		return ByteOrder::Big;
+#else
+		return ByteOrder::Little;
+#endif
+	}
+
+	/*
+		Reverses the byte order of count elements of elementSize bytes (2, 4 or 8), from source to destination.
+		source and destination may be the same memory. Uses SIMD shuffles where available.
+	*/
+	void byteSwap(void* const destination, const void* const source, const size_t count, const size_t elementSize);
+
+	/*
+		Bulk serialization of arithmetic arrays without per-element calls.
+		Elements are written back to back without a count, which is the same layout as writing them one by one in the wire byte order.
+		When the wire byte order matches the host, the array is a single memory copy.
+	*/
+	void writeArrayBytes(WriteBuffer& writeBuffer, const void* const data, const size_t count, const size_t elementSize, const ByteOrder wireByteOrder);
+	bool readArrayBytes(ReadBuffer& readBuffer, void* const data, const size_t count, const size_t elementSize, const ByteOrder wireByteOrder);
+
+	template<typename T>
+	void writeArray(WriteBuffer& writeBuffer, const T* const values, const size_t count, const ByteOrder wireByteOrder = ByteOrder::Little)
+	{
+		static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "Only arithmetic arrays can be bulk serialized.");
+		writeArrayBytes(writeBuffer, values, count, sizeof(T), wireByteOrder);
+	}
+
+	template<typename T>
+	bool readArray(ReadBuffer& readBuffer, T* const values, const size_t count, const ByteOrder wireByteOrder = ByteOrder::Little)
+	{
+		static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "Only arithmetic arrays can be bulk serialized.");
+		return readArrayBytes(readBuffer, values, count, sizeof(T), wireByteOrder);
+	}
+
+	template<typename T>
+	void writeArray(WriteBuffer& writeBuffer, const std::vector<T>& values, const ByteOrder wireByteOrder = ByteOrder::Little)
+	{
+		writeArray(writeBuffer, values.data(), values.size(), wireByteOrder);
+	}
+
+	// Resizes values to count before reading. Fails without resizing if the buffer doesn't hold count elements.
+	template<typename T>
+	bool readArray(ReadBuffer& readBuffer, std::vector<T>& values, const size_t count, const ByteOrder wireByteOrder = ByteOrder::Little)
+	{
+		if (count > readBuffer.getBytesRemaining() / sizeof(T))
+		{
+			return false;
+		}
+		values.resize(count);
+		return readArray(readBuffer, values.data(), count, wireByteOrder);
+	}
+}
@@ -0,0 +1,69 @@
+#include "stdafx.h"
+#include "Sandbox/BroadcastGroup.h"
+
+#include <algorithm>
+
+
+namespace se
+{
+	void BroadcastGroup::add(StreamMultiplexer& member)
+	{
+		if (std::find(members.begin(), members.end(), &member) == members.end())
+		{
+			members.push_back(&member);
+		}
+	}
+
+	void BroadcastGroup::remove(StreamMultiplexer& member)
+	{
+		members.erase(std::remove(members.begin(), members.end(), &member), members.end());
+		transfers.erase(std::remove_if(transfers.begin(), transfers.end(),
+			[&member](const Transfer& transfer) { return transfer.member == &member; }), transfers.end());
+	}
+
+	void BroadcastGroup::send(const Payload& payload)
+	{
+		for (StreamMultiplexer* const member : members)
+		{
+			send(payload, *member);
+		}
+	}
+
+	void BroadcastGroup::send(const Payload& payload, StreamMultiplexer& member)
+	{
+		se_assert(payload);
+		Transfer transfer;
+		transfer.member = &member;
+		transfer.stream = member.openStream(payload->getSize());
+		transfer.payload = payload;
+		transfers.push_back(transfer);
+	}
+
+	bool BroadcastGroup::update()
+	{
+		bool written = false;
+		for (Transfer& transfer : transfers)
+		{
+			const uint64_t offset = transfer.stream->getBytesWritten();
+			if (transfer.stream->isWritable() && offset < transfer.payload->getSize())
+			{
+				written = transfer.stream->write((const uint8_t*)transfer.payload->getData() + offset, size_t(transfer.payload->getSize() - offset)) > 0 || written;
+			}
+			if (transfer.stream->getBytesWritten() == transfer.payload->getSize())
+			{
+				transfer.stream->close();
+			}
+		}
+		transfers.erase(std::remove_if(transfers.begin(), transfers.end(),
+			[](const Transfer& transfer) { return transfer.stream->isClosed() || transfer.stream->isCanceled(); }), transfers.end());
+		return written;
+	}
+
+	void BroadcastGroup::forEachTransfer(const std::function<void(const StreamMultiplexer& member, const OutgoingStream& stream)>& function) const
+	{
+		for (const Transfer& transfer : transfers)
+		{
+			function(*transfer.member, *transfer.stream);
+		}
+	}
+}
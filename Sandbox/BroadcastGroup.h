@@ -0,0 +1,62 @@
+#pragma once
+
+#include "SpehsEngine/Core/WriteBuffer.h"
+#include "Sandbox/MessageStream.h"
+#include <functional>
+#include <memory>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace se
+{
+	/*
+		Sends payloads to a group of connections, each of which is represented by its StreamMultiplexer.
+		A payload is serialized once by the caller and shared, immutable and reference counted, by every transfer of it.
+		Broadcasting a 4 MB payload to 500 connections holds one copy of it instead of 500.
+		Each member receives the payload as a stream, written as far as that receiver's window allows, so slow members don't hold back the others.
+		Known limitation: each chunk is still copied once per member, into its StreamChunk packet, and again by the engine's sendPacket(),
+		which copies and fragments every packet for its own connection. Sharing the fragments between connections would need a send entry point
+		for prebuilt fragments in the engine.
+		Not thread safe, use from the thread that routes the members' received messages.
+	*/
+	class BroadcastGroup
+	{
+	public:
+
+		typedef std::shared_ptr<const WriteBuffer> Payload;
+
+		// The multiplexer must outlive its membership
+		void add(StreamMultiplexer& member);
+		// Unfinished transfers to the member are closed early
+		void remove(StreamMultiplexer& member);
+
+		// Streams the payload to every member
+		void send(const Payload& payload);
+		// Streams the payload to a single member, which doesn't need to be in the group
+		void send(const Payload& payload, StreamMultiplexer& member);
+
+		// Writes each transfer as far as its receiver allows and drops finished ones. Returns true if anything was written.
+		bool update();
+
+		void forEachTransfer(const std::function<void(const StreamMultiplexer& member, const OutgoingStream& stream)>& function) const;
+
+		inline size_t getMemberCount() const
+		{
+			return members.size();
+		}
+
+	private:
+
+		struct Transfer
+		{
+			StreamMultiplexer* member = nullptr;
+			std::shared_ptr<OutgoingStream> stream;
+			Payload payload;
+		};
+
+		std::vector<StreamMultiplexer*> members;
+		std::vector<Transfer> transfers;
+	};
+}
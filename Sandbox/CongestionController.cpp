@@ -0,0 +1,319 @@
+#include "stdafx.h"
+#include "Sandbox/CongestionController.h"
+
+#include <algorithm>
+
+
+namespace se
+{
+	namespace
+	{
+		constexpr double startupGain = 2.885; // 2 / ln(2), doubles the delivery rate every round trip
+		constexpr double bandwidthWindowGain = 2.0;
+		constexpr double fullBandwidthGrowth = 1.25;
+		constexpr unsigned fullBandwidthRoundCount = 3;
+		constexpr size_t minWindowPackets = 4;
+		// Probe for more bandwidth for one round trip, drain the queue that built up for one round trip, then cruise for six
+		constexpr double pacingGainCycle[] = { 1.25, 0.75, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0 };
+		constexpr size_t pacingGainCycleLength = sizeof(pacingGainCycle) / sizeof(pacingGainCycle[0]);
+
+		inline double toSeconds(const std::chrono::steady_clock::duration duration)
+		{
+			return std::chrono::duration<double>(duration).count();
+		}
+	}
+
+	TokenBucketPacer::TokenBucketPacer(const uint64_t _bytesPerSecond, const Clock::duration _maxBurst, const size_t _maxBurstBytes)
+		: bytesPerSecond(_bytesPerSecond)
+		, maxBurst(_maxBurst)
+		, maxBurstBytes(_maxBurstBytes)
+	{
+	}
+
+	void TokenBucketPacer::setRate(const uint64_t _bytesPerSecond)
+	{
+		bytesPerSecond = _bytesPerSecond;
+	}
+
+	void TokenBucketPacer::setMaxBurst(const Clock::duration _maxBurst)
+	{
+		maxBurst = _maxBurst;
+	}
+
+	void TokenBucketPacer::setMaxBurstBytes(const size_t _maxBurstBytes)
+	{
+		maxBurstBytes = _maxBurstBytes;
+	}
+
+	void TokenBucketPacer::refill(const Clock::time_point now)
+	{
+		const double maxTokens = maxBurstBytes > 0
+			? std::min(toSeconds(maxBurst) * double(bytesPerSecond), double(maxBurstBytes))
+			: toSeconds(maxBurst) * double(bytesPerSecond);
+		if (!refilled)
+		{
+			refilled = true;
+			tokens = maxTokens;
+		}
+		else if (now > lastRefill)
+		{
+			tokens = std::min(tokens + toSeconds(now - lastRefill) * double(bytesPerSecond), maxTokens);
+		}
+		lastRefill = std::max(lastRefill, now);
+	}
+
+	bool TokenBucketPacer::canSend(const Clock::time_point now)
+	{
+		refill(now);
+		return tokens > 0.0;
+	}
+
+	void TokenBucketPacer::consume(const size_t bytes)
+	{
+		tokens -= double(bytes);
+	}
+
+	TokenBucketPacer::Clock::duration TokenBucketPacer::getSendDelay(const Clock::time_point now)
+	{
+		refill(now);
+		if (tokens > 0.0)
+		{
+			return Clock::duration::zero();
+		}
+		if (bytesPerSecond == 0)
+		{
+			return Clock::duration::max();
+		}
+		// Rounded up so that the bucket is not empty after the delay
+		return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(-tokens / double(bytesPerSecond))) + Clock::duration(1);
+	}
+
+	CongestionController::CongestionController()
+		: CongestionController(Settings())
+	{
+	}
+
+	CongestionController::CongestionController(const Settings& _settings)
+		: settings(_settings)
+		, pacer(_settings.initialRate, _settings.maxBurst, _settings.maxBurstPackets * _settings.maxPacketSize)
+		, pacingGain(startupGain)
+		, windowGain(startupGain)
+		, congestionWindow(_settings.initialWindow)
+	{
+		se_assert(settings.initialRate > 0);
+		se_assert(settings.minRate > 0);
+		se_assert(settings.maxRate == 0 || settings.maxRate >= settings.minRate);
+		se_assert(settings.maxPacketSize > 0);
+	}
+
+	void CongestionController::onPacketSent(const size_t bytes, const Clock::time_point now)
+	{
+		if (sentBytes == deliveredBytes)
+		{
+			// Restarting from idle, the time spent idle must not count as delivery time
+			deliveredTime = now;
+		}
+		SentPacket sentPacket;
+		sentBytes += bytes;
+		sentPacket.endOffset = sentBytes;
+		sentPacket.sendTime = now;
+		sentPacket.deliveredAtSend = deliveredBytes;
+		sentPacket.deliveredTimeAtSend = deliveredTime;
+		sentPackets.push_back(sentPacket);
+		pacer.consume(bytes);
+	}
+
+	void CongestionController::onDelivered(const uint64_t _deliveredBytes, const Clock::time_point now)
+	{
+		if (_deliveredBytes <= deliveredBytes)
+		{
+			return;
+		}
+		if (_deliveredBytes > sentBytes)
+		{
+			// The receiver is counting bytes of something else, for example a previous connection
+			log::warning("CongestionController: " + std::to_string(_deliveredBytes) + " bytes reported delivered, but only " + std::to_string(sentBytes) + " have been sent.");
+			return;
+		}
+		deliveredBytes = _deliveredBytes;
+		deliveredTime = now;
+
+		// The newest packet that the delivered byte count covers
+		bool sampled = false;
+		SentPacket packet;
+		while (!sentPackets.empty() && sentPackets.front().endOffset <= deliveredBytes)
+		{
+			packet = sentPackets.front();
+			sentPackets.pop_front();
+			sampled = true;
+		}
+		if (!sampled)
+		{
+			return;
+		}
+
+		// Round trip time
+		const Clock::duration rtt = now - packet.sendTime;
+		const bool minRttExpired = minRtt != Clock::duration::zero() && now - minRttTime > settings.minRttExpiry;
+		if (minRtt == Clock::duration::zero() || rtt <= minRtt || minRttExpired)
+		{
+			minRtt = std::max(rtt, Clock::duration(1));
+			minRttTime = now;
+		}
+
+		// Round counting, a round ends when a packet sent after the previous round ended is delivered
+		roundStart = packet.deliveredAtSend >= nextRoundDelivered;
+		if (roundStart)
+		{
+			nextRoundDelivered = deliveredBytes;
+			roundCount++;
+			// Cleared even if this delivery yields no rate sample, otherwise the maximum of a round ten rounds ago would be kept
+			roundMaxRates[roundCount % std::size(roundMaxRates)] = 0;
+			bottleneckBandwidth = *std::max_element(std::begin(roundMaxRates), std::end(roundMaxRates));
+		}
+
+		// Delivery rate. An interval shorter than the round trip time means that the deliveries were reported in a burst and would overestimate the rate.
+		const Clock::duration interval = now - packet.deliveredTimeAtSend;
+		if (interval > Clock::duration::zero() && interval >= minRtt)
+		{
+			updateBottleneckBandwidth(uint64_t(double(deliveredBytes - packet.deliveredAtSend) / toSeconds(interval)));
+		}
+
+		if (minRttExpired && state != State::ProbeRtt)
+		{
+			state = State::ProbeRtt;
+			pacingGain = 1.0;
+			windowGain = 1.0;
+			probeRttEnd = Clock::time_point();
+		}
+		updateState(now);
+		updateRateAndWindow();
+	}
+
+	void CongestionController::updateBottleneckBandwidth(const uint64_t rate)
+	{
+		uint64_t& roundMaxRate = roundMaxRates[roundCount % std::size(roundMaxRates)];
+		roundMaxRate = std::max(roundMaxRate, rate);
+		bottleneckBandwidth = *std::max_element(std::begin(roundMaxRates), std::end(roundMaxRates));
+	}
+
+	void CongestionController::updateState(const Clock::time_point now)
+	{
+		const uint64_t bandwidthDelayProduct = uint64_t(double(bottleneckBandwidth) * toSeconds(minRtt));
+		const auto enterProbeBandwidth = [&]()
+		{
+			state = State::ProbeBandwidth;
+			cycleIndex = 0;
+			cycleStart = now;
+			pacingGain = pacingGainCycle[cycleIndex];
+			windowGain = bandwidthWindowGain;
+		};
+
+		switch (state)
+		{
+		case State::Startup:
+			// The pipe is full when the bandwidth has stopped growing for a few rounds
+			if (roundStart && bottleneckBandwidth > 0)
+			{
+				if (double(bottleneckBandwidth) >= double(fullBandwidth) * fullBandwidthGrowth)
+				{
+					fullBandwidth = bottleneckBandwidth;
+					fullBandwidthRounds = 0;
+				}
+				else if (++fullBandwidthRounds >= fullBandwidthRoundCount)
+				{
+					state = State::Drain;
+					pacingGain = 1.0 / startupGain;
+					windowGain = startupGain;
+				}
+			}
+			break;
+		case State::Drain:
+			if (getBytesInFlight() <= bandwidthDelayProduct)
+			{
+				enterProbeBandwidth();
+			}
+			break;
+		case State::ProbeBandwidth:
+		{
+			const bool cycleElapsed = now - cycleStart >= minRtt;
+			const bool drained = pacingGain < 1.0 && getBytesInFlight() <= bandwidthDelayProduct;
+			if (cycleElapsed || drained)
+			{
+				cycleIndex = (cycleIndex + 1) % pacingGainCycleLength;
+				cycleStart = now;
+				pacingGain = pacingGainCycle[cycleIndex];
+			}
+			break;
+		}
+		case State::ProbeRtt:
+			// Hold the minimum window for a while after the queue has drained, the round trip time measured then is the propagation delay
+			if (probeRttEnd == Clock::time_point())
+			{
+				if (getBytesInFlight() <= minWindowPackets * settings.maxPacketSize)
+				{
+					probeRttEnd = now + settings.probeRttDuration;
+				}
+			}
+			else if (now >= probeRttEnd)
+			{
+				minRttTime = now;
+				if (fullBandwidthRounds >= fullBandwidthRoundCount)
+				{
+					enterProbeBandwidth();
+				}
+				else
+				{
+					state = State::Startup;
+					pacingGain = startupGain;
+					windowGain = startupGain;
+				}
+			}
+			break;
+		}
+	}
+
+	void CongestionController::updateRateAndWindow()
+	{
+		if (bottleneckBandwidth > 0)
+		{
+			uint64_t rate = uint64_t(pacingGain * double(bottleneckBandwidth));
+			if (state == State::Startup)
+			{
+				// Startup samples lag behind the rate, never slow down before the pipe is full
+				rate = std::max(rate, pacer.getRate());
+			}
+			rate = std::max(rate, settings.minRate);
+			if (settings.maxRate > 0)
+			{
+				rate = std::min(rate, settings.maxRate);
+			}
+			pacer.setRate(rate);
+		}
+
+		const uint64_t minWindow = minWindowPackets * settings.maxPacketSize;
+		if (state == State::ProbeRtt)
+		{
+			congestionWindow = minWindow;
+		}
+		else if (bottleneckBandwidth > 0)
+		{
+			const double bandwidthDelayProduct = double(bottleneckBandwidth) * toSeconds(minRtt);
+			congestionWindow = std::max(uint64_t(windowGain * bandwidthDelayProduct), minWindow);
+		}
+		else
+		{
+			congestionWindow = std::max(uint64_t(settings.initialWindow), minWindow);
+		}
+	}
+
+	bool CongestionController::canSend(const Clock::time_point now)
+	{
+		return getBytesInFlight() < congestionWindow && pacer.canSend(now);
+	}
+
+	CongestionController::Clock::duration CongestionController::getSendDelay(const Clock::time_point now)
+	{
+		return pacer.getSendDelay(now);
+	}
+}
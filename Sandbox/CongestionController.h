@@ -0,0 +1,175 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace se
+{
+	/*
+		Token bucket that spreads sends evenly at a given rate.
+		A packet may be sent whenever the bucket is not empty, so packets larger than the burst size still go through and leave the bucket in debt.
+		The burst size is maxBurst at the current rate, capped at maxBurstBytes unless it is 0.
+		Sends should be driven by a timer that waits for getSendDelay(), the bucket only smooths out timer jitter.
+	*/
+	class TokenBucketPacer
+	{
+	public:
+
+		typedef std::chrono::steady_clock Clock;
+
+		TokenBucketPacer(const uint64_t bytesPerSecond, const Clock::duration maxBurst, const size_t maxBurstBytes = 0);
+
+		void setRate(const uint64_t bytesPerSecond);
+		void setMaxBurst(const Clock::duration maxBurst);
+		void setMaxBurstBytes(const size_t maxBurstBytes);
+
+		bool canSend(const Clock::time_point now);
+		void consume(const size_t bytes);
+
+		// Time until canSend() returns true, zero if it already does
+		Clock::duration getSendDelay(const Clock::time_point now);
+
+		inline uint64_t getRate() const
+		{
+			return bytesPerSecond;
+		}
+
+	private:
+
+		void refill(const Clock::time_point now);
+
+		uint64_t bytesPerSecond = 0;
+		Clock::duration maxBurst;
+		size_t maxBurstBytes = 0;
+		double tokens = 0.0;
+		Clock::time_point lastRefill;
+		bool refilled = false;
+	};
+
+	/*
+		BBR style congestion control for application level bulk transfer over a reliable, ordered connection.
+		The sender reports every packet with onPacketSent(), the receiver periodically reports the total number of bytes it has received
+		and the sender passes that to onDelivered(). Because delivery is in order, the delivered byte count identifies the newest delivered packet,
+		which gives both a round trip time and a delivery rate sample without any headers in the data packets.
+		The bottleneck bandwidth is the maximum delivery rate over the last ten round trips and the minimum round trip time is kept for ten seconds.
+		Sending is paced at a gain times the bottleneck bandwidth and the bytes in flight are capped at twice the bandwidth delay product.
+		Random loss that the connection recovers from does not reduce the rate, so lossy links are not left underused.
+	*/
+	class CongestionController
+	{
+	public:
+
+		typedef std::chrono::steady_clock Clock;
+
+		struct Settings
+		{
+			uint64_t initialRate = 256 * 1024;			// Bytes per second until the first bandwidth sample
+			uint64_t minRate = 16 * 1024;
+			uint64_t maxRate = 0;						// 0 for unlimited
+			size_t initialWindow = 64 * 1024;			// Bytes in flight until the first round trip time sample
+			size_t maxPacketSize = 16 * 1024;			// The minimum window is four packets
+			Clock::duration maxBurst = std::chrono::milliseconds(5);
+			size_t maxBurstPackets = 4;				// Caps the burst at high rates, where maxBurst would allow many packets back to back
+			Clock::duration minRttExpiry = std::chrono::seconds(10);
+			Clock::duration probeRttDuration = std::chrono::milliseconds(200);
+		};
+
+		enum class State
+		{
+			Startup,
+			Drain,
+			ProbeBandwidth,
+			ProbeRtt,
+		};
+
+		CongestionController();
+		CongestionController(const Settings& settings);
+
+		void onPacketSent(const size_t bytes, const Clock::time_point now);
+
+		// deliveredBytes is the receiver's running total. Reports may arrive out of order, stale ones are ignored, as are totals larger than what has been sent.
+		// The sender stops once the window is full, so the receiver must keep repeating its total for as long as it can be lost, not only when new data arrives.
+		void onDelivered(const uint64_t deliveredBytes, const Clock::time_point now);
+
+		// Both the pacer and the congestion window allow a new packet
+		bool canSend(const Clock::time_point now);
+
+		// Time until the pacer allows a new packet. The window only opens on delivery, so this does not account for it.
+		// Schedule the next send with this instead of sending from a fixed interval, which would send each interval's packets back to back.
+		Clock::duration getSendDelay(const Clock::time_point now);
+
+		inline uint64_t getPacingRate() const
+		{
+			return pacer.getRate();
+		}
+
+		// 0 until the first sample
+		inline uint64_t getBottleneckBandwidth() const
+		{
+			return bottleneckBandwidth;
+		}
+
+		// Zero until the first sample
+		inline Clock::duration getMinRtt() const
+		{
+			return minRtt;
+		}
+
+		inline uint64_t getBytesInFlight() const
+		{
+			return sentBytes - deliveredBytes;
+		}
+
+		inline uint64_t getCongestionWindow() const
+		{
+			return congestionWindow;
+		}
+
+		inline State getState() const
+		{
+			return state;
+		}
+
+	private:
+
+		struct SentPacket
+		{
+			uint64_t endOffset = 0;				// sentBytes after this packet
+			Clock::time_point sendTime;
+			uint64_t deliveredAtSend = 0;
+			Clock::time_point deliveredTimeAtSend;
+		};
+
+		void updateBottleneckBandwidth(const uint64_t rate);
+		void updateState(const Clock::time_point now);
+		void updateRateAndWindow();
+
+		const Settings settings;
+		TokenBucketPacer pacer;
+		State state = State::Startup;
+		std::deque<SentPacket> sentPackets;
+		uint64_t sentBytes = 0;
+		uint64_t deliveredBytes = 0;
+		Clock::time_point deliveredTime;
+
+		uint64_t roundCount = 0;
+		uint64_t nextRoundDelivered = 0;
+		bool roundStart = false;
+		uint64_t roundMaxRates[10] = {};		// Maximum delivery rate of each of the last ten rounds
+		uint64_t bottleneckBandwidth = 0;
+		uint64_t fullBandwidth = 0;
+		unsigned fullBandwidthRounds = 0;
+
+		Clock::duration minRtt = Clock::duration::zero();
+		Clock::time_point minRttTime;
+		Clock::time_point probeRttEnd;
+		size_t cycleIndex = 0;
+		Clock::time_point cycleStart;
+		double pacingGain;
+		double windowGain;
+		uint64_t congestionWindow;
+	};
+}
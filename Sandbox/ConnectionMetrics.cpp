@@ -0,0 +1,308 @@
+#include "stdafx.h"
+#include "Sandbox/ConnectionMetrics.h"
+
+#include "SpehsEngine/Core/StringUtilityFunctions.h"
+#include "SpehsEngine/Net/Connection.h"
+#include "Sandbox/AggregateReflection.h"
+#include "Sandbox/JsonUtilityFunctions.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+
+namespace se
+{
+	namespace
+	{
+		inline int64_t getSteadyNanoseconds()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		inline int64_t getWallNanoseconds()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		}
+
+		// Prometheus label values only support escaping \, " and newlines
+		std::string escapePrometheusLabel(const std::string& string)
+		{
+			std::string escaped;
+			escaped.reserve(string.size());
+			for (const char c : string)
+			{
+				switch (c)
+				{
+				case '\\': escaped += "\\\\"; break;
+				case '"': escaped += "\\\""; break;
+				case '\n': escaped += "\\n"; break;
+				default: escaped += c; break;
+				}
+			}
+			return escaped;
+		}
+
+		const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+		void writePrometheusCounter(std::string& output, const char* const name, const char* const help,
+			const std::vector<std::shared_ptr<const ConnectionMetrics::Snapshot>>& snapshots, uint64_t ConnectionMetrics::Counters::* const counter)
+		{
+			output += formatString("# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+			for (const std::shared_ptr<const ConnectionMetrics::Snapshot>& snapshot : snapshots)
+			{
+				output += formatString("%s{connection=\"%s\"} %llu\n", name, escapePrometheusLabel(snapshot->name).c_str(), (unsigned long long)(snapshot->counters.*counter));
+			}
+		}
+
+		// Connections that don't expose the value are left out
+		void writePrometheusOptional(std::string& output, const char* const name, const char* const help, const char* const type, const double scale,
+			const std::vector<std::shared_ptr<const ConnectionMetrics::Snapshot>>& snapshots, int64_t ConnectionMetrics::Counters::* const counter)
+		{
+			output += formatString("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+			for (const std::shared_ptr<const ConnectionMetrics::Snapshot>& snapshot : snapshots)
+			{
+				if (snapshot->counters.*counter >= 0)
+				{
+					output += formatString("%s{connection=\"%s\"} %.9g\n", name, escapePrometheusLabel(snapshot->name).c_str(), double(snapshot->counters.*counter) * scale);
+				}
+			}
+		}
+
+		std::string formatJsonOptional(const int64_t value)
+		{
+			return value >= 0 ? std::to_string(value) : std::string("null");
+		}
+
+		void writePrometheusSummary(std::string& output, const char* const name, const char* const help,
+			const std::vector<std::shared_ptr<const ConnectionMetrics::Snapshot>>& snapshots, HdrHistogram ConnectionMetrics::Snapshot::* const histogram)
+		{
+			output += formatString("# HELP %s %s\n# TYPE %s summary\n", name, help, name);
+			for (const std::shared_ptr<const ConnectionMetrics::Snapshot>& snapshot : snapshots)
+			{
+				const HdrHistogram& values = (*snapshot).*histogram;
+				const std::string connection = escapePrometheusLabel(snapshot->name);
+				for (const double quantile : quantiles)
+				{
+					output += formatString("%s{connection=\"%s\",quantile=\"%g\"} %.9f\n", name, connection.c_str(), quantile, double(values.getValueAtPercentile(quantile * 100.0)) * 1e-9);
+				}
+				output += formatString("%s_sum{connection=\"%s\"} %.9f\n", name, connection.c_str(), double(values.getSum()) * 1e-9);
+				output += formatString("%s_count{connection=\"%s\"} %llu\n", name, connection.c_str(), (unsigned long long)values.getCount());
+			}
+		}
+
+		void writeJsonHistogram(std::string& output, const char* const name, const HdrHistogram& histogram)
+		{
+			output += formatString("\"%s\":{\"count\":%llu,\"mean\":%.1f,\"min\":%llu,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}",
+				name, (unsigned long long)histogram.getCount(), histogram.getMean(), (unsigned long long)histogram.getMin(),
+				(unsigned long long)histogram.getValueAtPercentile(50.0), (unsigned long long)histogram.getValueAtPercentile(90.0),
+				(unsigned long long)histogram.getValueAtPercentile(99.0), (unsigned long long)histogram.getValueAtPercentile(99.9),
+				(unsigned long long)histogram.getMax());
+		}
+	}
+
+	ConnectionMetrics::ConnectionMetrics(const std::string& _name)
+		: name(_name)
+	{
+	}
+
+	void ConnectionMetrics::sampleConnection(const net::Connection& connection)
+	{
+		// Keyed by how many times a fragment was sent, a fragment sent n times was resent n - 1 times
+		uint64_t retransmits = 0;
+		for (const auto& [sendCount, fragmentCount] : connection.getReliableFragmentSendCounters())
+		{
+			if (sendCount > 1)
+			{
+				retransmits += uint64_t(sendCount - 1) * uint64_t(fragmentCount);
+			}
+		}
+		counters.retransmits = int64_t(retransmits);
+		counters.sendQueueFragments = int64_t(connection.getReliableFragmentSendQueueSize());
+
+		// One wait time per mutex of the connection
+		double mutexWaitSeconds = 0.0;
+		AggregateReflection::forEachField(connection.getMutexTimes(), [&mutexWaitSeconds](const auto& time)
+			{
+				mutexWaitSeconds += double(time.asSeconds());
+			});
+		counters.mutexWaitNanoseconds = int64_t(mutexWaitSeconds * 1e9);
+	}
+
+	void ConnectionMetrics::recordRoundTripTime(const uint64_t nanoseconds)
+	{
+		roundTripTime.record(nanoseconds);
+	}
+
+	void ConnectionMetrics::recordOneWayDelay(const uint64_t nanoseconds)
+	{
+		oneWayDelay.record(nanoseconds);
+	}
+
+	void ConnectionMetrics::writePing(WriteBuffer& writeBuffer)
+	{
+		MetricsPing ping;
+		ping.sequence = nextPingSequence++;
+		ping.sendTime = getSteadyNanoseconds();
+		ping.sendWallTime = getWallNanoseconds();
+		TypelessMessageRouter::write(writeBuffer, ping);
+		counters.pingsSent++;
+	}
+
+	void ConnectionMetrics::setProbeHandlers(TypelessMessageRouter& router, const std::function<void(const WriteBuffer&)>& sendUnreliable)
+	{
+		se_assert(sendUnreliable);
+		router.setHandler<MetricsPing>([this, sendUnreliable](MetricsPing& ping, const bool)
+			{
+				// Clock differences between the hosts can make the delay negative
+				const int64_t delay = getWallNanoseconds() - ping.sendWallTime;
+				if (delay >= 0)
+				{
+					recordOneWayDelay(uint64_t(delay));
+				}
+				MetricsPong pong;
+				pong.sequence = ping.sequence;
+				pong.pingSendTime = ping.sendTime;
+				WriteBuffer writeBuffer;
+				TypelessMessageRouter::write(writeBuffer, pong);
+				sendUnreliable(writeBuffer);
+				recordSent(writeBuffer.getSize(), false);
+			});
+		router.setHandler<MetricsPong>([this](MetricsPong& pong, const bool)
+			{
+				counters.pongsReceived++;
+				const int64_t rtt = getSteadyNanoseconds() - pong.pingSendTime;
+				if (rtt >= 0)
+				{
+					recordRoundTripTime(uint64_t(rtt));
+				}
+			});
+	}
+
+	void ConnectionMetrics::publish()
+	{
+		// A new snapshot every time, readers may still hold the previous one
+		const std::shared_ptr<Snapshot> next = std::make_shared<Snapshot>();
+		next->name = name;
+		next->wallTime = getWallNanoseconds();
+		next->counters = counters;
+		next->roundTripTime = roundTripTime;
+		next->oneWayDelay = oneWayDelay;
+		std::atomic_store(&snapshot, std::shared_ptr<const Snapshot>(next));
+	}
+
+	std::shared_ptr<const ConnectionMetrics::Snapshot> ConnectionMetrics::getSnapshot() const
+	{
+		return std::atomic_load(&snapshot);
+	}
+
+	void writePrometheus(std::string& output, const std::vector<std::shared_ptr<const ConnectionMetrics::Snapshot>>& snapshots)
+	{
+		writePrometheusCounter(output, "se_connection_sent_bytes_total", "Bytes sent.", snapshots, &ConnectionMetrics::Counters::bytesSent);
+		writePrometheusCounter(output, "se_connection_received_bytes_total", "Bytes received.", snapshots, &ConnectionMetrics::Counters::bytesReceived);
+		writePrometheusCounter(output, "se_connection_sent_packets_total", "Packets sent.", snapshots, &ConnectionMetrics::Counters::packetsSent);
+		writePrometheusCounter(output, "se_connection_received_packets_total", "Packets received.", snapshots, &ConnectionMetrics::Counters::packetsReceived);
+		writePrometheusCounter(output, "se_connection_sent_reliable_packets_total", "Reliable packets sent.", snapshots, &ConnectionMetrics::Counters::reliablePacketsSent);
+		writePrometheusCounter(output, "se_connection_received_reliable_packets_total", "Reliable packets received.", snapshots, &ConnectionMetrics::Counters::reliablePacketsReceived);
+		writePrometheusCounter(output, "se_connection_sent_pings_total", "Round trip time probes sent.", snapshots, &ConnectionMetrics::Counters::pingsSent);
+		writePrometheusCounter(output, "se_connection_received_pongs_total", "Round trip time probes answered.", snapshots, &ConnectionMetrics::Counters::pongsReceived);
+		writePrometheusOptional(output, "se_connection_retransmits_total", "Reliable fragment resends.", "counter", 1.0, snapshots, &ConnectionMetrics::Counters::retransmits);
+		writePrometheusOptional(output, "se_connection_send_queue_fragments", "Reliable fragments waiting to be sent or acknowledged.", "gauge", 1.0, snapshots, &ConnectionMetrics::Counters::sendQueueFragments);
+		writePrometheusOptional(output, "se_connection_mutex_wait_seconds_total", "Time spent acquiring the connection's mutexes.", "counter", 1e-9, snapshots, &ConnectionMetrics::Counters::mutexWaitNanoseconds);
+		writePrometheusSummary(output, "se_connection_round_trip_seconds", "Round trip time.", snapshots, &ConnectionMetrics::Snapshot::roundTripTime);
+		writePrometheusSummary(output, "se_connection_one_way_delay_seconds", "Incoming one way delay, requires synchronized clocks.", snapshots, &ConnectionMetrics::Snapshot::oneWayDelay);
+	}
+
+	void writeJsonLine(std::string& output, const ConnectionMetrics::Snapshot& snapshot)
+	{
+		const ConnectionMetrics::Counters& counters = snapshot.counters;
+		output += formatString("{\"connection\":\"%s\",\"time\":%lld,\"bytesSent\":%llu,\"bytesReceived\":%llu,\"packetsSent\":%llu,\"packetsReceived\":%llu,"
+			"\"reliablePacketsSent\":%llu,\"reliablePacketsReceived\":%llu,\"pingsSent\":%llu,\"pongsReceived\":%llu,"
+			"\"retransmits\":%s,\"sendQueueFragments\":%s,\"mutexWaitNanoseconds\":%s,",
+			escapeJson(snapshot.name).c_str(), (long long)snapshot.wallTime, (unsigned long long)counters.bytesSent, (unsigned long long)counters.bytesReceived,
+			(unsigned long long)counters.packetsSent, (unsigned long long)counters.packetsReceived, (unsigned long long)counters.reliablePacketsSent,
+			(unsigned long long)counters.reliablePacketsReceived, (unsigned long long)counters.pingsSent, (unsigned long long)counters.pongsReceived,
+			formatJsonOptional(counters.retransmits).c_str(), formatJsonOptional(counters.sendQueueFragments).c_str(), formatJsonOptional(counters.mutexWaitNanoseconds).c_str());
+		writeJsonHistogram(output, "roundTripTime", snapshot.roundTripTime);
+		output += ",";
+		writeJsonHistogram(output, "oneWayDelay", snapshot.oneWayDelay);
+		output += "}";
+	}
+
+	void ConnectionMetricsRegistry::add(const std::shared_ptr<ConnectionMetrics>& _connectionMetrics)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		connectionMetrics.push_back(_connectionMetrics);
+	}
+
+	void ConnectionMetricsRegistry::remove(const ConnectionMetrics* const _connectionMetrics)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		connectionMetrics.erase(std::remove_if(connectionMetrics.begin(), connectionMetrics.end(),
+			[_connectionMetrics](const std::weak_ptr<ConnectionMetrics>& element) { return element.expired() || element.lock().get() == _connectionMetrics; }), connectionMetrics.end());
+	}
+
+	std::vector<std::shared_ptr<const ConnectionMetrics::Snapshot>> ConnectionMetricsRegistry::collect()
+	{
+		std::vector<std::shared_ptr<const ConnectionMetrics::Snapshot>> snapshots;
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < connectionMetrics.size(); i++)
+		{
+			const std::shared_ptr<ConnectionMetrics> element = connectionMetrics[i].lock();
+			if (!element)
+			{
+				connectionMetrics[i] = std::move(connectionMetrics.back());
+				connectionMetrics.pop_back();
+				i--;
+				continue;
+			}
+			if (std::shared_ptr<const ConnectionMetrics::Snapshot> snapshot = element->getSnapshot())
+			{
+				snapshots.push_back(std::move(snapshot));
+			}
+		}
+		return snapshots;
+	}
+
+	bool ConnectionMetricsRegistry::writePrometheusFile(const std::string& path)
+	{
+		std::string output;
+		writePrometheus(output, collect());
+		const std::string temporaryPath = path + ".tmp";
+		{
+			std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+			if (!file.write(output.data(), std::streamsize(output.size())))
+			{
+				log::warning("Failed to write connection metrics: " + temporaryPath);
+				return false;
+			}
+		}
+		// Scrapers must never see a partially written file
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, path, error);
+		if (error)
+		{
+			log::warning("Failed to replace connection metrics file: " + path);
+			return false;
+		}
+		return true;
+	}
+
+	bool ConnectionMetricsRegistry::appendJsonLinesFile(const std::string& path)
+	{
+		std::string output;
+		for (const std::shared_ptr<const ConnectionMetrics::Snapshot>& snapshot : collect())
+		{
+			writeJsonLine(output, *snapshot);
+			output += "\n";
+		}
+		std::ofstream file(path, std::ios::binary | std::ios::app);
+		if (!file.write(output.data(), std::streamsize(output.size())))
+		{
+			log::warning("Failed to write connection metrics: " + path);
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "SpehsEngine/Core/WriteBuffer.h"
+#include "Sandbox/HdrHistogram.h"
+#include "Sandbox/TypelessMessageRouter.h"
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace se
+{
+	namespace net
+	{
+		class Connection;
+		class Connection2;
+	}
+
+	// Probe messages exchanged between two ConnectionMetrics
+	struct MetricsPing
+	{
+		uint64_t sequence = 0;
+		int64_t sendTime = 0;		// Sender steady clock, echoed back in the pong
+		int64_t sendWallTime = 0;	// Sender system clock, for one way delay
+	};
+
+	struct MetricsPong
+	{
+		uint64_t sequence = 0;
+		int64_t pingSendTime = 0;
+	};
+}
+
+SE_TYPELESS_TYPE_NAME(se::MetricsPing, "se::MetricsPing")
+SE_TYPELESS_TYPE_NAME(se::MetricsPong, "se::MetricsPong")
+
+namespace se
+{
+	/*
+		Per connection traffic counters and latency histograms, collected at the application level around sendPacket() and the receive handler.
+		Counters that only the connection itself knows, like retransmits, are copied from it with sampleConnection().
+		Round trip time is measured with ping/pong probe messages. One way delay is measured from the system clock timestamp in pings,
+		so it is only meaningful when both hosts have synchronized clocks.
+		The owning thread records and periodically publishes an immutable snapshot, which is swapped in atomically.
+		Other threads read the latest snapshot without blocking the owner and can hold on to it for as long as they need.
+	*/
+	class ConnectionMetrics
+	{
+	public:
+
+		struct Counters
+		{
+			uint64_t bytesSent = 0;
+			uint64_t bytesReceived = 0;
+			uint64_t packetsSent = 0;
+			uint64_t packetsReceived = 0;
+			uint64_t reliablePacketsSent = 0;
+			uint64_t reliablePacketsReceived = 0;
+			uint64_t pingsSent = 0;
+			uint64_t pongsReceived = 0;
+			// Read from the connection by sampleConnection(), -1 if the connection does not expose them
+			int64_t retransmits = -1;				// Reliable fragment resends
+			int64_t sendQueueFragments = -1;		// Reliable fragments waiting to be sent or acknowledged
+			int64_t mutexWaitNanoseconds = -1;		// Time spent acquiring the connection's mutexes
+		};
+
+		struct Snapshot
+		{
+			std::string name;
+			int64_t wallTime = 0;			// Publish time, nanoseconds since the unix epoch
+			Counters counters;
+			HdrHistogram roundTripTime;		// Nanoseconds
+			HdrHistogram oneWayDelay;		// Nanoseconds
+		};
+
+		ConnectionMetrics(const std::string& name);
+
+		ConnectionMetrics(const ConnectionMetrics& copy) = delete;
+		void operator=(const ConnectionMetrics& copy) = delete;
+
+		inline void recordSent(const size_t bytes, const bool reliable)
+		{
+			counters.bytesSent += bytes;
+			counters.packetsSent++;
+			counters.reliablePacketsSent += reliable ? 1 : 0;
+		}
+
+		inline void recordReceived(const size_t bytes, const bool reliable)
+		{
+			counters.bytesReceived += bytes;
+			counters.packetsReceived++;
+			counters.reliablePacketsReceived += reliable ? 1 : 0;
+		}
+
+		/*
+			Copies the legacy connection's own counters, the same ones ConnectionManagerVisualizer shows.
+			They are cumulative until Connection::resetReliableFragmentSendCounters() or Connection::resetMutexTimes() is called.
+		*/
+		void sampleConnection(const net::Connection& connection);
+		// Connection2 exposes none of the connection counters, they stay -1
+		inline void sampleConnection(const net::Connection2&)
+		{
+		}
+
+		void recordRoundTripTime(const uint64_t nanoseconds);
+		void recordOneWayDelay(const uint64_t nanoseconds);
+
+		// Sends and records the packet
+		template<typename Connection>
+		void sendPacket(Connection& connection, const WriteBuffer& writeBuffer, const bool reliable)
+		{
+			connection.sendPacket(writeBuffer, reliable);
+			recordSent(writeBuffer.getSize(), reliable);
+		}
+
+		// Appends a ping message. The round trip time is recorded when the remote end answers with a pong.
+		void writePing(WriteBuffer& writeBuffer);
+
+		// Answers pings and records pongs. The send function is used for the pongs. The router must not outlive the metrics.
+		void setProbeHandlers(TypelessMessageRouter& router, const std::function<void(const WriteBuffer&)>& sendUnreliable);
+
+		template<typename Connection>
+		void setProbeHandlers(TypelessMessageRouter& router, const std::shared_ptr<Connection>& connection)
+		{
+			setProbeHandlers(router, [weakConnection = std::weak_ptr<Connection>(connection)](const WriteBuffer& writeBuffer)
+				{
+					if (const std::shared_ptr<Connection> lockedConnection = weakConnection.lock())
+					{
+						lockedConnection->sendPacket(writeBuffer, false);
+					}
+				});
+		}
+
+		// Makes the current state visible to getSnapshot(). Histograms are cumulative.
+		void publish();
+
+		// Thread safe. Returns null before the first publish().
+		std::shared_ptr<const Snapshot> getSnapshot() const;
+
+		inline const std::string& getName() const
+		{
+			return name;
+		}
+
+		inline const Counters& getCounters() const
+		{
+			return counters;
+		}
+
+	private:
+
+		const std::string name;
+		Counters counters;
+		HdrHistogram roundTripTime;
+		HdrHistogram oneWayDelay;
+		uint64_t nextPingSequence = 0;
+		std::shared_ptr<const Snapshot> snapshot;	// Accessed with the atomic shared_ptr functions
+	};
+
+	// Prometheus text exposition format. Histograms are exported as summaries in seconds.
+	void writePrometheus(std::string& output, const std::vector<std::shared_ptr<const ConnectionMetrics::Snapshot>>& snapshots);
+
+	// One JSON object without a trailing newline
+	void writeJsonLine(std::string& output, const ConnectionMetrics::Snapshot& snapshot);
+
+	/*
+		Thread safe collection of connection metrics for export. Metrics are held weakly and expired entries are dropped on the next collect().
+	*/
+	class ConnectionMetricsRegistry
+	{
+	public:
+
+		void add(const std::shared_ptr<ConnectionMetrics>& connectionMetrics);
+		void remove(const ConnectionMetrics* const connectionMetrics);
+
+		// Latest published snapshot of each registered connection
+		std::vector<std::shared_ptr<const ConnectionMetrics::Snapshot>> collect();
+
+		// Replaces the file atomically, for example for the node exporter textfile collector
+		bool writePrometheusFile(const std::string& path);
+		// Appends one line per connection
+		bool appendJsonLinesFile(const std::string& path);
+
+	private:
+
+		std::mutex mutex;
+		std::vector<std::weak_ptr<ConnectionMetrics>> connectionMetrics;
+	};
+}
@@ -0,0 +1,125 @@
+#include "stdafx.h"
+#include "Sandbox/HdrHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+namespace se
+{
+	namespace
+	{
+		constexpr uint64_t subBucketCount = uint64_t(1) << HdrHistogram::subBucketBits;
+		constexpr uint64_t subBucketHalfCount = subBucketCount / 2;
+		// Every power of two above the exact range gets half a sub bucket range, since the top bit is always set
+		constexpr size_t bucketCount = size_t(subBucketCount + (HdrHistogram::maxValueBits - HdrHistogram::subBucketBits) * subBucketHalfCount);
+
+		inline unsigned getMostSignificantBit(const uint64_t value)
+		{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+			unsigned long index;
+			_BitScanReverse64(&index, value);
+			return unsigned(index);
+#elif defined(_MSC_VER)
+			// _BitScanReverse64 is not available on 32-bit targets
+			unsigned long index;
+			if (_BitScanReverse(&index, static_cast<unsigned long>(value >> 32)))
+			{
+				return unsigned(index) + 32u;
+			}
+			_BitScanReverse(&index, static_cast<unsigned long>(value));
+			return unsigned(index);
+#else
+			return 63u - unsigned(__builtin_clzll(value));
+#endif
+		}
+	}
+
+	HdrHistogram::HdrHistogram()
+		: counts(bucketCount, 0)
+	{
+	}
+
+	size_t HdrHistogram::getIndex(const uint64_t value)
+	{
+		if (value < subBucketCount)
+		{
+			return size_t(value);
+		}
+		// Shift so that the value lands in the upper half of a sub bucket range
+		const unsigned shift = getMostSignificantBit(value) - (subBucketBits - 1);
+		const size_t index = size_t(subBucketCount + (shift - 1) * subBucketHalfCount + ((value >> shift) - subBucketHalfCount));
+		return std::min(index, bucketCount - 1);
+	}
+
+	uint64_t HdrHistogram::getHighestEquivalentValue(const size_t index)
+	{
+		if (index < subBucketCount)
+		{
+			return uint64_t(index);
+		}
+		const unsigned shift = unsigned((index - subBucketCount) / subBucketHalfCount) + 1;
+		const uint64_t lowest = (((index - subBucketCount) % subBucketHalfCount) + subBucketHalfCount) << shift;
+		return lowest + (uint64_t(1) << shift) - 1;
+	}
+
+	void HdrHistogram::record(const uint64_t value, const uint64_t count)
+	{
+		counts[getIndex(value)] += count;
+		totalCount += count;
+		sum += value * count;
+		min = std::min(min, value);
+		max = std::max(max, value);
+	}
+
+	void HdrHistogram::add(const HdrHistogram& other)
+	{
+		for (size_t i = 0; i < counts.size(); i++)
+		{
+			counts[i] += other.counts[i];
+		}
+		totalCount += other.totalCount;
+		sum += other.sum;
+		min = std::min(min, other.min);
+		max = std::max(max, other.max);
+	}
+
+	void HdrHistogram::reset()
+	{
+		std::fill(counts.begin(), counts.end(), 0);
+		totalCount = 0;
+		sum = 0;
+		min = ~uint64_t(0);
+		max = 0;
+	}
+
+	uint64_t HdrHistogram::getValueAtPercentile(const double percentile) const
+	{
+		if (totalCount == 0)
+		{
+			return 0;
+		}
+		const double clampedPercentile = std::min(std::max(percentile, 0.0), 100.0);
+		const uint64_t targetCount = std::max(uint64_t(1), uint64_t(std::ceil(clampedPercentile / 100.0 * double(totalCount))));
+		uint64_t count = 0;
+		for (size_t i = 0; i < counts.size(); i++)
+		{
+			count += counts[i];
+			if (count >= targetCount)
+			{
+				// The bucket may extend past the largest value that was actually recorded
+				return std::min(getHighestEquivalentValue(i), max);
+			}
+		}
+		return max;
+	}
+
+	double HdrHistogram::getMean() const
+	{
+		return totalCount ? double(sum) / double(totalCount) : 0.0;
+	}
+}
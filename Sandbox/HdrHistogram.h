@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace se
+{
+	/*
+		High dynamic range histogram of unsigned values, typically nanosecond latencies.
+		Values below 2^subBucketBits are counted exactly, larger values with a relative precision of 2^-(subBucketBits - 1), about 1.6%.
+		Values of 2^maxValueBits and above (about 18 minutes in nanoseconds) are counted in the last bucket.
+		Memory use is fixed and recording never allocates.
+	*/
+	class HdrHistogram
+	{
+	public:
+
+		static constexpr unsigned subBucketBits = 7;
+		static constexpr unsigned maxValueBits = 40;
+
+		HdrHistogram();
+
+		inline void record(const uint64_t value)
+		{
+			record(value, 1);
+		}
+		void record(const uint64_t value, const uint64_t count);
+
+		// Adds the counts of another histogram
+		void add(const HdrHistogram& other);
+
+		void reset();
+
+		// 0 <= percentile <= 100. Returns the highest value that is equivalent to the value at the percentile, or 0 when empty.
+		uint64_t getValueAtPercentile(const double percentile) const;
+		double getMean() const;
+
+		inline uint64_t getCount() const
+		{
+			return totalCount;
+		}
+
+		inline uint64_t getSum() const
+		{
+			return sum;
+		}
+
+		// Exact extremes, 0 when empty
+		inline uint64_t getMin() const
+		{
+			return totalCount ? min : 0;
+		}
+
+		inline uint64_t getMax() const
+		{
+			return max;
+		}
+
+	private:
+
+		static size_t getIndex(const uint64_t value);
+		static uint64_t getHighestEquivalentValue(const size_t index);
+
+		std::vector<uint64_t> counts;
+		uint64_t totalCount = 0;
+		uint64_t sum = 0;
+		uint64_t min = ~uint64_t(0);
+		uint64_t max = 0;
+	};
+}
@@ -0,0 +1,372 @@
+#include "stdafx.h"
+#include "Sandbox/IntegerCoding.h"
+
+#include "SpehsEngine/Core/WriteBuffer.h"
+#include "SpehsEngine/Core/ReadBuffer.h"
+#include "Sandbox/VarInt.h"
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SE_INTEGER_CODING_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SE_INTEGER_CODING_SSE2
+#endif
+
+
+namespace se
+{
+	namespace
+	{
+		inline uint64_t loadLittleEndian64(const uint8_t* const bytes)
+		{
+			return uint64_t(bytes[0])
+				| uint64_t(bytes[1]) << 8
+				| uint64_t(bytes[2]) << 16
+				| uint64_t(bytes[3]) << 24
+				| uint64_t(bytes[4]) << 32
+				| uint64_t(bytes[5]) << 40
+				| uint64_t(bytes[6]) << 48
+				| uint64_t(bytes[7]) << 56;
+		}
+
+		inline uint64_t getBitMask(const unsigned bitWidth)
+		{
+			return bitWidth >= 64 ? ~uint64_t(0) : ((uint64_t(1) << bitWidth) - 1);
+		}
+
+		// Reads bitWidth bits at an arbitrary bit offset, reading past the end of the packed data is not allowed
+		inline uint64_t readBits(const uint8_t* const bytes, const size_t byteCount, const size_t bitOffset, const unsigned bitWidth)
+		{
+			const size_t byteOffset = bitOffset >> 3;
+			const unsigned shift = unsigned(bitOffset & 7);
+			uint8_t window[16] = {};
+			memcpy(window, bytes + byteOffset, std::min(byteCount - byteOffset, sizeof(window)));
+			uint64_t value = loadLittleEndian64(window) >> shift;
+			if (shift + bitWidth > 64)
+			{
+				value |= loadLittleEndian64(window + 8) << (64 - shift);
+			}
+			return value & getBitMask(bitWidth);
+		}
+
+#if defined(SE_INTEGER_CODING_SSE2)
+		// Writes base plus the running sums of 8 signed 16 bit deltas and returns the last written value
+		inline uint64_t storePrefixSums(uint64_t* const values, __m128i sums, const uint64_t base)
+		{
+			sums = _mm_add_epi16(sums, _mm_slli_si128(sums, 2));
+			sums = _mm_add_epi16(sums, _mm_slli_si128(sums, 4));
+			sums = _mm_add_epi16(sums, _mm_slli_si128(sums, 8));
+			const __m128i baseVector = _mm_set1_epi64x(int64_t(base));
+			const __m128i sums32Low = _mm_unpacklo_epi16(sums, _mm_srai_epi16(sums, 15));
+			const __m128i sums32High = _mm_unpackhi_epi16(sums, _mm_srai_epi16(sums, 15));
+			const __m128i signsLow = _mm_srai_epi32(sums32Low, 31);
+			const __m128i signsHigh = _mm_srai_epi32(sums32High, 31);
+			_mm_storeu_si128((__m128i*)(values + 0), _mm_add_epi64(baseVector, _mm_unpacklo_epi32(sums32Low, signsLow)));
+			_mm_storeu_si128((__m128i*)(values + 2), _mm_add_epi64(baseVector, _mm_unpackhi_epi32(sums32Low, signsLow)));
+			_mm_storeu_si128((__m128i*)(values + 4), _mm_add_epi64(baseVector, _mm_unpacklo_epi32(sums32High, signsHigh)));
+			_mm_storeu_si128((__m128i*)(values + 6), _mm_add_epi64(baseVector, _mm_unpackhi_epi32(sums32High, signsHigh)));
+			return values[7];
+		}
+#endif
+	}
+
+	unsigned getBitWidth(uint64_t value)
+	{
+		unsigned bitWidth = 0;
+		while (value)
+		{
+			bitWidth++;
+			value >>= 1;
+		}
+		return bitWidth;
+	}
+
+	void writeBitPacked(WriteBuffer& writeBuffer, const uint64_t* const values, const size_t count, const unsigned bitWidth)
+	{
+		se_assert(bitWidth <= 64);
+		if (bitWidth == 0)
+		{
+			return;
+		}
+
+		const uint64_t mask = getBitMask(bitWidth);
+		uint8_t chunk[256];
+		size_t chunkSize = 0;
+		uint64_t accumulator = 0;
+		unsigned accumulatedBits = 0; // Always less than 8 between values
+		for (size_t i = 0; i < count; i++)
+		{
+			const uint64_t value = values[i] & mask;
+			accumulator |= value << accumulatedBits;
+			const uint64_t overflow = accumulatedBits > 0 ? value >> (64 - accumulatedBits) : 0;
+			accumulatedBits += bitWidth;
+			if (accumulatedBits >= 64)
+			{
+				for (unsigned b = 0; b < 8; b++)
+				{
+					chunk[chunkSize++] = uint8_t(accumulator >> (b * 8));
+				}
+				accumulator = overflow;
+				accumulatedBits -= 64;
+			}
+			while (accumulatedBits >= 8)
+			{
+				chunk[chunkSize++] = uint8_t(accumulator);
+				accumulator >>= 8;
+				accumulatedBits -= 8;
+			}
+			if (chunkSize > sizeof(chunk) - 16)
+			{
+				writeBuffer.write(chunk, chunkSize);
+				chunkSize = 0;
+			}
+		}
+		if (accumulatedBits > 0)
+		{
+			chunk[chunkSize++] = uint8_t(accumulator);
+		}
+		writeBuffer.write(chunk, chunkSize);
+	}
+
+	bool readBitPacked(ReadBuffer& readBuffer, uint64_t* const values, const size_t count, const unsigned bitWidth)
+	{
+		if (bitWidth > 64)
+		{
+			return false;
+		}
+		if (bitWidth == 0)
+		{
+			std::fill(values, values + count, uint64_t(0));
+			return true;
+		}
+		const size_t byteCount = (count * bitWidth + 7) / 8;
+		if (count > readBuffer.getBytesRemaining() * 8 || readBuffer.getBytesRemaining() < byteCount)
+		{
+			return false;
+		}
+
+		const uint8_t* const bytes = (const uint8_t*)readBuffer.getData() + readBuffer.getOffset();
+		const uint64_t mask = getBitMask(bitWidth);
+		// Values whose 16 byte window stays inside the packed data can be decoded without bounds handling
+		const size_t safeCount = byteCount >= 16 ? std::min(count, ((byteCount - 16) * 8) / bitWidth) : 0;
+		if (bitWidth <= 56)
+		{
+			size_t i = 0;
+#if defined(SE_INTEGER_CODING_AVX2)
+			// Gathers the 8 bytes that contain each value and shifts every lane by its own bit offset.
+			// SSE2 has no per lane 64 bit shifts, without AVX2 the scalar loop decodes every value.
+			const __m256i maskVector = _mm256_set1_epi64x(int64_t(mask));
+			const __m256i shiftMask = _mm256_set1_epi64x(7);
+			const __m256i step = _mm256_set1_epi64x(int64_t(bitWidth) * 4);
+			__m256i bitOffsets = _mm256_setr_epi64x(0, int64_t(bitWidth), int64_t(bitWidth) * 2, int64_t(bitWidth) * 3);
+			for (; i + 4 <= safeCount; i += 4)
+			{
+				const __m256i words = _mm256_i64gather_epi64((const long long*)bytes, _mm256_srli_epi64(bitOffsets, 3), 1);
+				const __m256i shifted = _mm256_srlv_epi64(words, _mm256_and_si256(bitOffsets, shiftMask));
+				_mm256_storeu_si256((__m256i*)(values + i), _mm256_and_si256(shifted, maskVector));
+				bitOffsets = _mm256_add_epi64(bitOffsets, step);
+			}
+#endif
+			for (; i < safeCount; i++)
+			{
+				const size_t bitOffset = i * bitWidth;
+				values[i] = (loadLittleEndian64(bytes + (bitOffset >> 3)) >> (bitOffset & 7)) & mask;
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < safeCount; i++)
+			{
+				values[i] = readBits(bytes, byteCount, i * bitWidth, bitWidth);
+			}
+		}
+		for (size_t i = safeCount; i < count; i++)
+		{
+			values[i] = readBits(bytes, byteCount, i * bitWidth, bitWidth);
+		}
+		readBuffer.translate(int(byteCount));
+		return true;
+	}
+
+	void writeDeltaVarInts(WriteBuffer& writeBuffer, const uint64_t* const values, const size_t count, uint64_t& previous)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			writeVarUInt(writeBuffer, zigzagEncode(int64_t(values[i] - previous)));
+			previous = values[i];
+		}
+	}
+
+	bool readDeltaVarInts(ReadBuffer& readBuffer, uint64_t* const values, const size_t count, uint64_t& previous)
+	{
+		const uint8_t* const begin = (const uint8_t*)readBuffer.getData() + readBuffer.getOffset();
+		const uint8_t* const end = begin + readBuffer.getBytesRemaining();
+		const uint8_t* bytes = begin;
+		uint64_t value = previous;
+		size_t i = 0;
+		while (i < count)
+		{
+#if defined(SE_INTEGER_CODING_SSE2)
+			// 16 single byte varints at once: zigzag decoded in 8 bit lanes, then widened and prefix summed in 16 bit lanes
+			if (count - i >= 16 && end - bytes >= 16)
+			{
+				const __m128i encoded = _mm_loadu_si128((const __m128i*)bytes);
+				if (_mm_movemask_epi8(encoded) == 0)
+				{
+					const __m128i zero = _mm_setzero_si128();
+					const __m128i halved = _mm_and_si128(_mm_srli_epi16(encoded, 1), _mm_set1_epi8(0x7f));
+					const __m128i signs = _mm_sub_epi8(zero, _mm_and_si128(encoded, _mm_set1_epi8(1)));
+					const __m128i deltas = _mm_xor_si128(halved, signs);
+					value = storePrefixSums(values + i, _mm_srai_epi16(_mm_unpacklo_epi8(zero, deltas), 8), value);
+					value = storePrefixSums(values + i + 8, _mm_srai_epi16(_mm_unpackhi_epi8(zero, deltas), 8), value);
+					bytes += 16;
+					i += 16;
+					continue;
+				}
+			}
+#endif
+			// Fast path: 8 single byte varints at once, the typical case for slowly changing values
+			if (count - i >= 8 && end - bytes >= 8)
+			{
+				const uint64_t word = loadLittleEndian64(bytes);
+				if ((word & 0x8080808080808080ull) == 0)
+				{
+					for (size_t b = 0; b < 8; b++)
+					{
+						value += uint64_t(zigzagDecode((word >> (b * 8)) & 0x7f));
+						values[i + b] = value;
+					}
+					bytes += 8;
+					i += 8;
+					continue;
+				}
+			}
+
+			uint64_t encoded = 0;
+			unsigned shift = 0;
+			while (true)
+			{
+				if (bytes == end || shift >= 64)
+				{
+					return false;
+				}
+				const uint8_t byte = *bytes++;
+				encoded |= uint64_t(byte & 0x7f) << shift;
+				shift += 7;
+				if ((byte & 0x80) == 0)
+				{
+					break;
+				}
+			}
+			value += uint64_t(zigzagDecode(encoded));
+			values[i++] = value;
+		}
+		readBuffer.translate(int(bytes - begin));
+		previous = value;
+		return true;
+	}
+
+	void writeDeltaBlock(WriteBuffer& writeBuffer, const uint64_t* const values, const size_t count, uint64_t& previous)
+	{
+		writeVarUInt(writeBuffer, count);
+		if (count == 0)
+		{
+			return;
+		}
+
+		// The first delta is written on its own so that a jump from the previous value doesn't widen the whole block
+		writeVarInt(writeBuffer, int64_t(values[0] - previous));
+		previous = values[count - 1];
+		if (count == 1)
+		{
+			return;
+		}
+
+		std::vector<uint64_t> deltas(count - 1);
+		int64_t minDelta = int64_t(values[1] - values[0]);
+		for (size_t i = 1; i < count; i++)
+		{
+			const int64_t delta = int64_t(values[i] - values[i - 1]);
+			deltas[i - 1] = uint64_t(delta);
+			minDelta = std::min(minDelta, delta);
+		}
+		uint64_t maxOffset = 0;
+		for (uint64_t& delta : deltas)
+		{
+			delta -= uint64_t(minDelta);
+			maxOffset = std::max(maxOffset, delta);
+		}
+		const unsigned bitWidth = getBitWidth(maxOffset);
+
+		writeVarInt(writeBuffer, minDelta);
+		writeBuffer.write(uint8_t(bitWidth));
+		writeBitPacked(writeBuffer, deltas.data(), deltas.size(), bitWidth);
+	}
+
+	bool readDeltaBlock(ReadBuffer& readBuffer, std::vector<uint64_t>& values, uint64_t& previous, const size_t maxCount)
+	{
+		values.clear();
+		uint64_t count = 0;
+		if (!readVarUInt(readBuffer, count) || count > maxCount)
+		{
+			return false;
+		}
+		if (count == 0)
+		{
+			return true;
+		}
+
+		int64_t firstDelta = 0;
+		if (!readVarInt(readBuffer, firstDelta))
+		{
+			return false;
+		}
+		int64_t minDelta = 0;
+		uint8_t bitWidth = 0;
+		if (count > 1 && (!readVarInt(readBuffer, minDelta) || !readBuffer.read(bitWidth)))
+		{
+			return false;
+		}
+		values.resize(size_t(count));
+		const uint64_t first = previous + uint64_t(firstDelta);
+		values[0] = first;
+		if (bitWidth == 0)
+		{
+			// Evenly spaced values, there are no packed offsets to add
+			size_t i = 1;
+#if defined(SE_INTEGER_CODING_SSE2)
+			__m128i lanes = _mm_add_epi64(_mm_set1_epi64x(int64_t(first)), _mm_set_epi64x(int64_t(uint64_t(minDelta) * 2), minDelta));
+			const __m128i step = _mm_set1_epi64x(int64_t(uint64_t(minDelta) * 2));
+			for (; i + 2 <= values.size(); i += 2)
+			{
+				_mm_storeu_si128((__m128i*)(values.data() + i), lanes);
+				lanes = _mm_add_epi64(lanes, step);
+			}
+#endif
+			for (; i < values.size(); i++)
+			{
+				values[i] = first + uint64_t(i) * uint64_t(minDelta);
+			}
+			previous = values.back();
+			return true;
+		}
+		if (!readBitPacked(readBuffer, values.data() + 1, values.size() - 1, bitWidth))
+		{
+			values.clear();
+			return false;
+		}
+
+		// Prefix sum of the deltas
+		uint64_t value = first;
+		for (size_t i = 1; i < values.size(); i++)
+		{
+			value += values[i] + uint64_t(minDelta);
+			values[i] = value;
+		}
+		previous = value;
+		return true;
+	}
+}
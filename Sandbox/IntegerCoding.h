@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace se
+{
+	class WriteBuffer;
+	class ReadBuffer;
+
+	/*
+		Opt-in compact encodings for integer payloads, built on top of WriteBuffer/ReadBuffer.
+		Readers must use the matching read function, none of the formats are self describing.
+
+		Delta varints: each value is written as the zigzag varint of its difference to the previous value.
+		Slowly changing values take one byte each, arbitrary values never take more than 10 bytes.
+
+		Delta blocks: a frame of reference encoding of the differences between consecutive values.
+		The smallest difference is written once and the rest are bit-packed relative to it, so an evenly increasing counter takes no payload bits at all.
+
+		Streams pass the same 'previous' value from one call to the next, on both ends. Arrays start from previous = 0.
+	*/
+
+	// Number of bits needed to store the value, 0 for 0
+	unsigned getBitWidth(uint64_t value);
+
+	// Writes the low bitWidth bits of each value, bitWidth in range [0, 64]
+	void writeBitPacked(WriteBuffer& writeBuffer, const uint64_t* const values, const size_t count, const unsigned bitWidth);
+	bool readBitPacked(ReadBuffer& readBuffer, uint64_t* const values, const size_t count, const unsigned bitWidth);
+
+	void writeDeltaVarInts(WriteBuffer& writeBuffer, const uint64_t* const values, const size_t count, uint64_t& previous);
+	bool readDeltaVarInts(ReadBuffer& readBuffer, uint64_t* const values, const size_t count, uint64_t& previous);
+
+	/*
+		Format:
+		varint value count
+		zigzag varint delta of the first value
+		if count > 1:
+			zigzag varint smallest delta among the remaining values
+			uint8_t bit width
+			bit-packed (delta - smallest delta) for each remaining value
+	*/
+	void writeDeltaBlock(WriteBuffer& writeBuffer, const uint64_t* const values, const size_t count, uint64_t& previous);
+	// Replaces the contents of values. maxCount protects against corrupt or malicious counts.
+	bool readDeltaBlock(ReadBuffer& readBuffer, std::vector<uint64_t>& values, uint64_t& previous, const size_t maxCount = 1 << 24);
+}
@@ -0,0 +1,49 @@
+#include "stdafx.h"
+#include "Sandbox/JsonUtilityFunctions.h"
+
+#include "SpehsEngine/Core/StringUtilityFunctions.h"
+#include <cmath>
+#include <stdint.h>
+
+
+namespace se
+{
+	std::string escapeJson(const std::string& string)
+	{
+		std::string escaped;
+		escaped.reserve(string.size());
+		for (const char c : string)
+		{
+			switch (c)
+			{
+			case '"': escaped += "\\\""; break;
+			case '\\': escaped += "\\\\"; break;
+			case '\b': escaped += "\\b"; break;
+			case '\f': escaped += "\\f"; break;
+			case '\n': escaped += "\\n"; break;
+			case '\r': escaped += "\\r"; break;
+			case '\t': escaped += "\\t"; break;
+			default:
+				if (uint8_t(c) < 0x20)
+				{
+					escaped += formatString("\\u%04x", unsigned(uint8_t(c)));
+				}
+				else
+				{
+					escaped += c;
+				}
+				break;
+			}
+		}
+		return escaped;
+	}
+
+	std::string formatJsonNumber(const double value)
+	{
+		if (!std::isfinite(value))
+		{
+			return "null";
+		}
+		return formatString("%.15g", value);
+	}
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+
+namespace se
+{
+	// Escapes a string for use inside a JSON string literal. Quotes, backslashes and every control character below 0x20 are escaped.
+	std::string escapeJson(const std::string& string);
+
+	// Formats a number for JSON. NaN and infinities have no JSON representation and are written as null.
+	std::string formatJsonNumber(const double value);
+}
@@ -0,0 +1,162 @@
+#include "stdafx.h"
+#include "Sandbox/LazyTypelessPointer.h"
+
+#include "SpehsEngine/Core/WriteBuffer.h"
+#include "SpehsEngine/Core/ReadBuffer.h"
+#include "SpehsEngine/Core/StringUtilityFunctions.h"
+#include "Sandbox/TypelessTypeDictionary.h"
+#include <limits>
+
+
+namespace se
+{
+	/*
+		Format:
+		type header, TypelessTypeInfo::writeType() or TypelessTypeDictionary::writeType() (null = nothing follows)
+		uint32_t body size
+		body, as written by the type's write function
+	*/
+
+	void LazyTypelessPointer::write(WriteBuffer& writeBuffer, const TypelessPointer& typelessPointer)
+	{
+		writeImpl(writeBuffer, nullptr, typelessPointer.typeInfo, typelessPointer.data);
+	}
+
+	void LazyTypelessPointer::write(WriteBuffer& writeBuffer, const TypelessPointer& typelessPointer, const TypelessTypeDictionary& dictionary)
+	{
+		writeImpl(writeBuffer, &dictionary, typelessPointer.typeInfo, typelessPointer.data);
+	}
+
+	void LazyTypelessPointer::writeImpl(WriteBuffer& writeBuffer, const TypelessTypeDictionary* const dictionary, const TypelessTypeInfo* const typeInfo, const void* const data)
+	{
+		const TypelessTypeInfo* const writtenTypeInfo = data ? typeInfo : nullptr;
+		const bool typeWritten = dictionary
+			? dictionary->writeType(writeBuffer, writtenTypeInfo)
+			: TypelessTypeInfo::writeType(writeBuffer, writtenTypeInfo);
+		if (typeWritten)
+		{
+			// The body size is only known after writing it, so the body is written in place after a fixed width size that is filled in afterwards
+			const size_t sizeOffset = writeBuffer.getOffset();
+			writeBuffer.write(uint32_t(0));
+			writtenTypeInfo->writeToBufferFunction(writeBuffer, data);
+			const size_t bodySize = writeBuffer.getOffset() - sizeOffset - sizeof(uint32_t);
+			// WriteBuffer::translate() takes an int
+			se_assert(bodySize <= size_t(std::numeric_limits<int>::max()) - sizeof(uint32_t));
+			if (!writeBuffer.translate(-int(bodySize + sizeof(uint32_t))))
+			{
+				log::error(formatString("Failed to write the body size of type: %s", writtenTypeInfo->name));
+				return;
+			}
+			writeBuffer.write(uint32_t(bodySize));
+			if (!writeBuffer.translate(int(bodySize)))
+			{
+				log::error(formatString("Failed to write the body size of type: %s", writtenTypeInfo->name));
+			}
+		}
+	}
+
+	void LazyTypelessPointer::write(WriteBuffer& writeBuffer) const
+	{
+		if (decoded)
+		{
+			writeImpl(writeBuffer, nullptr, typeInfo, decoded.data);
+		}
+		else if (TypelessTypeInfo::writeType(writeBuffer, typeInfo))
+		{
+			writeBuffer.write(uint32_t(encodedSize));
+			writeBuffer.write(encodedData, encodedSize);
+		}
+	}
+
+	void LazyTypelessPointer::write(WriteBuffer& writeBuffer, const TypelessTypeDictionary& dictionary) const
+	{
+		if (decoded)
+		{
+			writeImpl(writeBuffer, &dictionary, typeInfo, decoded.data);
+		}
+		else if (dictionary.writeType(writeBuffer, typeInfo))
+		{
+			writeBuffer.write(uint32_t(encodedSize));
+			writeBuffer.write(encodedData, encodedSize);
+		}
+	}
+
+	bool LazyTypelessPointer::read(ReadBuffer& readBuffer)
+	{
+		return readImpl(readBuffer, nullptr);
+	}
+
+	bool LazyTypelessPointer::read(ReadBuffer& readBuffer, const TypelessTypeDictionary& dictionary)
+	{
+		return readImpl(readBuffer, &dictionary);
+	}
+
+	bool LazyTypelessPointer::readImpl(ReadBuffer& readBuffer, const TypelessTypeDictionary* const dictionary)
+	{
+		reset();
+		const TypelessTypeInfo* writtenTypeInfo = nullptr;
+		const bool typeRead = dictionary
+			? dictionary->readType(readBuffer, writtenTypeInfo)
+			: TypelessTypeInfo::readType(readBuffer, writtenTypeInfo);
+		if (!typeRead)
+		{
+			return false;
+		}
+		if (!writtenTypeInfo)
+		{
+			return true;
+		}
+
+		uint32_t size = 0;
+		if (!readBuffer.read(size) || size_t(size) > readBuffer.getBytesRemaining() || size > uint32_t(std::numeric_limits<int>::max()))
+		{
+			return false;
+		}
+		const std::byte* const data = (const std::byte*)readBuffer.getData() + readBuffer.getOffset();
+		if (!readBuffer.translate(int(size)))
+		{
+			return false;
+		}
+		typeInfo = writtenTypeInfo;
+		encodedData = data;
+		encodedSize = size_t(size);
+		return true;
+	}
+
+	bool LazyTypelessPointer::decode() const
+	{
+		if (decoded)
+		{
+			return true;
+		}
+		if (!typeInfo || decodeFailed)
+		{
+			return false;
+		}
+
+		ReadBuffer bodyBuffer(encodedData, encodedSize);
+		decoded.data = (std::byte*)typeInfo->defaultConstruct();
+		decoded.typeInfo = typeInfo;
+		if (!typeInfo->readFromBufferFunction(bodyBuffer, decoded.data) || bodyBuffer.getBytesRemaining() != 0)
+		{
+			log::warning(formatString("Failed to decode lazily read object of type %s.", typeInfo->name));
+			decoded.reset();
+			decodeFailed = true;
+			return false;
+		}
+		encodedData = nullptr;
+		encodedSize = 0;
+		return true;
+	}
+
+	TypelessPointer LazyTypelessPointer::toPointer()
+	{
+		TypelessPointer typelessPointer;
+		if (decode())
+		{
+			typelessPointer.swap(decoded);
+		}
+		reset();
+		return typelessPointer;
+	}
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "Sandbox/TypelessTypeInfo.h"
+#include "Sandbox/TypelessPointer.h"
+#include <stddef.h>
+
+
+namespace se
+{
+	class WriteBuffer;
+	class ReadBuffer;
+	class TypelessTypeDictionary;
+
+	/*
+		Deferred decoding of a type erased object.
+		Objects must be written with LazyTypelessPointer::write(), which size prefixes the object body so that it can be skipped without decoding.
+		read() only records the type and the encoded byte range, the object is constructed and decoded on the first get<T>() of the matching type.
+		Writing an undecoded object copies the encoded bytes as is, so forwarding a payload never constructs it.
+		Until decoded, the pointer refers to the read buffer memory and is only valid for the lifetime of that memory.
+	*/
+	class LazyTypelessPointer
+	{
+	public:
+
+		LazyTypelessPointer() = default;
+
+		LazyTypelessPointer(LazyTypelessPointer&& move)
+		{
+			swap(move);
+		}
+
+		void operator=(LazyTypelessPointer&& move)
+		{
+			swap(move);
+		}
+
+		LazyTypelessPointer(const LazyTypelessPointer& copy) = delete;
+		void operator=(const LazyTypelessPointer& copy) = delete;
+
+		// Lazy format writers for owning pointers and plain objects
+		static void write(WriteBuffer& writeBuffer, const TypelessPointer& typelessPointer);
+		static void write(WriteBuffer& writeBuffer, const TypelessPointer& typelessPointer, const TypelessTypeDictionary& dictionary);
+		template<typename T>
+		static void write(WriteBuffer& writeBuffer, const T& t)
+		{
+			writeImpl(writeBuffer, nullptr, &TypelessTypeInfo::get<T>(), &t);
+		}
+
+		void write(WriteBuffer& writeBuffer) const;
+		void write(WriteBuffer& writeBuffer, const TypelessTypeDictionary& dictionary) const;
+		bool read(ReadBuffer& readBuffer);
+		bool read(ReadBuffer& readBuffer, const TypelessTypeDictionary& dictionary);
+
+		inline explicit operator bool() const
+		{
+			return typeInfo != nullptr;
+		}
+
+		inline bool hasValue() const
+		{
+			return typeInfo != nullptr;
+		}
+
+		// Decodes the object on first access. Returns nullptr if the type doesn't match or if decoding fails.
+		template<typename T>
+		T* get()
+		{
+			if (typeInfo == &TypelessTypeInfo::get<T>() && decode())
+			{
+				return (T*)decoded.data;
+			}
+			else
+			{
+				return nullptr;
+			}
+		}
+
+		template<typename T>
+		const T* get() const
+		{
+			if (typeInfo == &TypelessTypeInfo::get<T>() && decode())
+			{
+				return (const T*)decoded.data;
+			}
+			else
+			{
+				return nullptr;
+			}
+		}
+
+		// Returns false if empty or if the encoded object could not be decoded
+		bool decode() const;
+
+		// Takes the decoded object, leaving this pointer empty
+		TypelessPointer toPointer();
+
+		inline bool isDecoded() const
+		{
+			return decoded.hasValue();
+		}
+
+		inline const TypelessTypeInfo* getTypeInfo() const
+		{
+			return typeInfo;
+		}
+
+		// Returns 0 after the object has been decoded
+		inline size_t getEncodedSize() const
+		{
+			return encodedSize;
+		}
+
+		void reset()
+		{
+			decoded.reset();
+			typeInfo = nullptr;
+			encodedData = nullptr;
+			encodedSize = 0;
+			decodeFailed = false;
+		}
+
+		void swap(LazyTypelessPointer& other)
+		{
+			decoded.swap(other.decoded);
+			std::swap(typeInfo, other.typeInfo);
+			std::swap(encodedData, other.encodedData);
+			std::swap(encodedSize, other.encodedSize);
+			std::swap(decodeFailed, other.decodeFailed);
+		}
+
+	private:
+
+		static void writeImpl(WriteBuffer& writeBuffer, const TypelessTypeDictionary* const dictionary, const TypelessTypeInfo* const typeInfo, const void* const data);
+		bool readImpl(ReadBuffer& readBuffer, const TypelessTypeDictionary* const dictionary);
+
+		const TypelessTypeInfo* typeInfo = nullptr;
+
+		// Decode cache, decoding doesn't change the logical value
+		mutable const std::byte* encodedData = nullptr;
+		mutable size_t encodedSize = 0;
+		mutable bool decodeFailed = false;
+		mutable TypelessPointer decoded;
+	};
+}
@@ -0,0 +1,200 @@
+#include "stdafx.h"
+#include "Sandbox/LinkEmulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+
+namespace se
+{
+	LinkEmulator::LinkEmulator(const Settings& _settings, const DeliverFunction& _deliver)
+		: settings(_settings)
+		, deliver(_deliver)
+		, generator(_settings.seed)
+	{
+		se_assert(deliver);
+		se_assert(!settings.replayTrace || !settings.replayTrace->empty());
+	}
+
+	double LinkEmulator::random()
+	{
+		return double(generator() >> 11) * (1.0 / double(uint64_t(1) << 53));
+	}
+
+	LinkEmulator::Fate LinkEmulator::generateFate()
+	{
+		// Every packet draws the same number of values, so that one setting does not shift the random sequence of the others
+		const double lossValue = random();
+		const double transitionValue = random();
+		const double duplicateValue = random();
+		const double reorderValue = random();
+		const double jitterValue = random();
+
+		Fate fate;
+		fate.lost = lossValue < (badState ? settings.loss.badLoss : settings.loss.goodLoss);
+		badState = badState ? transitionValue >= settings.loss.badToGood : transitionValue < settings.loss.goodToBad;
+		fate.duplicated = duplicateValue < settings.duplicateChance;
+		if (reorderValue < settings.reorderChance)
+		{
+			// Skipping the latency overtakes the packets sent before this one
+			fate.delayMicroseconds = 0;
+			stats.packetsReordered += fate.lost ? 0 : 1;
+		}
+		else
+		{
+			const int64_t jitter = settings.jitter.count();
+			const int64_t delay = settings.latency.count() + int64_t(std::floor(jitterValue * double(2 * jitter + 1))) - jitter;
+			fate.delayMicroseconds = uint32_t(std::clamp(delay, int64_t(0), int64_t(UINT32_MAX)));
+		}
+		return fate;
+	}
+
+	void LinkEmulator::send(const void* const data, const size_t size, const bool reliable, const Clock::time_point now)
+	{
+		stats.packetsSent++;
+
+		// Time spent waiting for and going through the bandwidth limited link
+		Clock::time_point departureTime = now;
+		if (settings.bytesPerSecond > 0)
+		{
+			const Clock::time_point queueBegin = std::max(linkFreeTime, now);
+			if (!reliable && settings.queueBytes > 0)
+			{
+				const double queuedBytes = std::chrono::duration<double>(queueBegin - now).count() * double(settings.bytesPerSecond);
+				if (queuedBytes + double(size) > double(settings.queueBytes))
+				{
+					stats.packetsDropped++;
+					return;
+				}
+			}
+			linkFreeTime = queueBegin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(double(size) / double(settings.bytesPerSecond)));
+			departureTime = linkFreeTime;
+		}
+
+		if (reliable)
+		{
+			// The connection resends lost reliable packets on its own, so they are only delayed, in order
+			const Clock::time_point deliveryTime = std::max(departureTime + settings.latency, lastReliableDeliveryTime);
+			lastReliableDeliveryTime = deliveryTime;
+			enqueue(data, size, true, deliveryTime);
+			return;
+		}
+
+		Fate fate;
+		if (settings.replayTrace)
+		{
+			fate = (*settings.replayTrace)[replayIndex];
+			replayIndex = (replayIndex + 1) % settings.replayTrace->size();
+		}
+		else
+		{
+			fate = generateFate();
+		}
+		if (settings.recordTrace)
+		{
+			recordedTrace.push_back(fate);
+		}
+
+		if (fate.lost)
+		{
+			stats.packetsLost++;
+			return;
+		}
+		const Clock::time_point deliveryTime = departureTime + std::chrono::microseconds(fate.delayMicroseconds);
+		enqueue(data, size, false, deliveryTime);
+		if (fate.duplicated)
+		{
+			stats.packetsDuplicated++;
+			enqueue(data, size, false, deliveryTime);
+		}
+	}
+
+	void LinkEmulator::enqueue(const void* const data, const size_t size, const bool reliable, const Clock::time_point deliveryTime)
+	{
+		Packet packet;
+		packet.deliveryTime = deliveryTime;
+		packet.order = nextOrder++;
+		packet.reliable = reliable;
+		packet.data.assign((const uint8_t*)data, (const uint8_t*)data + size);
+		packets.push_back(std::move(packet));
+		std::push_heap(packets.begin(), packets.end(), LaterPacket());
+	}
+
+	void LinkEmulator::update(const Clock::time_point now)
+	{
+		while (!packets.empty() && packets.front().deliveryTime <= now)
+		{
+			std::pop_heap(packets.begin(), packets.end(), LaterPacket());
+			const Packet packet = std::move(packets.back());
+			packets.pop_back();
+			stats.packetsDelivered++;
+			stats.bytesDelivered += packet.data.size();
+			// The deliver function may send more packets
+			deliver(packet.data, packet.reliable);
+		}
+	}
+
+	bool LinkEmulator::readTrace(const std::string& path, std::vector<Fate>& trace)
+	{
+		std::ifstream file(path);
+		if (!file)
+		{
+			log::warning("Failed to open link trace: " + path);
+			return false;
+		}
+		trace.clear();
+		std::string line;
+		size_t lineNumber = 0;
+		while (std::getline(file, line))
+		{
+			lineNumber++;
+			if (line.empty() || line[0] == '#' || line == "\r")
+			{
+				continue;
+			}
+			Fate fate;
+			if (line[0] == 'x')
+			{
+				fate.lost = true;
+			}
+			else
+			{
+				std::istringstream stream(line);
+				std::string flag;
+				if (!(stream >> fate.delayMicroseconds))
+				{
+					log::warning("Invalid link trace line " + std::to_string(lineNumber) + ": " + path);
+					return false;
+				}
+				fate.duplicated = (stream >> flag) && flag == "d";
+			}
+			trace.push_back(fate);
+		}
+		return true;
+	}
+
+	bool LinkEmulator::writeTrace(const std::string& path, const std::vector<Fate>& trace)
+	{
+		std::ofstream file(path, std::ios::trunc);
+		file << "# LinkEmulator trace: delay in microseconds per packet, d = duplicated, x = lost\n";
+		for (const Fate& fate : trace)
+		{
+			if (fate.lost)
+			{
+				file << "x\n";
+			}
+			else
+			{
+				file << fate.delayMicroseconds << (fate.duplicated ? " d\n" : "\n");
+			}
+		}
+		if (!file)
+		{
+			log::warning("Failed to write link trace: " + path);
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace se
+{
+	/*
+		Deterministic emulation of one direction of a network link at the packet level: latency, jitter, a bandwidth cap with a bounded queue,
+		bursty Gilbert-Elliott loss, duplication and reordering.
+		Every packet draws its fate from a seeded generator in send order, so the same seed and the same packet sequence always produce the same fates.
+		Fates can be recorded to a trace and replayed, which reproduces a run, or a converted real world capture, packet by packet.
+		Reliable packets are delayed and rate limited but never lost, duplicated or reordered, because the connection above the emulator expects them to arrive.
+		The emulator has no thread of its own, update() delivers the packets that are due.
+	*/
+	class LinkEmulator
+	{
+	public:
+
+		typedef std::chrono::steady_clock Clock;
+
+		// Two state Markov loss model. In the bad state packets are lost with badLoss probability, in the good state with goodLoss probability.
+		struct GilbertElliottLoss
+		{
+			double goodToBad = 0.0;		// Probability to enter the bad state after a packet
+			double badToGood = 1.0;		// Probability to leave the bad state after a packet
+			double goodLoss = 0.0;
+			double badLoss = 1.0;
+		};
+
+		// What happens to one packet
+		struct Fate
+		{
+			bool lost = false;
+			bool duplicated = false;
+			uint32_t delayMicroseconds = 0;	// Propagation delay, in addition to the time spent in the bandwidth queue
+		};
+
+		struct Settings
+		{
+			uint64_t seed = 1;
+			std::chrono::microseconds latency = std::chrono::microseconds(0);
+			std::chrono::microseconds jitter = std::chrono::microseconds(0);	// Uniform in [-jitter, jitter]
+			uint64_t bytesPerSecond = 0;										// 0 for unlimited
+			size_t queueBytes = 0;												// Unreliable packets that do not fit in the bandwidth queue are dropped, 0 for unlimited
+			GilbertElliottLoss loss;
+			double duplicateChance = 0.0;
+			double reorderChance = 0.0;											// Reordered packets skip the latency
+			std::shared_ptr<const std::vector<Fate>> replayTrace;				// Replaces the generated fates, repeats from the start when exhausted
+			bool recordTrace = false;
+		};
+
+		struct Stats
+		{
+			uint64_t packetsSent = 0;
+			uint64_t packetsDelivered = 0;
+			uint64_t packetsLost = 0;
+			uint64_t packetsDropped = 0;	// By the bandwidth queue
+			uint64_t packetsDuplicated = 0;
+			uint64_t packetsReordered = 0;
+			uint64_t bytesDelivered = 0;
+		};
+
+		typedef std::function<void(const std::vector<uint8_t>& data, const bool reliable)> DeliverFunction;
+
+		LinkEmulator(const Settings& settings, const DeliverFunction& deliver);
+
+		LinkEmulator(const LinkEmulator& copy) = delete;
+		void operator=(const LinkEmulator& copy) = delete;
+
+		void send(const void* const data, const size_t size, const bool reliable, const Clock::time_point now);
+
+		// Delivers every packet that is due at now
+		void update(const Clock::time_point now);
+
+		// Number of packets in flight
+		inline size_t getQueueSize() const
+		{
+			return packets.size();
+		}
+
+		inline const Stats& getStats() const
+		{
+			return stats;
+		}
+
+		// Fates of the unreliable packets sent so far, when recordTrace is set
+		inline const std::vector<Fate>& getRecordedTrace() const
+		{
+			return recordedTrace;
+		}
+
+		/*
+			Trace files have one line per unreliable packet: the delay in microseconds, followed by " d" if the packet was duplicated, or "x" if the packet was lost.
+			Empty lines and lines starting with # are ignored.
+		*/
+		static bool readTrace(const std::string& path, std::vector<Fate>& trace);
+		static bool writeTrace(const std::string& path, const std::vector<Fate>& trace);
+
+	private:
+
+		struct Packet
+		{
+			Clock::time_point deliveryTime;
+			uint64_t order = 0;				// Keeps packets with the same delivery time in send order
+			bool reliable = false;
+			std::vector<uint8_t> data;
+		};
+
+		struct LaterPacket
+		{
+			inline bool operator()(const Packet& a, const Packet& b) const
+			{
+				return a.deliveryTime != b.deliveryTime ? a.deliveryTime > b.deliveryTime : a.order > b.order;
+			}
+		};
+
+		// Uniform in [0, 1), computed from the raw generator output so that it is the same on every standard library
+		double random();
+		Fate generateFate();
+		void enqueue(const void* const data, const size_t size, const bool reliable, const Clock::time_point deliveryTime);
+
+		const Settings settings;
+		const DeliverFunction deliver;
+		std::mt19937_64 generator;
+		bool badState = false;
+		size_t replayIndex = 0;
+		uint64_t nextOrder = 0;
+		Clock::time_point linkFreeTime;
+		Clock::time_point lastReliableDeliveryTime;
+		std::vector<Packet> packets; // Heap ordered by LaterPacket, the next packet to deliver is at the front
+		std::vector<Fate> recordedTrace;
+		Stats stats;
+	};
+}
@@ -0,0 +1,406 @@
+#include "stdafx.h"
+#include "Sandbox/MessageStream.h"
+
+#include "Sandbox/VarInt.h"
+#include <algorithm>
+#include <string.h>
+
+
+namespace se
+{
+	namespace
+	{
+		template<typename T>
+		void sendMessage(const StreamSendFunction& send, const T& message)
+		{
+			WriteBuffer writeBuffer;
+			TypelessMessageRouter::write(writeBuffer, message);
+			send(writeBuffer);
+		}
+	}
+
+	void StreamChunk::write(WriteBuffer& writeBuffer, const uint64_t streamId, const uint64_t offset, const void* const data, const size_t size)
+	{
+		writeVarUInt(writeBuffer, streamId);
+		writeVarUInt(writeBuffer, offset);
+		writeVarUInt(writeBuffer, size);
+		writeBuffer.write(data, size);
+	}
+
+	void StreamChunk::write(WriteBuffer& writeBuffer) const
+	{
+		write(writeBuffer, streamId, offset, data.data(), data.size());
+	}
+
+	bool StreamChunk::read(ReadBuffer& readBuffer)
+	{
+		uint64_t size = 0;
+		if (!readVarUInt(readBuffer, streamId) || !readVarUInt(readBuffer, offset) || !readVarUInt(readBuffer, size))
+		{
+			return false;
+		}
+		if (size > readBuffer.getBytesRemaining())
+		{
+			return false;
+		}
+		data.resize(size_t(size));
+		return readBuffer.read(data.data(), data.size());
+	}
+
+	OutgoingStream::OutgoingStream(const uint64_t _id, const uint64_t _expectedSize, const size_t _chunkSize, const StreamSendFunction& _send)
+		: id(_id)
+		, expectedSize(_expectedSize)
+		, chunkSize(_chunkSize)
+		, send(_send)
+	{
+		se_assert(chunkSize > 0);
+		se_assert(send);
+	}
+
+	OutgoingStream::~OutgoingStream()
+	{
+		close();
+	}
+
+	size_t OutgoingStream::write(const void* const data, const size_t size)
+	{
+		const size_t acceptedSize = size_t(std::min(uint64_t(size), getWritableBytes()));
+		for (size_t offset = 0; offset < acceptedSize; offset += chunkSize)
+		{
+			const size_t chunkDataSize = std::min(chunkSize, acceptedSize - offset);
+			WriteBuffer writeBuffer;
+			if (!TypelessTypeInfo::writeType(writeBuffer, &TypelessTypeInfo::get<StreamChunk>()))
+			{
+				// Nothing is sent or counted for a chunk without a type header
+				se_assert(false && "Failed to write the stream chunk type.");
+				return offset;
+			}
+			StreamChunk::write(writeBuffer, id, bytesWritten, (const uint8_t*)data + offset, chunkDataSize);
+			send(writeBuffer);
+			bytesWritten += chunkDataSize;
+		}
+		return acceptedSize;
+	}
+
+	void OutgoingStream::close()
+	{
+		if (closed)
+		{
+			return;
+		}
+		closed = true;
+		if (!canceled)
+		{
+			StreamEnd streamEnd;
+			streamEnd.streamId = id;
+			streamEnd.size = bytesWritten;
+			sendMessage(send, streamEnd);
+		}
+	}
+
+	void OutgoingStream::setWritableHandler(const std::function<void()>& function)
+	{
+		writableHandler = function;
+	}
+
+	void OutgoingStream::onCredit(const uint64_t _maxOffset)
+	{
+		if (_maxOffset <= maxOffset)
+		{
+			return;
+		}
+		maxOffset = _maxOffset;
+		if (isWritable() && writableHandler)
+		{
+			writableHandler();
+		}
+	}
+
+	void OutgoingStream::onCancel()
+	{
+		if (closed || canceled)
+		{
+			return;
+		}
+		canceled = true;
+		if (writableHandler)
+		{
+			writableHandler();
+		}
+	}
+
+	IncomingStream::IncomingStream(const uint64_t _id, const uint64_t _expectedSize, const size_t _window, const StreamSendFunction& _send)
+		: id(_id)
+		, expectedSize(_expectedSize)
+		, window(_window)
+		, send(_send)
+	{
+		se_assert(window > 0);
+		se_assert(send);
+	}
+
+	IncomingStream::~IncomingStream()
+	{
+		cancel();
+	}
+
+	void IncomingStream::open()
+	{
+		maxOffset = window;
+		StreamCredit streamCredit;
+		streamCredit.streamId = id;
+		streamCredit.maxOffset = maxOffset;
+		sendMessage(send, streamCredit);
+	}
+
+	void IncomingStream::setChunkHandler(const std::function<void(const uint8_t* data, const size_t size)>& function)
+	{
+		chunkHandler = function;
+		while (chunkHandler && !chunks.empty())
+		{
+			const std::vector<uint8_t> chunk = std::move(chunks.front());
+			const size_t size = chunk.size() - frontChunkOffset;
+			chunks.pop_front();
+			readableBytes -= size;
+			chunkHandler(chunk.data() + frontChunkOffset, size);
+			frontChunkOffset = 0;
+			consume(size);
+		}
+	}
+
+	void IncomingStream::setReadableHandler(const std::function<void()>& function)
+	{
+		readableHandler = function;
+	}
+
+	size_t IncomingStream::read(void* const data, const size_t size)
+	{
+		size_t readSize = 0;
+		while (readSize < size && !chunks.empty())
+		{
+			const std::vector<uint8_t>& chunk = chunks.front();
+			const size_t copySize = std::min(size - readSize, chunk.size() - frontChunkOffset);
+			memcpy((uint8_t*)data + readSize, chunk.data() + frontChunkOffset, copySize);
+			readSize += copySize;
+			frontChunkOffset += copySize;
+			if (frontChunkOffset == chunk.size())
+			{
+				chunks.pop_front();
+				frontChunkOffset = 0;
+			}
+		}
+		readableBytes -= readSize;
+		consume(readSize);
+		return readSize;
+	}
+
+	void IncomingStream::setEndHandler(const std::function<void()>& function)
+	{
+		endHandler = function;
+		if (finished && endHandler)
+		{
+			endHandler();
+		}
+	}
+
+	void IncomingStream::cancel()
+	{
+		if (canceled || finished)
+		{
+			return;
+		}
+		canceled = true;
+		chunks.clear();
+		frontChunkOffset = 0;
+		readableBytes = 0;
+		if (endSize == unknownStreamSize)
+		{
+			StreamCancel streamCancel;
+			streamCancel.streamId = id;
+			sendMessage(send, streamCancel);
+		}
+	}
+
+	void IncomingStream::onChunk(StreamChunk& chunk)
+	{
+		if (canceled || finished)
+		{
+			return;
+		}
+		if (chunk.offset != bytesReceived || endSize != unknownStreamSize)
+		{
+			log::warning("IncomingStream: stream " + std::to_string(id) + " received data out of order.");
+			cancel();
+			return;
+		}
+		if (bytesReceived + chunk.data.size() > maxOffset)
+		{
+			log::warning("IncomingStream: stream " + std::to_string(id) + " received more data than the flow control window allows.");
+			cancel();
+			return;
+		}
+		bytesReceived += chunk.data.size();
+		if (chunkHandler)
+		{
+			chunkHandler(chunk.data.data(), chunk.data.size());
+			consume(chunk.data.size());
+		}
+		else if (!chunk.data.empty())
+		{
+			readableBytes += chunk.data.size();
+			chunks.push_back(std::move(chunk.data));
+			if (readableHandler)
+			{
+				readableHandler();
+			}
+		}
+	}
+
+	void IncomingStream::onEnd(const uint64_t size)
+	{
+		if (canceled || finished)
+		{
+			return;
+		}
+		if (size != bytesReceived)
+		{
+			log::warning("IncomingStream: stream " + std::to_string(id) + " ended at " + std::to_string(size) + " bytes, but " + std::to_string(bytesReceived) + " were received.");
+			cancel();
+			return;
+		}
+		endSize = size;
+		updateFinished();
+	}
+
+	void IncomingStream::consume(const size_t size)
+	{
+		bytesConsumed += size;
+		// Extending the window in steps keeps the number of credit messages low
+		const uint64_t newMaxOffset = bytesConsumed + window;
+		if (!canceled && endSize == unknownStreamSize && newMaxOffset - maxOffset >= std::max(window / 4, size_t(1)))
+		{
+			maxOffset = newMaxOffset;
+			StreamCredit streamCredit;
+			streamCredit.streamId = id;
+			streamCredit.maxOffset = maxOffset;
+			sendMessage(send, streamCredit);
+		}
+		updateFinished();
+	}
+
+	void IncomingStream::updateFinished()
+	{
+		if (!finished && !canceled && endSize != unknownStreamSize && bytesConsumed == endSize)
+		{
+			finished = true;
+			if (endHandler)
+			{
+				endHandler();
+			}
+		}
+	}
+
+	template<typename Stream>
+	std::shared_ptr<Stream> StreamMultiplexer::find(std::unordered_map<uint64_t, std::weak_ptr<Stream>>& streams, const uint64_t streamId)
+	{
+		const typename std::unordered_map<uint64_t, std::weak_ptr<Stream>>::iterator it = streams.find(streamId);
+		if (it == streams.end())
+		{
+			return nullptr;
+		}
+		std::shared_ptr<Stream> stream = it->second.lock();
+		if (!stream)
+		{
+			streams.erase(it);
+		}
+		return stream;
+	}
+
+	StreamMultiplexer::StreamMultiplexer(TypelessMessageRouter& _router, const StreamSendFunction& _sendReliable, const StreamSettings& _settings)
+		: router(_router)
+		, sendReliable(_sendReliable)
+		, settings(_settings)
+	{
+		se_assert(sendReliable);
+		se_assert(settings.chunkSize > 0);
+		se_assert(settings.receiveWindow > 0);
+
+		router.setHandler<StreamOpen>([this](StreamOpen& streamOpen, const bool)
+			{
+				if (find(incomingStreams, streamOpen.streamId))
+				{
+					log::warning("StreamMultiplexer: stream " + std::to_string(streamOpen.streamId) + " is already open.");
+					return;
+				}
+				const std::shared_ptr<IncomingStream> stream = std::make_shared<IncomingStream>(streamOpen.streamId, streamOpen.expectedSize, settings.receiveWindow, sendReliable);
+				incomingStreams[streamOpen.streamId] = stream;
+				stream->open();
+				if (incomingStreamHandler)
+				{
+					incomingStreamHandler(stream);
+				}
+			});
+		router.setHandler<StreamChunk>([this](StreamChunk& streamChunk, const bool)
+			{
+				if (const std::shared_ptr<IncomingStream> stream = find(incomingStreams, streamChunk.streamId))
+				{
+					stream->onChunk(streamChunk);
+				}
+			});
+		router.setHandler<StreamEnd>([this](StreamEnd& streamEnd, const bool)
+			{
+				if (const std::shared_ptr<IncomingStream> stream = find(incomingStreams, streamEnd.streamId))
+				{
+					// Nothing else is sent to a stream after its end
+					incomingStreams.erase(streamEnd.streamId);
+					stream->onEnd(streamEnd.size);
+				}
+			});
+		router.setHandler<StreamCredit>([this](StreamCredit& streamCredit, const bool)
+			{
+				if (const std::shared_ptr<OutgoingStream> stream = find(outgoingStreams, streamCredit.streamId))
+				{
+					stream->onCredit(streamCredit.maxOffset);
+				}
+			});
+		router.setHandler<StreamCancel>([this](StreamCancel& streamCancel, const bool)
+			{
+				if (const std::shared_ptr<OutgoingStream> stream = find(outgoingStreams, streamCancel.streamId))
+				{
+					outgoingStreams.erase(streamCancel.streamId);
+					stream->onCancel();
+				}
+			});
+	}
+
+	StreamMultiplexer::~StreamMultiplexer()
+	{
+		router.removeHandler<StreamOpen>();
+		router.removeHandler<StreamChunk>();
+		router.removeHandler<StreamEnd>();
+		router.removeHandler<StreamCredit>();
+		router.removeHandler<StreamCancel>();
+	}
+
+	std::shared_ptr<OutgoingStream> StreamMultiplexer::openStream(const uint64_t expectedSize)
+	{
+		// Streams that were dropped before the receiver answered are never looked up again
+		for (std::unordered_map<uint64_t, std::weak_ptr<OutgoingStream>>::iterator it = outgoingStreams.begin(); it != outgoingStreams.end();)
+		{
+			it = it->second.expired() ? outgoingStreams.erase(it) : std::next(it);
+		}
+
+		const std::shared_ptr<OutgoingStream> stream = std::make_shared<OutgoingStream>(nextStreamId++, expectedSize, settings.chunkSize, sendReliable);
+		outgoingStreams[stream->getId()] = stream;
+		StreamOpen streamOpen;
+		streamOpen.streamId = stream->getId();
+		streamOpen.expectedSize = expectedSize;
+		sendMessage(sendReliable, streamOpen);
+		return stream;
+	}
+
+	void StreamMultiplexer::setIncomingStreamHandler(const std::function<void(const std::shared_ptr<IncomingStream>&)>& function)
+	{
+		incomingStreamHandler = function;
+	}
+}
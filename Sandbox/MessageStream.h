@@ -0,0 +1,290 @@
+#pragma once
+
+#include "SpehsEngine/Core/WriteBuffer.h"
+#include "SpehsEngine/Core/ReadBuffer.h"
+#include "Sandbox/TypelessMessageRouter.h"
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace se
+{
+	constexpr uint64_t unknownStreamSize = UINT64_MAX;
+
+	// Stream messages exchanged between two StreamMultiplexers, all of them are sent reliably
+	struct StreamOpen
+	{
+		uint64_t streamId = 0;
+		uint64_t expectedSize = unknownStreamSize;
+	};
+
+	struct StreamChunk
+	{
+		// Writes a chunk without copying the data into a StreamChunk first. Must be preceded by the StreamChunk type header.
+		static void write(WriteBuffer& writeBuffer, const uint64_t streamId, const uint64_t offset, const void* const data, const size_t size);
+
+		void write(WriteBuffer& writeBuffer) const;
+		bool read(ReadBuffer& readBuffer);
+
+		uint64_t streamId = 0;
+		uint64_t offset = 0;
+		std::vector<uint8_t> data;
+	};
+
+	struct StreamEnd
+	{
+		uint64_t streamId = 0;
+		uint64_t size = 0;
+	};
+
+	// Receiver to sender: data up to maxOffset may be sent
+	struct StreamCredit
+	{
+		uint64_t streamId = 0;
+		uint64_t maxOffset = 0;
+	};
+
+	// Receiver to sender: the receiver is no longer interested
+	struct StreamCancel
+	{
+		uint64_t streamId = 0;
+	};
+}
+
+SE_TYPELESS_TYPE_NAME(se::StreamOpen, "se::StreamOpen")
+SE_TYPELESS_TYPE_NAME(se::StreamChunk, "se::StreamChunk")
+SE_TYPELESS_TYPE_NAME(se::StreamEnd, "se::StreamEnd")
+SE_TYPELESS_TYPE_NAME(se::StreamCredit, "se::StreamCredit")
+SE_TYPELESS_TYPE_NAME(se::StreamCancel, "se::StreamCancel")
+
+namespace se
+{
+	typedef std::function<void(const WriteBuffer&)> StreamSendFunction; // Must send reliably
+
+	struct StreamSettings
+	{
+		size_t chunkSize = 16 * 1024;
+		size_t receiveWindow = 1024 * 1024;	// Bytes per incoming stream
+	};
+
+	/*
+		Sending end of a stream, opened with StreamMultiplexer::openStream().
+		write() sends right away and accepts only as many bytes as the receiver has granted, 0 means that the write would block.
+		The writable handler is called when the receiver grants more, so nothing needs to be buffered on the sending side either.
+		Destroying an open stream closes it.
+	*/
+	class OutgoingStream
+	{
+	public:
+
+		OutgoingStream(const uint64_t id, const uint64_t expectedSize, const size_t chunkSize, const StreamSendFunction& send);
+		~OutgoingStream();
+
+		OutgoingStream(const OutgoingStream& copy) = delete;
+		void operator=(const OutgoingStream& copy) = delete;
+
+		// Returns the number of bytes accepted
+		size_t write(const void* const data, const size_t size);
+
+		// The receiver sees the end of the stream after the data written so far
+		void close();
+
+		// Called when more bytes become writable and when the stream is canceled
+		void setWritableHandler(const std::function<void()>& function);
+
+		inline uint64_t getWritableBytes() const
+		{
+			return closed || canceled ? 0 : maxOffset - bytesWritten;
+		}
+
+		inline bool isWritable() const
+		{
+			return getWritableBytes() > 0;
+		}
+
+		inline bool isClosed() const
+		{
+			return closed;
+		}
+
+		inline bool isCanceled() const
+		{
+			return canceled;
+		}
+
+		inline uint64_t getId() const
+		{
+			return id;
+		}
+
+		inline uint64_t getExpectedSize() const
+		{
+			return expectedSize;
+		}
+
+		inline uint64_t getBytesWritten() const
+		{
+			return bytesWritten;
+		}
+
+	private:
+
+		friend class StreamMultiplexer;
+
+		void onCredit(const uint64_t maxOffset);
+		void onCancel();
+
+		const uint64_t id;
+		const uint64_t expectedSize;
+		const size_t chunkSize;
+		const StreamSendFunction send;
+		uint64_t bytesWritten = 0;
+		uint64_t maxOffset = 0;
+		bool closed = false;
+		bool canceled = false;
+		std::function<void()> writableHandler;
+	};
+
+	/*
+		Receiving end of a stream, passed to the incoming stream handler of a StreamMultiplexer.
+		Data is either pushed to the chunk handler as it arrives, or buffered for read(). Either way the receiver grants the sender
+		more data only after the previous data has been handled or read, so at most one window of the stream is held in memory.
+		Destroying a stream before it has finished cancels it.
+	*/
+	class IncomingStream
+	{
+	public:
+
+		IncomingStream(const uint64_t id, const uint64_t expectedSize, const size_t window, const StreamSendFunction& send);
+		~IncomingStream();
+
+		IncomingStream(const IncomingStream& copy) = delete;
+		void operator=(const IncomingStream& copy) = delete;
+
+		// Push mode. Buffered data is handed to the new handler right away.
+		void setChunkHandler(const std::function<void(const uint8_t* data, const size_t size)>& function);
+
+		// Pull mode. Called when new data can be read.
+		void setReadableHandler(const std::function<void()>& function);
+		// Returns the number of bytes read
+		size_t read(void* const data, const size_t size);
+
+		// Called once, when the sender has closed the stream and all of the data has been handled or read
+		void setEndHandler(const std::function<void()>& function);
+
+		void cancel();
+
+		inline uint64_t getReadableBytes() const
+		{
+			return readableBytes;
+		}
+
+		inline bool isFinished() const
+		{
+			return finished;
+		}
+
+		inline bool isCanceled() const
+		{
+			return canceled;
+		}
+
+		inline uint64_t getId() const
+		{
+			return id;
+		}
+
+		inline uint64_t getExpectedSize() const
+		{
+			return expectedSize;
+		}
+
+		inline uint64_t getBytesReceived() const
+		{
+			return bytesReceived;
+		}
+
+	private:
+
+		friend class StreamMultiplexer;
+
+		void open();
+		void onChunk(StreamChunk& chunk);
+		void onEnd(const uint64_t size);
+		void consume(const size_t size);
+		void updateFinished();
+
+		const uint64_t id;
+		const uint64_t expectedSize;
+		const size_t window;
+		const StreamSendFunction send;
+		uint64_t bytesReceived = 0;
+		uint64_t bytesConsumed = 0;
+		uint64_t maxOffset = 0;			// Granted to the sender
+		uint64_t endSize = unknownStreamSize;
+		bool finished = false;
+		bool canceled = false;
+		std::deque<std::vector<uint8_t>> chunks;
+		size_t frontChunkOffset = 0;
+		uint64_t readableBytes = 0;
+		std::function<void(const uint8_t*, const size_t)> chunkHandler;
+		std::function<void()> readableHandler;
+		std::function<void()> endHandler;
+	};
+
+	/*
+		Streams of arbitrary size over one reliable connection, for payloads too large to be sent and reassembled as a single packet.
+		Streams are sent in chunks with per stream flow control: the receiver grants a window of bytes and extends it as data is consumed.
+		Stream messages are routed with a TypelessMessageRouter, so the connection can carry other messages as well.
+		Both ends can open streams. Streams keep working if the multiplexer is destroyed, but no longer receive anything.
+		Not thread safe, use from the thread that routes the received messages.
+	*/
+	class StreamMultiplexer
+	{
+	public:
+
+		// Registers the stream message handlers, which are removed again on destruction. The router must outlive the multiplexer.
+		StreamMultiplexer(TypelessMessageRouter& router, const StreamSendFunction& sendReliable, const StreamSettings& settings = StreamSettings());
+
+		template<typename Connection>
+		StreamMultiplexer(TypelessMessageRouter& _router, const std::shared_ptr<Connection>& connection, const StreamSettings& _settings = StreamSettings())
+			: StreamMultiplexer(_router, [weakConnection = std::weak_ptr<Connection>(connection)](const WriteBuffer& writeBuffer)
+				{
+					if (const std::shared_ptr<Connection> lockedConnection = weakConnection.lock())
+					{
+						lockedConnection->sendPacket(writeBuffer, true);
+					}
+				}, _settings)
+		{
+		}
+
+		~StreamMultiplexer();
+
+		StreamMultiplexer(const StreamMultiplexer& copy) = delete;
+		void operator=(const StreamMultiplexer& copy) = delete;
+
+		// Nothing can be written before the receiver has granted the first window, which takes one round trip
+		std::shared_ptr<OutgoingStream> openStream(const uint64_t expectedSize = unknownStreamSize);
+
+		// The handler must keep the stream, streams that nobody holds are canceled
+		void setIncomingStreamHandler(const std::function<void(const std::shared_ptr<IncomingStream>&)>& function);
+
+	private:
+
+		template<typename Stream>
+		static std::shared_ptr<Stream> find(std::unordered_map<uint64_t, std::weak_ptr<Stream>>& streams, const uint64_t streamId);
+
+		TypelessMessageRouter& router;
+		const StreamSendFunction sendReliable;
+		const StreamSettings settings;
+		uint64_t nextStreamId = 0;
+		std::unordered_map<uint64_t, std::weak_ptr<OutgoingStream>> outgoingStreams;
+		std::unordered_map<uint64_t, std::weak_ptr<IncomingStream>> incomingStreams;
+		std::function<void(const std::shared_ptr<IncomingStream>&)> incomingStreamHandler;
+	};
+}
@@ -0,0 +1,100 @@
+#include "stdafx.h"
+#include "Sandbox/PayloadVerification.h"
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SE_VERIFY_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SE_VERIFY_SSE2
+#endif
+
+
+namespace se
+{
+	size_t findSequenceMismatch(const void* const data, const size_t count, const uint64_t first)
+	{
+		const uint8_t* const bytes = (const uint8_t*)data;
+		size_t i = 0;
+#if defined(SE_VERIFY_AVX2)
+		__m256i expected = _mm256_add_epi64(_mm256_set1_epi64x(int64_t(first)), _mm256_setr_epi64x(0, 1, 2, 3));
+		const __m256i step = _mm256_set1_epi64x(4);
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m256i vector = _mm256_loadu_si256((const __m256i*)(bytes + i * sizeof(uint64_t)));
+			if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(vector, expected)) != -1)
+			{
+				// The scalar loop below finds the exact element
+				break;
+			}
+			expected = _mm256_add_epi64(expected, step);
+		}
+#elif defined(SE_VERIFY_SSE2)
+		// SSE2 has no 64 bit compare, but two 64 bit values are equal when all of their 32 bit halves are
+		__m128i expected = _mm_add_epi64(_mm_set1_epi64x(int64_t(first)), _mm_set_epi64x(1, 0));
+		const __m128i step = _mm_set1_epi64x(2);
+		for (; i + 2 <= count; i += 2)
+		{
+			const __m128i vector = _mm_loadu_si128((const __m128i*)(bytes + i * sizeof(uint64_t)));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(vector, expected)) != 0xffff)
+			{
+				break;
+			}
+			expected = _mm_add_epi64(expected, step);
+		}
+#endif
+		for (; i < count; i++)
+		{
+			uint64_t value;
+			memcpy(&value, bytes + i * sizeof(uint64_t), sizeof(uint64_t));
+			if (value != first + i)
+			{
+				return i;
+			}
+		}
+		return count;
+	}
+
+	size_t findByteSequenceMismatch(const void* const data, const size_t count, const uint8_t first)
+	{
+		const uint8_t* const bytes = (const uint8_t*)data;
+		size_t i = 0;
+#if defined(SE_VERIFY_AVX2)
+		__m256i expected = _mm256_add_epi8(_mm256_set1_epi8(char(first)), _mm256_setr_epi8(
+			0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+			16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31));
+		const __m256i step = _mm256_set1_epi8(32);
+		for (; i + 32 <= count; i += 32)
+		{
+			const __m256i vector = _mm256_loadu_si256((const __m256i*)(bytes + i));
+			if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(vector, expected)) != -1)
+			{
+				break;
+			}
+			expected = _mm256_add_epi8(expected, step);
+		}
+#elif defined(SE_VERIFY_SSE2)
+		__m128i expected = _mm_add_epi8(_mm_set1_epi8(char(first)), _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+		const __m128i step = _mm_set1_epi8(16);
+		for (; i + 16 <= count; i += 16)
+		{
+			const __m128i vector = _mm_loadu_si128((const __m128i*)(bytes + i));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(vector, expected)) != 0xffff)
+			{
+				break;
+			}
+			expected = _mm_add_epi8(expected, step);
+		}
+#endif
+		for (; i < count; i++)
+		{
+			if (bytes[i] != uint8_t(first + i))
+			{
+				return i;
+			}
+		}
+		return count;
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace se
+{
+	/*
+		Bulk checks for test payloads that contain a running sequence.
+		The data does not need to be aligned, so packets can be verified in place inside a receive buffer. Uses SIMD compares where available.
+		Return the index of the first element that breaks the sequence, or count if the whole sequence matches.
+	*/
+
+	// Elements are host byte order uint64_t values first, first + 1, ...
+	size_t findSequenceMismatch(const void* const data, const size_t count, const uint64_t first);
+
+	// Elements are bytes first, first + 1, ... wrapping around at 256
+	size_t findByteSequenceMismatch(const void* const data, const size_t count, const uint8_t first);
+}
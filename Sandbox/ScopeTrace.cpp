@@ -0,0 +1,202 @@
+#include "stdafx.h"
+#include "Sandbox/ScopeTrace.h"
+
+#include "SpehsEngine/Core/StringUtilityFunctions.h"
+#include "Sandbox/JsonUtilityFunctions.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+
+namespace se
+{
+	namespace
+	{
+		// Single producer single consumer ring, the owning thread records and collect() consumes
+		struct Ring
+		{
+			Ring(const uint32_t _threadIndex)
+				: threadIndex(_threadIndex)
+				, events(ScopeTrace::ringCapacity)
+			{
+			}
+
+			const uint32_t threadIndex;
+			std::vector<ScopeTraceEvent> events;
+			std::atomic<uint64_t> head = 0;	// Written by the owning thread
+			std::atomic<uint64_t> tail = 0;	// Written by the consumer
+			std::atomic<bool> threadExited = false;
+		};
+
+		static_assert((ScopeTrace::ringCapacity & (ScopeTrace::ringCapacity - 1)) == 0, "Ring capacity must be a power of two.");
+
+		std::mutex ringsMutex;
+		std::vector<std::shared_ptr<Ring>> rings;
+		uint32_t nextThreadIndex = 0;
+		std::atomic<uint64_t> droppedCount = 0;
+
+		// Keeps the ring of a thread registered until it has been collected
+		struct ThreadRing
+		{
+			~ThreadRing()
+			{
+				if (ring)
+				{
+					ring->threadExited.store(true, std::memory_order_release);
+				}
+			}
+
+			Ring& get()
+			{
+				if (!ring)
+				{
+					std::lock_guard<std::mutex> lock(ringsMutex);
+					ring = std::make_shared<Ring>(nextThreadIndex++);
+					rings.push_back(ring);
+				}
+				return *ring;
+			}
+
+			std::shared_ptr<Ring> ring;
+		};
+		thread_local ThreadRing threadRing;
+
+		void appendArgument(std::string& output, const ScopeTraceArgument& argument)
+		{
+			switch (argument.type)
+			{
+			case ScopeTraceArgument::Type::Int: output += std::to_string(argument.intValue); break;
+			case ScopeTraceArgument::Type::Uint: output += std::to_string(argument.uintValue); break;
+			case ScopeTraceArgument::Type::Double: output += formatString("%g", argument.doubleValue); break;
+			}
+		}
+	}
+
+	std::atomic<bool> ScopeTrace::enabled = false;
+
+	void ScopeTrace::setEnabled(const bool _enabled)
+	{
+		enabled.store(_enabled, std::memory_order_relaxed);
+	}
+
+	void ScopeTrace::record(const ScopeTraceEvent& event)
+	{
+		Ring& ring = threadRing.get();
+		const uint64_t head = ring.head.load(std::memory_order_relaxed);
+		if (head - ring.tail.load(std::memory_order_acquire) >= ringCapacity)
+		{
+			droppedCount.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		ScopeTraceEvent& slot = ring.events[size_t(head & (ringCapacity - 1))];
+		slot = event;
+		slot.threadIndex = ring.threadIndex;
+		ring.head.store(head + 1, std::memory_order_release);
+	}
+
+	void ScopeTrace::collect(std::vector<ScopeTraceEvent>& events)
+	{
+		std::lock_guard<std::mutex> lock(ringsMutex);
+		for (size_t i = 0; i < rings.size(); i++)
+		{
+			Ring& ring = *rings[i];
+			// Read the exit flag first, events recorded before the thread exited are then guaranteed to be visible
+			const bool threadExited = ring.threadExited.load(std::memory_order_acquire);
+			const uint64_t head = ring.head.load(std::memory_order_acquire);
+			const uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+			for (uint64_t index = tail; index < head; index++)
+			{
+				events.push_back(ring.events[size_t(index & (ringCapacity - 1))]);
+			}
+			ring.tail.store(head, std::memory_order_release);
+			if (threadExited)
+			{
+				rings[i] = std::move(rings.back());
+				rings.pop_back();
+				i--;
+			}
+		}
+	}
+
+	uint64_t ScopeTrace::getDroppedCount()
+	{
+		return droppedCount.load(std::memory_order_relaxed);
+	}
+
+	std::string ScopeTrace::format(const ScopeTraceEvent& event)
+	{
+		std::string output;
+		size_t argumentIndex = 0;
+		for (const char* c = event.label; *c; c++)
+		{
+			if (c[0] == '{' && c[1] == '}' && argumentIndex < event.argumentCount)
+			{
+				appendArgument(output, event.arguments[argumentIndex++]);
+				c++;
+			}
+			else
+			{
+				output += *c;
+			}
+		}
+		for (; argumentIndex < event.argumentCount; argumentIndex++)
+		{
+			output += argumentIndex ? ", " : " ";
+			appendArgument(output, event.arguments[argumentIndex]);
+		}
+		return output;
+	}
+
+	void ScopeTrace::writeChromeTraceEvents(std::string& output, const std::vector<ScopeTraceEvent>& events)
+	{
+		for (const ScopeTraceEvent& event : events)
+		{
+			output += formatString("{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+				escapeJson(event.label).c_str(), unsigned(event.threadIndex), double(event.begin) / 1000.0, double(event.end - event.begin) / 1000.0);
+			for (size_t i = 0; i < event.argumentCount; i++)
+			{
+				output += formatString("%s\"%zu\":", i ? "," : "", i);
+				if (event.arguments[i].type == ScopeTraceArgument::Type::Double)
+				{
+					output += formatJsonNumber(event.arguments[i].doubleValue);
+				}
+				else
+				{
+					appendArgument(output, event.arguments[i]);
+				}
+			}
+			output += "}},\n";
+		}
+	}
+
+	bool ScopeTrace::appendChromeTraceFile(const std::string& path)
+	{
+		std::vector<ScopeTraceEvent> events;
+		collect(events);
+		if (events.empty())
+		{
+			return true;
+		}
+		std::string output;
+		std::error_code error;
+		if (!std::filesystem::exists(path, error))
+		{
+			output += "[\n";
+		}
+		writeChromeTraceEvents(output, events);
+		std::ofstream file(path, std::ios::binary | std::ios::app);
+		if (!file.write(output.data(), std::streamsize(output.size())))
+		{
+			log::warning("Failed to write scope trace: " + path);
+			return false;
+		}
+		return true;
+	}
+
+	int64_t ScopedTrace::now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
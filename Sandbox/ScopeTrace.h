@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace se
+{
+	struct ScopeTraceArgument
+	{
+		enum class Type : uint8_t
+		{
+			Int,
+			Uint,
+			Double,
+		};
+
+		Type type = Type::Int;
+		union
+		{
+			int64_t intValue = 0;
+			uint64_t uintValue;
+			double doubleValue;
+		};
+	};
+
+	struct ScopeTraceEvent
+	{
+		static constexpr size_t maxArgumentCount = 4;
+
+		const char* label = nullptr;	// Static string, "{}" marks where arguments are placed when formatting
+		uint32_t threadIndex = 0;
+		uint8_t argumentCount = 0;
+		int64_t begin = 0;				// Steady clock nanoseconds
+		int64_t end = 0;
+		ScopeTraceArgument arguments[maxArgumentCount];
+	};
+
+	/*
+		Low overhead scope tracing for hot paths, an alternative to SE_SCOPE_PROFILER with dynamically built labels.
+		Labels are string literals, so a label is recorded as a pointer. Numeric arguments are recorded as typed values.
+		Each thread records into its own fixed size ring buffer and nothing is formatted or allocated until the events are collected.
+		Recording costs two clock reads and a copy into the ring. When the ring is full new events are dropped and counted.
+		Tracing is disabled by default, a disabled scope costs one relaxed atomic load.
+	*/
+	class ScopeTrace
+	{
+	public:
+
+		static constexpr size_t ringCapacity = 4096; // Events per thread, power of two
+
+		static void setEnabled(const bool enabled);
+		static inline bool isEnabled()
+		{
+			return enabled.load(std::memory_order_relaxed);
+		}
+
+		// Thread safe. Moves the recorded events of all threads into events, oldest first per thread.
+		static void collect(std::vector<ScopeTraceEvent>& events);
+
+		// Events dropped because a ring was full
+		static uint64_t getDroppedCount();
+
+		// Label with the "{}" placeholders replaced by the arguments, remaining arguments are appended
+		static std::string format(const ScopeTraceEvent& event);
+
+		// Chrome trace event format (chrome://tracing, Perfetto). Each event is followed by a comma, which the JSON array format allows.
+		static void writeChromeTraceEvents(std::string& output, const std::vector<ScopeTraceEvent>& events);
+		// Collects and appends to a JSON array format trace file, the file is started if it does not exist
+		static bool appendChromeTraceFile(const std::string& path);
+
+		static void record(const ScopeTraceEvent& event);
+
+	private:
+
+		static std::atomic<bool> enabled;
+	};
+
+	class ScopedTrace
+	{
+	public:
+
+		template<size_t Size, typename... Arguments>
+		ScopedTrace(const char(&label)[Size], const Arguments... arguments)
+		{
+			static_assert(sizeof...(Arguments) <= ScopeTraceEvent::maxArgumentCount, "Too many scope trace arguments.");
+			static_assert((std::is_arithmetic<Arguments>::value && ...), "Scope trace arguments must be numbers.");
+			if (ScopeTrace::isEnabled())
+			{
+				event.label = label;
+				(addArgument(arguments), ...);
+				event.begin = now();
+			}
+		}
+
+		~ScopedTrace()
+		{
+			if (event.label)
+			{
+				event.end = now();
+				ScopeTrace::record(event);
+			}
+		}
+
+		ScopedTrace(const ScopedTrace& copy) = delete;
+		void operator=(const ScopedTrace& copy) = delete;
+
+	private:
+
+		static int64_t now();
+
+		template<typename T>
+		void addArgument(const T value)
+		{
+			ScopeTraceArgument& argument = event.arguments[event.argumentCount++];
+			if constexpr (std::is_floating_point<T>::value)
+			{
+				argument.type = ScopeTraceArgument::Type::Double;
+				argument.doubleValue = double(value);
+			}
+			else if constexpr (std::is_signed<T>::value)
+			{
+				argument.type = ScopeTraceArgument::Type::Int;
+				argument.intValue = int64_t(value);
+			}
+			else
+			{
+				argument.type = ScopeTraceArgument::Type::Uint;
+				argument.uintValue = uint64_t(value);
+			}
+		}
+
+		ScopeTraceEvent event;
+	};
+}
+
+#define SE_SCOPE_TRACE_CONCAT_IMPL(p_A, p_B) p_A##p_B
+#define SE_SCOPE_TRACE_CONCAT(p_A, p_B) SE_SCOPE_TRACE_CONCAT_IMPL(p_A, p_B)
+// Usage: SE_SCOPE_TRACE("Receive packet, size: {}", readBuffer.getSize());
+#define SE_SCOPE_TRACE(...) const se::ScopedTrace SE_SCOPE_TRACE_CONCAT(scopedTrace, __LINE__)(__VA_ARGS__)
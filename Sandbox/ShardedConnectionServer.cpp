@@ -0,0 +1,326 @@
+#include "stdafx.h"
+#include "Sandbox/ShardedConnectionServer.h"
+
+#include "SpehsEngine/Core/StringUtilityFunctions.h"
+#include <algorithm>
+
+
+namespace se
+{
+	ShardedConnectionServer::ShardedConnectionServer(const Settings& _settings, const IncomingConnectionHandler& _incomingConnectionHandler, const DisconnectHandler& _disconnectHandler)
+		: settings(_settings)
+		, incomingConnectionHandler(_incomingConnectionHandler)
+		, disconnectHandler(_disconnectHandler)
+	{
+		const size_t shardCount = settings.shardCount ? settings.shardCount : std::max(1u, std::thread::hardware_concurrency());
+		for (size_t i = 0; i < shardCount; i++)
+		{
+			shards.push_back(std::make_unique<Shard>());
+			shards.back()->index = i;
+		}
+	}
+
+	ShardedConnectionServer::~ShardedConnectionServer()
+	{
+		stop();
+	}
+
+	std::shared_ptr<net::Connection2> ShardedConnectionServer::connect(net::ConnectionManager2& connectionManager, const net::Address& address, const uint16_t port,
+		const std::chrono::steady_clock::duration timeout)
+	{
+		const std::shared_ptr<net::Connection2> directoryConnection = connectionManager.connect(net::Endpoint(address, net::Port(port)));
+		if (!directoryConnection)
+		{
+			return nullptr;
+		}
+
+		uint16_t shardPort = 0;
+		UpdateLoop updateLoop([&connectionManager]() { connectionManager.update(); });
+		directoryConnection->setReceiveHandler([&updateLoop, &shardPort](ReadBuffer& readBuffer, const bool)
+			{
+				updateLoop.notifyActivity();
+				uint16_t shardCount = 0;
+				uint16_t firstShardPort = 0;
+				uint16_t shardIndex = 0;
+				if (readBuffer.read(shardCount) && readBuffer.read(firstShardPort) && readBuffer.read(shardIndex) && shardIndex < shardCount)
+				{
+					shardPort = uint16_t(firstShardPort + shardIndex);
+				}
+			});
+		const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+		while (shardPort == 0)
+		{
+			const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			if (now >= deadline)
+			{
+				log::warning("ShardedConnectionServer: no shard assignment from the directory at port " + std::to_string(port) + ".");
+				break;
+			}
+			updateLoop.waitAndUpdate(deadline - now);
+		}
+		// The handler refers to locals, and the connection manager may still hold the directory connection
+		directoryConnection->setReceiveHandler([](ReadBuffer&, const bool) {});
+
+		if (shardPort == 0)
+		{
+			return nullptr;
+		}
+		return connectionManager.connect(net::Endpoint(address, net::Port(shardPort)));
+	}
+
+	void ShardedConnectionServer::start()
+	{
+		if (started)
+		{
+			return;
+		}
+		started = true;
+		for (const std::unique_ptr<Shard>& shard : shards)
+		{
+			shard->thread = std::thread([this, &shard = *shard]() { runShard(shard); });
+		}
+	}
+
+	void ShardedConnectionServer::stop()
+	{
+		if (!started)
+		{
+			return;
+		}
+		// The update loop only exists while its thread runs, so stopping goes through the task queue
+		postToAll([](Shard& shard) { shard.updateLoop->stop(); });
+		for (const std::unique_ptr<Shard>& shard : shards)
+		{
+			shard->thread.join();
+		}
+		started = false;
+	}
+
+	void ShardedConnectionServer::post(const size_t shardIndex, const std::function<void(Shard&)>& task)
+	{
+		se_assert(shardIndex < shards.size());
+		Shard& shard = *shards[shardIndex];
+		{
+			std::lock_guard<std::mutex> lock(shard.taskMutex);
+			shard.tasks.push_back(task);
+			if (shard.updateLoop)
+			{
+				shard.updateLoop->wakeUp();
+			}
+		}
+	}
+
+	void ShardedConnectionServer::postToAll(const std::function<void(Shard&)>& task)
+	{
+		for (size_t i = 0; i < shards.size(); i++)
+		{
+			post(i, task);
+		}
+	}
+
+	bool ShardedConnectionServer::post(const net::Connection2* const connection, const std::function<void(Shard&)>& task)
+	{
+		const size_t shardIndex = getShardIndex(connection);
+		if (shardIndex < shards.size())
+		{
+			post(shardIndex, task);
+			return true;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	size_t ShardedConnectionServer::getShardIndex(const net::Connection2* const connection) const
+	{
+		std::shared_lock<std::shared_mutex> lock(connectionShardsMutex);
+		const std::unordered_map<const net::Connection2*, size_t>::const_iterator it = connectionShards.find(connection);
+		return it != connectionShards.end() ? it->second : shards.size();
+	}
+
+	void ShardedConnectionServer::runShard(Shard& shard)
+	{
+		shard.connectionManager = std::make_unique<net::ConnectionManager2>(settings.name + " shard " + std::to_string(shard.index));
+		{
+			// post() may wake the loop up from another thread as soon as it exists
+			std::lock_guard<std::mutex> lock(shard.taskMutex);
+			shard.updateLoop = std::make_unique<UpdateLoop>([this, &shard]() { updateShard(shard); });
+		}
+		shard.connectionManager->connectToIncomingConnectionSignal(shard.incomingConnection, [this, &shard](std::shared_ptr<net::Connection2>& connection)
+			{
+				{
+					std::unique_lock<std::shared_mutex> lock(connectionShardsMutex);
+					connectionShards[connection.get()] = shard.index;
+				}
+				shard.connections.push_back(connection);
+				shard.connectDeadlines.push_back(std::chrono::steady_clock::now() + settings.connectTimeout);
+				shard.connectionCount++;
+				shard.updateLoop->notifyActivity();
+				if (incomingConnectionHandler)
+				{
+					incomingConnectionHandler(shard, connection);
+				}
+			});
+		shard.connectionManager->startListening(uint16_t(settings.port + 1 + shard.index));
+		if (shard.index == 0)
+		{
+			directoryConnectionManager = std::make_unique<net::ConnectionManager2>(settings.name + " directory");
+			directoryConnectionManager->connectToIncomingConnectionSignal(directoryIncomingConnection, [this, &shard](std::shared_ptr<net::Connection2>& connection)
+				{
+					directoryConnections.push_back(DirectoryConnection{ connection, std::chrono::steady_clock::now() + settings.connectTimeout });
+					shard.updateLoop->notifyActivity();
+				});
+			directoryConnectionManager->startListening(settings.port);
+		}
+
+		shard.updateLoop->run();
+
+		// Release everything on the owning thread
+		if (shard.index == 0)
+		{
+			directoryIncomingConnection.disconnect();
+			directoryConnections.clear();
+			directoryConnectionManager.reset();
+		}
+		{
+			std::unique_lock<std::shared_mutex> lock(connectionShardsMutex);
+			for (const std::shared_ptr<net::Connection2>& connection : shard.connections)
+			{
+				connectionShards.erase(connection.get());
+			}
+		}
+		shard.incomingConnection.disconnect();
+		shard.connectDeadlines.clear();
+		shard.connections.clear();
+		shard.connectionManager.reset();
+		std::lock_guard<std::mutex> lock(shard.taskMutex);
+		shard.tasks.clear();
+		shard.updateLoop.reset();
+	}
+
+	void ShardedConnectionServer::Shard::setReceiveHandler(net::Connection2& connection, const std::function<void(ReadBuffer&, const bool)>& receiveHandler)
+	{
+		connection.setReceiveHandler([this, receiveHandler](ReadBuffer& readBuffer, const bool reliable)
+			{
+				updateLoop->notifyActivity();
+				if (receiveHandler)
+				{
+					receiveHandler(readBuffer, reliable);
+				}
+			});
+	}
+
+	void ShardedConnectionServer::updateShard(Shard& shard)
+	{
+		{
+			std::lock_guard<std::mutex> lock(shard.taskMutex);
+			std::swap(shard.tasks, shard.runningTasks);
+		}
+		for (const std::function<void(Shard&)>& task : shard.runningTasks)
+		{
+			task(shard);
+			shard.updateLoop->notifyActivity();
+		}
+		shard.runningTasks.clear();
+
+		shard.connectionManager->update();
+		if (shard.index == 0)
+		{
+			updateDirectory(shard);
+		}
+
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < shard.connections.size(); i++)
+		{
+			if (shard.connections[i]->isConnected())
+			{
+				shard.connectDeadlines[i] = std::chrono::steady_clock::time_point::max();
+				continue;
+			}
+			// Connection2 can't tell a connection that is still connecting from one that has failed to connect, so the handshake is given a deadline
+			if (shard.connectDeadlines[i] != std::chrono::steady_clock::time_point::max())
+			{
+				if (now < shard.connectDeadlines[i])
+				{
+					continue;
+				}
+				log::warning(settings.name + ": connection timed out while connecting.");
+			}
+
+			std::shared_ptr<net::Connection2> connection = shard.connections[i];
+			{
+				std::unique_lock<std::shared_mutex> lock(connectionShardsMutex);
+				connectionShards.erase(connection.get());
+			}
+			shard.connections[i] = std::move(shard.connections.back());
+			shard.connections.pop_back();
+			shard.connectDeadlines[i] = shard.connectDeadlines.back();
+			shard.connectDeadlines.pop_back();
+			shard.connectionCount--;
+			i--;
+			if (disconnectHandler)
+			{
+				disconnectHandler(shard, connection);
+			}
+		}
+	}
+
+	void ShardedConnectionServer::updateDirectory(Shard& shard)
+	{
+		directoryConnectionManager->update();
+
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < directoryConnections.size(); i++)
+		{
+			DirectoryConnection& directoryConnection = directoryConnections[i];
+			if (directoryConnection.connection->isConnected())
+			{
+				if (!directoryConnection.answered)
+				{
+					WriteBuffer writeBuffer;
+					writeBuffer.write(uint16_t(shards.size()));
+					writeBuffer.write(uint16_t(settings.port + 1));
+					writeBuffer.write(uint16_t(pickShard()));
+					directoryConnection.connection->sendPacket(writeBuffer, true);
+					directoryConnection.answered = true;
+					// Leave the client time to receive the answer and disconnect
+					directoryConnection.deadline = now + settings.connectTimeout;
+					shard.updateLoop->notifyActivity();
+				}
+				if (now < directoryConnection.deadline)
+				{
+					continue;
+				}
+			}
+			else if (!directoryConnection.answered)
+			{
+				if (now < directoryConnection.deadline)
+				{
+					continue;
+				}
+				log::warning(settings.name + ": directory connection timed out while connecting.");
+			}
+
+			directoryConnections[i] = std::move(directoryConnections.back());
+			directoryConnections.pop_back();
+			i--;
+		}
+	}
+
+	size_t ShardedConnectionServer::pickShard()
+	{
+		// Fewest connections. Ties go round robin, so that a burst of clients spreads out before their shard connections arrive.
+		size_t shardIndex = nextShardIndex % shards.size();
+		for (size_t i = 1; i < shards.size(); i++)
+		{
+			const size_t candidate = (nextShardIndex + i) % shards.size();
+			if (shards[candidate]->connectionCount < shards[shardIndex]->connectionCount)
+			{
+				shardIndex = candidate;
+			}
+		}
+		nextShardIndex = shardIndex + 1;
+		return shardIndex;
+	}
+}
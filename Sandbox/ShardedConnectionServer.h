@@ -0,0 +1,151 @@
+#pragma once
+
+#include "SpehsEngine/Net/ConnectionManager2.h"
+#include "Sandbox/UpdateLoop.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+
+namespace se
+{
+	/*
+		Spreads server connections over worker threads. Each shard owns a ConnectionManager2, its connections and an UpdateLoop on its own thread.
+		ConnectionManager2 does not expose its socket, so shards cannot share one port with SO_REUSEPORT or take over connections accepted on another port.
+		Instead shard i listens on port + 1 + i, and a directory on the well-known port tells each client the shard count, the shard ports and which shard to use.
+		The directory assigns the shard with the fewest connections, so clients only need to know the directory port and connect with connect().
+		The directory runs on the thread of shard 0.
+		Connections and their managers must only be touched from the owning shard's thread. Use post() to run work there from other threads.
+	*/
+	class ShardedConnectionServer
+	{
+	public:
+
+		class Shard
+		{
+		public:
+
+			inline size_t getIndex() const
+			{
+				return index;
+			}
+
+			inline net::ConnectionManager2& getConnectionManager()
+			{
+				return *connectionManager;
+			}
+
+			inline UpdateLoop& getUpdateLoop()
+			{
+				return *updateLoop;
+			}
+
+			inline const std::vector<std::shared_ptr<net::Connection2>>& getConnections() const
+			{
+				return connections;
+			}
+
+			// Use instead of Connection2::setReceiveHandler(). Received packets count as activity, so the update loop keeps polling while traffic flows.
+			void setReceiveHandler(net::Connection2& connection, const std::function<void(ReadBuffer&, const bool)>& receiveHandler);
+
+		private:
+
+			friend class ShardedConnectionServer;
+
+			size_t index = 0;
+			std::unique_ptr<net::ConnectionManager2> connectionManager;
+			std::unique_ptr<UpdateLoop> updateLoop;
+			std::vector<std::shared_ptr<net::Connection2>> connections;
+			std::vector<std::chrono::steady_clock::time_point> connectDeadlines; // Parallel to connections, time_point::max() once connected
+			std::atomic<size_t> connectionCount = 0; // Read by the directory
+			boost::signals2::scoped_connection incomingConnection;
+
+			std::mutex taskMutex;
+			std::vector<std::function<void(Shard&)>> tasks;
+			std::vector<std::function<void(Shard&)>> runningTasks;
+			std::thread thread;
+		};
+
+		struct Settings
+		{
+			std::string name = "server";
+			uint16_t port = 41623; // Directory port, shard i listens on port + 1 + i
+			size_t shardCount = 0; // 0 uses the hardware thread count
+			std::chrono::steady_clock::duration connectTimeout = std::chrono::seconds(10); // Connections that have not connected by then are dropped
+		};
+
+		// Called on the shard thread that accepted the connection
+		typedef std::function<void(Shard& shard, std::shared_ptr<net::Connection2>& connection)> IncomingConnectionHandler;
+		// Called on the shard thread after a connection has disconnected or timed out while connecting, and was removed from its shard
+		typedef std::function<void(Shard& shard, std::shared_ptr<net::Connection2>& connection)> DisconnectHandler;
+
+		ShardedConnectionServer(const Settings& settings, const IncomingConnectionHandler& incomingConnectionHandler, const DisconnectHandler& disconnectHandler = DisconnectHandler());
+		~ShardedConnectionServer();
+
+		ShardedConnectionServer(const ShardedConnectionServer& copy) = delete;
+		void operator=(const ShardedConnectionServer& copy) = delete;
+
+		/*
+			Client side. Asks the directory at address:port for a shard and connects to the assigned shard port.
+			Updates the connection manager until the directory answers or the timeout expires. Returns null on failure.
+		*/
+		static std::shared_ptr<net::Connection2> connect(net::ConnectionManager2& connectionManager, const net::Address& address, const uint16_t port,
+			const std::chrono::steady_clock::duration timeout = std::chrono::seconds(10));
+
+		void start();
+		// Stops and joins all shard threads. Connections are released on their own threads.
+		void stop();
+
+		inline size_t getShardCount() const
+		{
+			return shards.size();
+		}
+
+		// Thread safe. The task runs on the shard thread during its next update.
+		void post(const size_t shardIndex, const std::function<void(Shard&)>& task);
+		void postToAll(const std::function<void(Shard&)>& task);
+
+		// Thread safe. Returns false if the connection is not owned by any shard.
+		bool post(const net::Connection2* const connection, const std::function<void(Shard&)>& task);
+
+		// Thread safe. Returns the number of shards if the connection is not owned by any shard.
+		size_t getShardIndex(const net::Connection2* const connection) const;
+
+	private:
+
+		struct DirectoryConnection
+		{
+			std::shared_ptr<net::Connection2> connection;
+			std::chrono::steady_clock::time_point deadline;
+			bool answered = false;
+		};
+
+		void runShard(Shard& shard);
+		void updateShard(Shard& shard);
+		void updateDirectory(Shard& shard);
+		size_t pickShard();
+
+		const Settings settings;
+		const IncomingConnectionHandler incomingConnectionHandler;
+		const DisconnectHandler disconnectHandler;
+		std::vector<std::unique_ptr<Shard>> shards;
+		bool started = false;
+
+		mutable std::shared_mutex connectionShardsMutex;
+		std::unordered_map<const net::Connection2*, size_t> connectionShards;
+
+		// Directory, only touched from the thread of shard 0
+		std::unique_ptr<net::ConnectionManager2> directoryConnectionManager;
+		boost::signals2::scoped_connection directoryIncomingConnection;
+		std::vector<DirectoryConnection> directoryConnections;
+		size_t nextShardIndex = 0;
+	};
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "Sandbox/TypelessPointer.h"
+#include <atomic>
+#include <stddef.h>
+
+
+namespace se
+{
+	class WriteBuffer;
+	class TypelessTypeDictionary;
+
+	/*
+		Reference counted, copy-on-write TypelessPointer.
+		Copies share one immutable object, which makes fanning out a single payload to many consumers free of allocations and copies.
+		getMutable() detaches from other owners by cloning the object first, if it is shared.
+		Reference counting is thread safe, the shared object must not be modified while shared.
+	*/
+	class SharedTypelessPointer
+	{
+	public:
+
+		SharedTypelessPointer() = default;
+
+		template<typename T>
+		SharedTypelessPointer(T* t)
+			: SharedTypelessPointer(TypelessPointer(t))
+		{
+		}
+
+		SharedTypelessPointer(TypelessPointer&& typelessPointer)
+		{
+			if (typelessPointer)
+			{
+				controlBlock = new ControlBlock();
+				controlBlock->typelessPointer = std::move(typelessPointer);
+			}
+		}
+
+		~SharedTypelessPointer()
+		{
+			reset();
+		}
+
+		SharedTypelessPointer(const SharedTypelessPointer& copy)
+			: controlBlock(copy.controlBlock)
+		{
+			if (controlBlock)
+			{
+				controlBlock->useCount.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		SharedTypelessPointer(SharedTypelessPointer&& move)
+		{
+			swap(move);
+		}
+
+		void operator=(const SharedTypelessPointer& copy)
+		{
+			SharedTypelessPointer temp(copy);
+			swap(temp);
+		}
+
+		void operator=(SharedTypelessPointer&& move)
+		{
+			swap(move);
+		}
+
+		template<typename T, typename... Args>
+		static SharedTypelessPointer make(Args&&... args)
+		{
+			return SharedTypelessPointer(new T(std::forward<Args>(args)...));
+		}
+
+		inline explicit operator bool() const
+		{
+			return controlBlock != nullptr;
+		}
+
+		inline bool hasValue() const
+		{
+			return controlBlock != nullptr;
+		}
+
+		void reset()
+		{
+			if (controlBlock)
+			{
+				if (controlBlock->useCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					delete controlBlock;
+				}
+				controlBlock = nullptr;
+			}
+		}
+
+		inline void swap(SharedTypelessPointer& other)
+		{
+			std::swap(controlBlock, other.controlBlock);
+		}
+
+		template<typename T>
+		inline const T* get() const
+		{
+			return controlBlock ? static_cast<const TypelessPointer&>(controlBlock->typelessPointer).get<T>() : nullptr;
+		}
+
+		// Clones the object first if it is shared. Returns nullptr if the type doesn't match or if a shared object cannot be cloned.
+		template<typename T>
+		T* getMutable()
+		{
+			if (!get<T>() || !detach())
+			{
+				return nullptr;
+			}
+			return controlBlock->typelessPointer.get<T>();
+		}
+
+		inline size_t getUseCount() const
+		{
+			return controlBlock ? controlBlock->useCount.load(std::memory_order_relaxed) : 0;
+		}
+
+		inline const TypelessTypeInfo* getTypeInfo() const
+		{
+			return controlBlock ? controlBlock->typelessPointer.getTypeInfo() : nullptr;
+		}
+
+		void write(WriteBuffer& writeBuffer) const
+		{
+			if (controlBlock)
+			{
+				controlBlock->typelessPointer.write(writeBuffer);
+			}
+			else
+			{
+				TypelessPointer().write(writeBuffer);
+			}
+		}
+
+		void write(WriteBuffer& writeBuffer, const TypelessTypeDictionary& dictionary) const
+		{
+			if (controlBlock)
+			{
+				controlBlock->typelessPointer.write(writeBuffer, dictionary);
+			}
+			else
+			{
+				TypelessPointer().write(writeBuffer, dictionary);
+			}
+		}
+
+	private:
+
+		struct ControlBlock
+		{
+			std::atomic<size_t> useCount = 1;
+			TypelessPointer typelessPointer;
+		};
+
+		// Makes sure that this is the only owner of the object
+		bool detach()
+		{
+			if (controlBlock->useCount.load(std::memory_order_acquire) == 1)
+			{
+				return true;
+			}
+			TypelessPointer copy = controlBlock->typelessPointer.clone();
+			if (!copy)
+			{
+				return false;
+			}
+			*this = SharedTypelessPointer(std::move(copy));
+			return true;
+		}
+
+		ControlBlock* controlBlock = nullptr;
+	};
+}
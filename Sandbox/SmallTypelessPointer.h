@@ -0,0 +1,306 @@
+#pragma once
+
+#include "Sandbox/TypelessTypeInfo.h"
+#include "Sandbox/TypelessTypeDictionary.h"
+#include <stddef.h>
+
+
+namespace se
+{
+	class WriteBuffer;
+	class ReadBuffer;
+
+	/*
+		TypelessPointer with a small inline buffer.
+		Types that fit in InlineBytes and are nothrow move constructible are stored in place, everything else falls back to the heap.
+		Because an inline object lives inside the pointer, moving the pointer moves the object.
+	*/
+	template<size_t InlineBytes = 32>
+	class SmallTypelessPointer
+	{
+	public:
+
+		static_assert(InlineBytes > 0, "Use TypelessPointer for heap only storage.");
+
+		static constexpr size_t inlineBytes = InlineBytes;
+		static constexpr size_t inlineAlignment = alignof(std::max_align_t);
+
+		template<typename T>
+		static constexpr bool isStoredInline()
+		{
+			return sizeof(T) <= InlineBytes && alignof(T) <= inlineAlignment && std::is_nothrow_move_constructible<T>::value;
+		}
+
+		static bool isStoredInline(const TypelessTypeInfo& typeInfo)
+		{
+			return typeInfo.size <= InlineBytes && typeInfo.alignment <= inlineAlignment && typeInfo.relocate != nullptr;
+		}
+
+		SmallTypelessPointer() = default;
+
+		// Takes ownership of a heap allocated object. The object is kept on the heap.
+		template<typename T>
+		SmallTypelessPointer(T* t)
+		{
+			reset(t);
+		}
+
+		~SmallTypelessPointer()
+		{
+			reset();
+		}
+
+		SmallTypelessPointer(SmallTypelessPointer&& move)
+		{
+			moveFrom(move);
+		}
+
+		void operator=(SmallTypelessPointer&& move)
+		{
+			if (&move != this)
+			{
+				reset();
+				moveFrom(move);
+			}
+		}
+
+		// Copies are explicit, see clone()
+		SmallTypelessPointer(const SmallTypelessPointer& copy) = delete;
+		void operator=(const SmallTypelessPointer& copy) = delete;
+
+		// Deep copy. Returns an empty pointer if the type is not copy constructible.
+		SmallTypelessPointer clone() const
+		{
+			SmallTypelessPointer copy;
+			if (isInline() && typeInfo->copyConstructAt)
+			{
+				typeInfo->copyConstructAt(copy.buffer, data);
+				copy.data = copy.buffer;
+				copy.typeInfo = typeInfo;
+			}
+			else if (data && !isInline() && typeInfo->clone)
+			{
+				copy.data = typeInfo->clone(data);
+				copy.typeInfo = typeInfo;
+			}
+			return copy;
+		}
+
+		inline explicit operator bool() const
+		{
+			return data != nullptr;
+		}
+
+		inline bool hasValue() const
+		{
+			return data != nullptr;
+		}
+
+		inline bool isInline() const
+		{
+			return data == buffer;
+		}
+
+		template<typename T, typename... Args>
+		T& emplace(Args&&... args)
+		{
+			reset();
+			T* t = nullptr;
+			if constexpr (isStoredInline<T>())
+			{
+				t = new (buffer) T(std::forward<Args>(args)...);
+			}
+			else
+			{
+				t = new T(std::forward<Args>(args)...);
+			}
+			typeInfo = &TypelessTypeInfo::get<T>();
+			data = t;
+			return *t;
+		}
+
+		template<typename T>
+		void reset(T* ptr = nullptr)
+		{
+			reset();
+			if (ptr)
+			{
+				typeInfo = &TypelessTypeInfo::get<T>();
+				data = ptr;
+			}
+		}
+
+		void reset()
+		{
+			if (data)
+			{
+				if (isInline())
+				{
+					if (typeInfo->destruct)
+					{
+						typeInfo->destruct(data);
+					}
+				}
+				else
+				{
+					typeInfo->destroy(data);
+				}
+				data = nullptr;
+				typeInfo = nullptr;
+			}
+		}
+
+		void swap(SmallTypelessPointer& other)
+		{
+			if (!isInline() && !other.isInline())
+			{
+				std::swap(typeInfo, other.typeInfo);
+				std::swap(data, other.data);
+			}
+			else
+			{
+				SmallTypelessPointer temp(std::move(other));
+				other = std::move(*this);
+				*this = std::move(temp);
+			}
+		}
+
+		template<typename T>
+		inline T* get()
+		{
+			if (typeInfo == &TypelessTypeInfo::get<T>())
+			{
+				return (T*)data;
+			}
+			else
+			{
+				return nullptr;
+			}
+		}
+
+		template<typename T>
+		inline const T* get() const
+		{
+			if (typeInfo == &TypelessTypeInfo::get<T>())
+			{
+				return (const T*)data;
+			}
+			else
+			{
+				return nullptr;
+			}
+		}
+
+		// Inline objects are moved to a new heap allocation, which the caller takes ownership of
+		template<typename T>
+		T* release()
+		{
+			if (typeInfo == &TypelessTypeInfo::get<T>())
+			{
+				T* released = nullptr;
+				if (isInline())
+				{
+					if constexpr (isStoredInline<T>())
+					{
+						T& t = *(T*)data;
+						released = new T(std::move(t));
+						t.~T();
+					}
+				}
+				else
+				{
+					released = (T*)data;
+				}
+				data = nullptr;
+				typeInfo = nullptr;
+				return released;
+			}
+			else
+			{
+				return nullptr;
+			}
+		}
+
+		// Returns nullptr if empty
+		inline const TypelessTypeInfo* getTypeInfo() const
+		{
+			return typeInfo;
+		}
+
+		void write(WriteBuffer& writeBuffer) const
+		{
+			if (TypelessTypeInfo::writeType(writeBuffer, typeInfo))
+			{
+				typeInfo->writeToBufferFunction(writeBuffer, data);
+			}
+		}
+
+		void write(WriteBuffer& writeBuffer, const TypelessTypeDictionary& dictionary) const
+		{
+			if (dictionary.writeType(writeBuffer, typeInfo))
+			{
+				typeInfo->writeToBufferFunction(writeBuffer, data);
+			}
+		}
+
+		bool read(ReadBuffer& readBuffer)
+		{
+			return readImpl(readBuffer, nullptr);
+		}
+
+		bool read(ReadBuffer& readBuffer, const TypelessTypeDictionary& dictionary)
+		{
+			return readImpl(readBuffer, &dictionary);
+		}
+
+	private:
+
+		bool readImpl(ReadBuffer& readBuffer, const TypelessTypeDictionary* const dictionary)
+		{
+			reset();
+			const TypelessTypeInfo* writtenTypeInfo = nullptr;
+			const bool typeRead = dictionary
+				? dictionary->readType(readBuffer, writtenTypeInfo)
+				: TypelessTypeInfo::readType(readBuffer, writtenTypeInfo);
+			if (!typeRead)
+			{
+				return false;
+			}
+			if (writtenTypeInfo)
+			{
+				if (isStoredInline(*writtenTypeInfo))
+				{
+					writtenTypeInfo->defaultConstructAt(buffer);
+					data = buffer;
+				}
+				else
+				{
+					data = writtenTypeInfo->defaultConstruct();
+				}
+				typeInfo = writtenTypeInfo;
+				return typeInfo->readFromBufferFunction(readBuffer, data);
+			}
+			return true;
+		}
+
+		void moveFrom(SmallTypelessPointer& other)
+		{
+			if (other.isInline())
+			{
+				other.typeInfo->relocate(buffer, other.data);
+				data = buffer;
+			}
+			else
+			{
+				data = other.data;
+			}
+			typeInfo = other.typeInfo;
+			other.data = nullptr;
+			other.typeInfo = nullptr;
+		}
+
+		alignas(std::max_align_t) std::byte buffer[InlineBytes];
+		const TypelessTypeInfo* typeInfo = nullptr;
+		void* data = nullptr;
+	};
+}
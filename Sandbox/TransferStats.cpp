@@ -0,0 +1,62 @@
+#include "stdafx.h"
+#include "Sandbox/TransferStats.h"
+
+
+namespace se
+{
+	TransferStats::TransferStats()
+		: TransferStats(std::chrono::seconds(1))
+	{
+	}
+
+	TransferStats::TransferStats(const Clock::duration _window)
+		: window(_window)
+		, windowBegin(Clock::now())
+	{
+		se_assert(window > Clock::duration::zero());
+	}
+
+	bool TransferStats::update(const Clock::time_point now)
+	{
+		const Clock::duration duration = now - windowBegin;
+		if (duration < window)
+		{
+			return false;
+		}
+
+		const double seconds = std::chrono::duration<double>(duration).count();
+		lastSample.duration = duration;
+		lastSample.bytes = windowBytes;
+		lastSample.reliableBytes = windowReliableBytes;
+		lastSample.packets = windowPackets;
+		lastSample.bytesPerSecond = double(windowBytes) / seconds;
+		lastSample.reliableBytesPerSecond = double(windowReliableBytes) / seconds;
+		lastSample.packetsPerSecond = double(windowPackets) / seconds;
+
+		totalBytes += windowBytes;
+		totalReliableBytes += windowReliableBytes;
+		totalPackets += windowPackets;
+		windowBytes = 0;
+		windowReliableBytes = 0;
+		windowPackets = 0;
+		windowBegin = now;
+		return true;
+	}
+
+	bool TransferStats::update()
+	{
+		return update(Clock::now());
+	}
+
+	void TransferStats::reset()
+	{
+		windowBegin = Clock::now();
+		windowBytes = 0;
+		windowReliableBytes = 0;
+		windowPackets = 0;
+		totalBytes = 0;
+		totalReliableBytes = 0;
+		totalPackets = 0;
+		lastSample = Sample();
+	}
+}
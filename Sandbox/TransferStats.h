@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace se
+{
+	/*
+		Receive side transfer counters with windowed rate sampling.
+		add() only increments counters so it is cheap enough to call for every packet. Rates are computed by update() once per window,
+		which should be called from the update loop rather than from receive handlers, so that the clock is read once per frame instead of once per packet.
+	*/
+	class TransferStats
+	{
+	public:
+
+		typedef std::chrono::steady_clock Clock;
+
+		struct Sample
+		{
+			Clock::duration duration = Clock::duration::zero();
+			uint64_t bytes = 0;
+			uint64_t reliableBytes = 0;
+			uint64_t packets = 0;
+			double bytesPerSecond = 0.0;
+			double reliableBytesPerSecond = 0.0;
+			double packetsPerSecond = 0.0;
+		};
+
+		TransferStats();
+		TransferStats(const Clock::duration window);
+
+		inline void add(const size_t bytes, const bool reliable)
+		{
+			windowBytes += bytes;
+			windowReliableBytes += reliable ? bytes : 0;
+			windowPackets++;
+		}
+
+		// Closes the current window once it has lasted at least the window duration. Returns true when a new sample is available.
+		bool update(const Clock::time_point now);
+		bool update();
+
+		void reset();
+
+		// Rates of the last closed window
+		inline const Sample& getLastSample() const
+		{
+			return lastSample;
+		}
+
+		inline uint64_t getTotalBytes() const
+		{
+			return totalBytes + windowBytes;
+		}
+
+		inline uint64_t getTotalReliableBytes() const
+		{
+			return totalReliableBytes + windowReliableBytes;
+		}
+
+		inline uint64_t getTotalPackets() const
+		{
+			return totalPackets + windowPackets;
+		}
+
+	private:
+
+		const Clock::duration window;
+		Clock::time_point windowBegin;
+		uint64_t windowBytes = 0;
+		uint64_t windowReliableBytes = 0;
+		uint64_t windowPackets = 0;
+		uint64_t totalBytes = 0;
+		uint64_t totalReliableBytes = 0;
+		uint64_t totalPackets = 0;
+		Sample lastSample;
+	};
+}
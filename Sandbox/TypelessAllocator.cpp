@@ -0,0 +1,32 @@
+#include "stdafx.h"
+#include "Sandbox/TypelessAllocator.h"
+
+#include <new>
+
+
+namespace se
+{
+	void* TypelessAllocator::allocateFromHeap(const size_t size, const size_t alignment)
+	{
+		if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+		{
+			return ::operator new(size, std::align_val_t(alignment));
+		}
+		else
+		{
+			return ::operator new(size);
+		}
+	}
+
+	void TypelessAllocator::deallocateFromHeap(void* const data, const size_t size, const size_t alignment)
+	{
+		if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+		{
+			::operator delete(data, size, std::align_val_t(alignment));
+		}
+		else
+		{
+			::operator delete(data, size);
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+
+
+namespace se
+{
+	/*
+		Memory source for type erased objects, see TypelessArena and TypelessObjectPool.
+		Allocators only provide memory, object construction and destruction is done by the owner (e.g. TypelessPointer).
+		Allocators are not thread safe.
+	*/
+	class TypelessAllocator
+	{
+	public:
+
+		struct Stats
+		{
+			size_t allocatorBytes = 0;		// Bytes served from the allocator's own memory
+			size_t allocatorObjects = 0;	// Objects served from the allocator's own memory
+			size_t heapBytes = 0;			// Bytes that had to fall back to the general purpose heap
+			size_t heapObjects = 0;			// Objects that had to fall back to the general purpose heap
+		};
+
+		virtual ~TypelessAllocator() = default;
+
+		virtual void* allocate(const size_t size, const size_t alignment) = 0;
+		// Size and alignment must match the values given to allocate().
+		virtual void deallocate(void* const data, const size_t size, const size_t alignment) = 0;
+
+		inline const Stats& getStats() const { return stats; }
+		inline void resetStats() { stats = Stats(); }
+
+	protected:
+
+		static void* allocateFromHeap(const size_t size, const size_t alignment);
+		static void deallocateFromHeap(void* const data, const size_t size, const size_t alignment);
+
+		Stats stats;
+	};
+}
@@ -0,0 +1,65 @@
+#include "stdafx.h"
+#include "Sandbox/TypelessArena.h"
+
+
+namespace se
+{
+	TypelessArena::TypelessArena(const size_t _blockSize)
+		: blockSize(_blockSize)
+	{
+		se_assert(blockSize > 0);
+	}
+
+	TypelessArena::~TypelessArena()
+	{
+		se_assert(liveObjects == 0 && "Objects allocated from the arena were not released.");
+	}
+
+	void* TypelessArena::allocate(const size_t size, const size_t alignment)
+	{
+		liveObjects++;
+		if (isHeapAllocation(size, alignment))
+		{
+			stats.heapBytes += size;
+			stats.heapObjects++;
+			return allocateFromHeap(size, alignment);
+		}
+
+		size_t offset = (blockOffset + alignment - 1) & ~(alignment - 1);
+		if (blocks.empty() || offset + size > blockSize)
+		{
+			if (!blocks.empty())
+			{
+				blockIndex++;
+			}
+			if (blockIndex == blocks.size())
+			{
+				// Block memory is aligned to at least max_align_t
+				blocks.push_back(std::unique_ptr<std::byte[]>(new std::byte[blockSize]));
+			}
+			offset = 0;
+		}
+
+		stats.allocatorBytes += size;
+		stats.allocatorObjects++;
+		blockOffset = offset + size;
+		return blocks[blockIndex].get() + offset;
+	}
+
+	void TypelessArena::deallocate(void* const data, const size_t size, const size_t alignment)
+	{
+		se_assert(liveObjects > 0);
+		liveObjects--;
+		if (isHeapAllocation(size, alignment))
+		{
+			deallocateFromHeap(data, size, alignment);
+		}
+	}
+
+	void TypelessArena::reset()
+	{
+		se_assert(liveObjects == 0 && "Objects allocated from the arena were not released before reset.");
+		blockIndex = 0;
+		blockOffset = 0;
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Sandbox/TypelessAllocator.h"
+#include <memory>
+#include <vector>
+#include <stddef.h>
+
+
+namespace se
+{
+	/*
+		Bump allocator for objects that live until the end of a frame, for example the payloads of one received packet.
+		deallocate() does not reclaim memory, everything is reclaimed at once with reset().
+		Memory blocks are kept between resets, so a warmed up arena does no heap allocations.
+		Allocations larger than half a block fall back to the heap.
+	*/
+	class TypelessArena : public TypelessAllocator
+	{
+	public:
+
+		TypelessArena(const size_t blockSize = 64 * 1024);
+		~TypelessArena();
+
+		TypelessArena(const TypelessArena& copy) = delete;
+		void operator=(const TypelessArena& copy) = delete;
+
+		void* allocate(const size_t size, const size_t alignment) override;
+		void deallocate(void* const data, const size_t size, const size_t alignment) override;
+
+		// Reclaims all arena memory. All objects allocated from the arena must have been released before calling this.
+		void reset();
+
+		inline size_t getBlockSize() const { return blockSize; }
+		inline size_t getBlockCount() const { return blocks.size(); }
+		inline size_t getLiveObjectCount() const { return liveObjects; }
+
+	private:
+
+		inline bool isHeapAllocation(const size_t size, const size_t alignment) const
+		{
+			return size > blockSize / 2 || alignment > alignof(std::max_align_t);
+		}
+
+		const size_t blockSize;
+		std::vector<std::unique_ptr<std::byte[]>> blocks;
+		size_t blockIndex = 0;
+		size_t blockOffset = 0;
+		size_t liveObjects = 0;
+	};
+}
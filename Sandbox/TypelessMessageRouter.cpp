@@ -0,0 +1,131 @@
+#include "stdafx.h"
+#include "Sandbox/TypelessMessageRouter.h"
+
+#include "SpehsEngine/Core/WriteBuffer.h"
+#include "SpehsEngine/Core/ReadBuffer.h"
+#include "SpehsEngine/Core/StringUtilityFunctions.h"
+#include "Sandbox/TypelessPointer.h"
+#include "Sandbox/TypelessTypeDictionary.h"
+
+
+namespace se
+{
+	void TypelessMessageRouter::writeImpl(WriteBuffer& writeBuffer, const TypelessTypeInfo& typeInfo, const void* const message, const TypelessTypeDictionary& dictionary)
+	{
+		if (dictionary.writeType(writeBuffer, &typeInfo))
+		{
+			typeInfo.writeToBufferFunction(writeBuffer, message);
+		}
+	}
+
+	void TypelessMessageRouter::setDefaultHandler(const std::function<void(TypelessPointer&, const bool)>& function)
+	{
+		defaultHandler = function;
+	}
+
+	TypelessMessageRouter::Handler& TypelessMessageRouter::getOrAddHandler(const TypelessTypeInfo& typeInfo)
+	{
+		if (typeInfo.localIndex >= handlers.size())
+		{
+			handlers.resize(typeInfo.localIndex + 1);
+		}
+		return handlers[typeInfo.localIndex];
+	}
+
+	bool TypelessMessageRouter::route(ReadBuffer& readBuffer, const bool reliable)
+	{
+		const TypelessTypeInfo* typeInfo = nullptr;
+		if (!TypelessTypeInfo::readType(readBuffer, typeInfo))
+		{
+			return false;
+		}
+		return dispatch(readBuffer, typeInfo, reliable);
+	}
+
+	bool TypelessMessageRouter::route(ReadBuffer& readBuffer, const TypelessTypeDictionary& dictionary, const bool reliable)
+	{
+		const TypelessTypeInfo* typeInfo = nullptr;
+		if (!dictionary.readType(readBuffer, typeInfo))
+		{
+			return false;
+		}
+		return dispatch(readBuffer, typeInfo, reliable);
+	}
+
+	bool TypelessMessageRouter::routeAll(ReadBuffer& readBuffer, const bool reliable)
+	{
+		while (readBuffer.getBytesRemaining() > 0)
+		{
+			if (!route(readBuffer, reliable))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool TypelessMessageRouter::routeAll(ReadBuffer& readBuffer, const TypelessTypeDictionary& dictionary, const bool reliable)
+	{
+		while (readBuffer.getBytesRemaining() > 0)
+		{
+			if (!route(readBuffer, dictionary, reliable))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::function<void(ReadBuffer&, const bool)> TypelessMessageRouter::makeReceiveHandler()
+	{
+		return [this](ReadBuffer& readBuffer, const bool reliable)
+		{
+			if (!routeAll(readBuffer, reliable))
+			{
+				log::warning(formatString("TypelessMessageRouter: failed to route received %s packet, %zu bytes were left unread.", reliable ? "reliable" : "unreliable", readBuffer.getBytesRemaining()));
+			}
+		};
+	}
+
+	bool TypelessMessageRouter::dispatch(ReadBuffer& readBuffer, const TypelessTypeInfo* const typeInfo, const bool reliable)
+	{
+		if (!typeInfo)
+		{
+			// Null message
+			return true;
+		}
+		if (typeInfo->localIndex < handlers.size())
+		{
+			Handler& handler = handlers[typeInfo->localIndex];
+			if (handler.function)
+			{
+				return handler.function(readBuffer, reliable);
+			}
+		}
+
+		// No handler, the message must still be decoded to get past it
+		if (!defaultHandler && typeInfo->size <= skipStorageSize && typeInfo->alignment <= alignof(std::max_align_t))
+		{
+			alignas(std::max_align_t) std::byte storage[skipStorageSize];
+			typeInfo->defaultConstructAt(storage);
+			const bool result = typeInfo->readFromBufferFunction(readBuffer, storage);
+			if (typeInfo->destruct)
+			{
+				typeInfo->destruct(storage);
+			}
+			return result;
+		}
+		TypelessPointer message;
+		message.data = (std::byte*)typeInfo->defaultConstruct();
+		message.typeInfo = typeInfo;
+		if (!typeInfo->readFromBufferFunction(readBuffer, message.data))
+		{
+			return false;
+		}
+		if (defaultHandler)
+		{
+			defaultHandler(message, reliable);
+		}
+		return true;
+	}
+}
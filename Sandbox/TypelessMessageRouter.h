@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Sandbox/TypelessTypeInfo.h"
+#include <functional>
+#include <vector>
+#include <stddef.h>
+
+
+namespace se
+{
+	class WriteBuffer;
+	class ReadBuffer;
+	class TypelessPointer;
+	class TypelessTypeDictionary;
+
+	/*
+		Dispatches typed messages from a receive buffer to handlers registered per message type.
+		Messages use the TypelessPointer wire format (type header followed by the object), so TypelessPointer::write() and TypelessMessageRouter::write() produce the same bytes.
+		Handlers are kept in a table indexed by TypelessTypeInfo::localIndex, dispatch is one registry lookup and one table lookup per message.
+		Messages with a handler are decoded into a stack object of the handler's parameter type.
+		Unhandled messages are skipped by decoding them into stack storage when no default handler is set and the type fits into skipStorageSize bytes.
+		Larger unhandled types, and all messages passed to the default handler, are decoded into a heap allocated TypelessPointer.
+		Types that allocate internally, like std::string, still allocate when they are decoded.
+		Register handlers at startup, the router itself is not thread safe.
+	*/
+	class TypelessMessageRouter
+	{
+	public:
+
+		template<typename T>
+		static void write(WriteBuffer& writeBuffer, const T& message)
+		{
+			const TypelessTypeInfo& typeInfo = TypelessTypeInfo::get<T>();
+			if (TypelessTypeInfo::writeType(writeBuffer, &typeInfo))
+			{
+				typeInfo.writeToBufferFunction(writeBuffer, &message);
+			}
+		}
+
+		template<typename T>
+		static void write(WriteBuffer& writeBuffer, const T& message, const TypelessTypeDictionary& dictionary)
+		{
+			writeImpl(writeBuffer, TypelessTypeInfo::get<T>(), &message, dictionary);
+		}
+
+		// Handler signature: void(T& message, bool reliable). Replaces the previous handler of the same type.
+		template<typename T, typename Function>
+		void setHandler(Function&& function)
+		{
+			static_assert(std::is_default_constructible<T>::value, "Message types must be default constructible.");
+			const TypelessTypeInfo& typeInfo = TypelessTypeInfo::get<T>();
+			se_assert(typeInfo.isSerializable());
+			Handler& handler = getOrAddHandler(typeInfo);
+			handler.function = [function = std::forward<Function>(function)](ReadBuffer& readBuffer, const bool reliable) mutable
+			{
+				T message;
+				if (!TypelessTypeInfo::get<T>().readFromBufferFunction(readBuffer, &message))
+				{
+					return false;
+				}
+				function(message, reliable);
+				return true;
+			};
+		}
+
+		template<typename T>
+		void removeHandler()
+		{
+			const TypelessTypeInfo& typeInfo = TypelessTypeInfo::get<T>();
+			if (typeInfo.localIndex < handlers.size())
+			{
+				handlers[typeInfo.localIndex].function = nullptr;
+			}
+		}
+
+		// Receives messages of types that have no handler. Without a default handler such messages are decoded and dropped.
+		void setDefaultHandler(const std::function<void(TypelessPointer& message, const bool reliable)>& function);
+
+		// Routes one message. Returns false if the message could not be decoded, in which case the rest of the buffer cannot be read either.
+		bool route(ReadBuffer& readBuffer, const bool reliable);
+		bool route(ReadBuffer& readBuffer, const TypelessTypeDictionary& dictionary, const bool reliable);
+
+		// Routes messages until the buffer is empty
+		bool routeAll(ReadBuffer& readBuffer, const bool reliable);
+		bool routeAll(ReadBuffer& readBuffer, const TypelessTypeDictionary& dictionary, const bool reliable);
+
+		// For receive handler callbacks like Connection2::setReceiveHandler(). The router must outlive the returned function.
+		std::function<void(ReadBuffer&, const bool)> makeReceiveHandler();
+
+	private:
+
+		static constexpr size_t skipStorageSize = 256;
+
+		struct Handler
+		{
+			std::function<bool(ReadBuffer&, const bool)> function;
+		};
+
+		static void writeImpl(WriteBuffer& writeBuffer, const TypelessTypeInfo& typeInfo, const void* const message, const TypelessTypeDictionary& dictionary);
+		Handler& getOrAddHandler(const TypelessTypeInfo& typeInfo);
+		bool dispatch(ReadBuffer& readBuffer, const TypelessTypeInfo* const typeInfo, const bool reliable);
+
+		std::vector<Handler> handlers; // Indexed by TypelessTypeInfo::localIndex
+		std::function<void(TypelessPointer&, const bool)> defaultHandler;
+	};
+}
@@ -0,0 +1,81 @@
+#include "stdafx.h"
+#include "Sandbox/TypelessObjectPool.h"
+
+
+namespace se
+{
+	TypelessObjectPool::TypelessObjectPool(const size_t _slabSize)
+		: slabSize(_slabSize)
+	{
+		se_assert(slabSize >= maxSizeClass);
+	}
+
+	TypelessObjectPool::~TypelessObjectPool()
+	{
+		se_assert(liveObjects == 0 && "Objects allocated from the pool were not released.");
+	}
+
+	size_t TypelessObjectPool::getSizeClassIndex(const size_t size)
+	{
+		size_t index = 0;
+		size_t sizeClass = minSizeClass;
+		while (sizeClass < size)
+		{
+			sizeClass <<= 1;
+			index++;
+		}
+		return index;
+	}
+
+	void TypelessObjectPool::refill(const size_t sizeClassIndex)
+	{
+		const size_t sizeClass = minSizeClass << sizeClassIndex;
+		slabs.push_back(std::unique_ptr<std::byte[]>(new std::byte[slabSize]));
+		std::byte* const slab = slabs.back().get();
+		const size_t count = slabSize / sizeClass;
+		for (size_t i = count; i-- > 0;)
+		{
+			FreeNode* const node = new (slab + i * sizeClass) FreeNode();
+			node->next = freeLists[sizeClassIndex];
+			freeLists[sizeClassIndex] = node;
+		}
+	}
+
+	void* TypelessObjectPool::allocate(const size_t size, const size_t alignment)
+	{
+		liveObjects++;
+		if (isHeapAllocation(size, alignment))
+		{
+			stats.heapBytes += size;
+			stats.heapObjects++;
+			return allocateFromHeap(size, alignment);
+		}
+
+		const size_t sizeClassIndex = getSizeClassIndex(size);
+		if (!freeLists[sizeClassIndex])
+		{
+			refill(sizeClassIndex);
+		}
+		FreeNode* const node = freeLists[sizeClassIndex];
+		freeLists[sizeClassIndex] = node->next;
+		stats.allocatorBytes += size;
+		stats.allocatorObjects++;
+		return node;
+	}
+
+	void TypelessObjectPool::deallocate(void* const data, const size_t size, const size_t alignment)
+	{
+		se_assert(liveObjects > 0);
+		liveObjects--;
+		if (isHeapAllocation(size, alignment))
+		{
+			deallocateFromHeap(data, size, alignment);
+			return;
+		}
+
+		const size_t sizeClassIndex = getSizeClassIndex(size);
+		FreeNode* const node = new (data) FreeNode();
+		node->next = freeLists[sizeClassIndex];
+		freeLists[sizeClassIndex] = node;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Sandbox/TypelessAllocator.h"
+#include <memory>
+#include <vector>
+#include <stddef.h>
+
+
+namespace se
+{
+	/*
+		Size class object pool for type erased objects that are released individually.
+		Sizes are rounded up to a power of two between minSizeClass and maxSizeClass, each class keeps its own free list.
+		Memory is taken from the heap in slabs and is only returned when the pool is destroyed.
+		Objects larger than maxSizeClass or more than max_align_t aligned fall back to the heap.
+	*/
+	class TypelessObjectPool : public TypelessAllocator
+	{
+	public:
+
+		static constexpr size_t minSizeClass = 16;
+		static constexpr size_t maxSizeClass = 1024;
+
+		TypelessObjectPool(const size_t slabSize = 64 * 1024);
+		~TypelessObjectPool();
+
+		TypelessObjectPool(const TypelessObjectPool& copy) = delete;
+		void operator=(const TypelessObjectPool& copy) = delete;
+
+		void* allocate(const size_t size, const size_t alignment) override;
+		void deallocate(void* const data, const size_t size, const size_t alignment) override;
+
+		inline size_t getSlabCount() const { return slabs.size(); }
+		inline size_t getLiveObjectCount() const { return liveObjects; }
+
+	private:
+
+		struct FreeNode
+		{
+			FreeNode* next = nullptr;
+		};
+
+		static constexpr size_t sizeClassCount = 7; // 16, 32, ..., 1024
+
+		static size_t getSizeClassIndex(const size_t size);
+
+		inline bool isHeapAllocation(const size_t size, const size_t alignment) const
+		{
+			return size > maxSizeClass || alignment > alignof(std::max_align_t);
+		}
+
+		void refill(const size_t sizeClassIndex);
+
+		const size_t slabSize;
+		FreeNode* freeLists[sizeClassCount] = {};
+		std::vector<std::unique_ptr<std::byte[]>> slabs;
+		size_t liveObjects = 0;
+	};
+}
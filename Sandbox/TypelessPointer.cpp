@@ -3,65 +3,97 @@
 
 #include "SpehsEngine/Core/WriteBuffer.h"
 #include "SpehsEngine/Core/ReadBuffer.h"
-#include "SpehsEngine/Core/StringUtilityFunctions.h"
+#include "Sandbox/TypelessTypeDictionary.h"
 
 
 namespace se
 {
-	std::unordered_map<size_t, std::string> TypelessPointer::typeNames;
-	std::unordered_map<size_t, std::function<void(TypelessPointer& typelessPointer)>> TypelessPointer::defaultConstructorFunctions;
-	std::unordered_map<size_t, std::function<void(void*)>> TypelessPointer::destructorFunctions;
-	std::unordered_map<size_t, std::function<void(WriteBuffer&, const void*)>> TypelessPointer::writeToBufferFunctions;
-	std::unordered_map<size_t, std::function<bool(ReadBuffer&, void*)>> TypelessPointer::readFromBufferFunctions;
-
-	void TypelessPointer::write(WriteBuffer& writeBuffer) const
+	TypelessPointer TypelessPointer::clone() const
 	{
-		size_t writtenTypeHashCode = typeHashCode;
-		if (typeHashCode != 0 && defaultConstructorFunctions.find(typeHashCode) == defaultConstructorFunctions.end())
+		TypelessPointer copy;
+		if (data && typeInfo->clone)
 		{
-			log::warning(formatString("Type is not default constructible: %s. Writing null to stream.", typeNames[typeHashCode].c_str()));
-			writtenTypeHashCode = 0;
+			copy.data = (std::byte*)typeInfo->clone(data);
+			copy.typeInfo = typeInfo;
 		}
+		return copy;
+	}
 
-		const std::unordered_map<size_t, std::function<void(WriteBuffer&, const void*)>>::iterator writeToBufferFunctionIt = writeToBufferFunctions.find(typeHashCode);
-		if (writeToBufferFunctionIt == writeToBufferFunctions.end())
+	TypelessPointer TypelessPointer::clone(TypelessAllocator& _allocator) const
+	{
+		TypelessPointer copy;
+		if (data && typeInfo->copyConstructAt)
 		{
-			log::warning(formatString("Type does not implement writing to WriteBuffer: %s. Writing null to stream.", typeNames[typeHashCode].c_str()));
-			writtenTypeHashCode = 0;
+			copy.data = (std::byte*)_allocator.allocate(typeInfo->size, typeInfo->alignment);
+			typeInfo->copyConstructAt(copy.data, data);
+			copy.typeInfo = typeInfo;
+			copy.allocator = &_allocator;
 		}
+		return copy;
+	}
 
-		if (typeHashCode != 0 && readFromBufferFunctions.find(typeHashCode) == readFromBufferFunctions.end())
+	void TypelessPointer::write(WriteBuffer& writeBuffer) const
+	{
+		if (TypelessTypeInfo::writeType(writeBuffer, typeInfo))
 		{
-			log::warning(formatString("Type does not implement reading from ReadBuffer: %s. Writing null to stream.", typeNames[typeHashCode].c_str()));
-			writtenTypeHashCode = 0;
+			// Call the write function
+			typeInfo->writeToBufferFunction(writeBuffer, data);
 		}
+	}
 
-		writeBuffer.write(writtenTypeHashCode);
-		if (writtenTypeHashCode != 0)
+	void TypelessPointer::write(WriteBuffer& writeBuffer, const TypelessTypeDictionary& dictionary) const
+	{
+		if (dictionary.writeType(writeBuffer, typeInfo))
 		{
-			// Call the write function
-			writeToBufferFunctionIt->second(writeBuffer, data);
+			typeInfo->writeToBufferFunction(writeBuffer, data);
 		}
 	}
 
 	bool TypelessPointer::read(ReadBuffer& readBuffer)
 	{
-		size_t writtenTypeHashCode = 0;
-		se_read(readBuffer, writtenTypeHashCode);
-		if (writtenTypeHashCode != 0)
+		return readImpl(readBuffer, nullptr, nullptr);
+	}
+
+	bool TypelessPointer::read(ReadBuffer& readBuffer, TypelessAllocator& _allocator)
+	{
+		return readImpl(readBuffer, nullptr, &_allocator);
+	}
+
+	bool TypelessPointer::read(ReadBuffer& readBuffer, const TypelessTypeDictionary& dictionary)
+	{
+		return readImpl(readBuffer, &dictionary, nullptr);
+	}
+
+	bool TypelessPointer::read(ReadBuffer& readBuffer, const TypelessTypeDictionary& dictionary, TypelessAllocator& _allocator)
+	{
+		return readImpl(readBuffer, &dictionary, &_allocator);
+	}
+
+	bool TypelessPointer::readImpl(ReadBuffer& readBuffer, const TypelessTypeDictionary* const dictionary, TypelessAllocator* const _allocator)
+	{
+		reset();
+		const TypelessTypeInfo* writtenTypeInfo = nullptr;
+		const bool typeRead = dictionary
+			? dictionary->readType(readBuffer, writtenTypeInfo)
+			: TypelessTypeInfo::readType(readBuffer, writtenTypeInfo);
+		if (!typeRead)
 		{
-			// read function
-			std::function<void(TypelessPointer& typelessPointer)>& defaultConstructor = defaultConstructorFunctions[writtenTypeHashCode];
-			se_assert(defaultConstructor);
-			defaultConstructor(*this);
-			se_assert(typeHashCode == writtenTypeHashCode);
-			std::function<bool(ReadBuffer&, void*)>& readFromBufferFunction = readFromBufferFunctions[typeHashCode];
-			se_assert(readFromBufferFunction);
-			return readFromBufferFunction(readBuffer, data);
+			return false;
 		}
-		else
+		if (writtenTypeInfo)
 		{
-			reset();
+			if (_allocator)
+			{
+				data = (std::byte*)_allocator->allocate(writtenTypeInfo->size, writtenTypeInfo->alignment);
+				writtenTypeInfo->defaultConstructAt(data);
+				allocator = _allocator;
+			}
+			else
+			{
+				data = (std::byte*)writtenTypeInfo->defaultConstruct();
+			}
+			typeInfo = writtenTypeInfo;
+			return typeInfo->readFromBufferFunction(readBuffer, data);
 		}
 		return true;
 	}
@@ -1,9 +1,7 @@
 #pragma once
 
-#include "SpehsEngine/Core/WriteBuffer.h"
-#include "SpehsEngine/Core/ReadBuffer.h"
-#include <unordered_map>
-#include <functional>
+#include "Sandbox/TypelessTypeInfo.h"
+#include "Sandbox/TypelessAllocator.h"
 #include <stddef.h>
 
 
@@ -11,11 +9,14 @@ namespace se
 {
 	class WriteBuffer;
 	class ReadBuffer;
+	class TypelessTypeDictionary;
 
 	/*
 		It's a smart pointer like std::unique_ptr<T>, but without the <T>...
 		This is mostly just some experimental code.
-		My main gripe with this class is that it currently has to include some ugly serialization stuff in it and its not easily extensible outside the class.
+		Type specific operations are dispatched through a per-type TypelessTypeInfo table, see TypelessTypeInfo.h.
+		Objects are heap allocated by default, emplace() and read() can optionally draw memory from a TypelessAllocator instead.
+		Allocator owned objects must be reset before the allocator is reset or destroyed.
 	*/
 	class TypelessPointer
 	{
@@ -44,10 +45,14 @@ namespace se
 			swap(move);
 		}
 
-		// No deep copying implemented
+		// Copies are explicit, see clone()
 		TypelessPointer(const TypelessPointer& copy) = delete;
 		void operator=(const TypelessPointer& copy) = delete;
 
+		// Deep copy. Returns an empty pointer if the type is not copy constructible.
+		TypelessPointer clone() const;
+		TypelessPointer clone(TypelessAllocator& allocator) const;
+
 		inline explicit operator bool() const
 		{
 			return data != nullptr;
@@ -64,37 +69,55 @@ namespace se
 			reset();
 			if (ptr)
 			{
-				updateTypeData<T>();
-				typeHashCode = typeid(T).hash_code();
+				typeInfo = &TypelessTypeInfo::get<T>();
 				data = (std::byte*)ptr;
 			}
 		}
 
+		template<typename T, typename... Args>
+		T& emplace(TypelessAllocator& _allocator, Args&&... args)
+		{
+			reset();
+			T* const t = new (_allocator.allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+			typeInfo = &TypelessTypeInfo::get<T>();
+			data = (std::byte*)t;
+			allocator = &_allocator;
+			return *t;
+		}
+
 		void reset()
 		{
 			if (data)
 			{
-				const std::unordered_map<size_t, std::function<void(void*)>>::iterator destructorIt = destructorFunctions.find(typeHashCode);
-				if (destructorIt != destructorFunctions.end())
+				if (allocator)
+				{
+					if (typeInfo->destruct)
+					{
+						typeInfo->destruct(data);
+					}
+					allocator->deallocate(data, typeInfo->size, typeInfo->alignment);
+					allocator = nullptr;
+				}
+				else
 				{
-					destructorIt->second(data);
+					typeInfo->destroy(data);
 				}
-				delete[] data;
 				data = nullptr;
-				typeHashCode = 0;
+				typeInfo = nullptr;
 			}
 		}
 
 		inline void swap(TypelessPointer& other)
 		{
-			std::swap(typeHashCode, other.typeHashCode);
+			std::swap(typeInfo, other.typeInfo);
 			std::swap(data, other.data);
+			std::swap(allocator, other.allocator);
 		}
 
 		template<typename T>
 		inline T* get()
 		{
-			if (typeid(T).hash_code() == typeHashCode)
+			if (typeInfo == &TypelessTypeInfo::get<T>())
 			{
 				return (T*)data;
 			}
@@ -107,7 +130,7 @@ namespace se
 		template<typename T>
 		inline const T* get() const
 		{
-			if (typeid(T).hash_code() == typeHashCode)
+			if (typeInfo == &TypelessTypeInfo::get<T>())
 			{
 				return (const T*)data;
 			}
@@ -117,14 +140,16 @@ namespace se
 			}
 		}
 
+		// Allocator owned objects cannot be released
 		template<typename T>
 		inline T* release()
 		{
-			if (typeid(T).hash_code() == typeHashCode)
+			se_assert(!allocator);
+			if (typeInfo == &TypelessTypeInfo::get<T>() && !allocator)
 			{
 				T* released = (T*)data;
 				data = nullptr;
-				typeHashCode = 0;
+				typeInfo = nullptr;
 				return released;
 			}
 			else
@@ -133,166 +158,39 @@ namespace se
 			}
 		}
 
-		void write(se::WriteBuffer& buffer) const;
-		bool read(se::ReadBuffer& readBuffer);
-
-	private:
-
-		// Default constructor
-		template<typename T>
-		typename std::enable_if<std::is_default_constructible<T>::value, void>::type addDefaultConstructor()
-		{
-			const size_t _typeHashCode = typeHashCode;
-			defaultConstructorFunctions[typeHashCode] = [_typeHashCode](TypelessPointer& typelessPointer)
-			{
-				typelessPointer.reset();
-				typelessPointer.data = (std::byte*)malloc(sizeof(T));
-				new (typelessPointer.data) T();
-				typelessPointer.typeHashCode = _typeHashCode;
-			};
-		}
-		template<typename T>
-		typename std::enable_if<!std::is_default_constructible<T>::value, void>::type addDefaultConstructor()
+		// Returns nullptr if empty
+		inline const TypelessTypeInfo* getTypeInfo() const
 		{
+			return typeInfo;
 		}
 
-		// Destructor
-		template<typename T>
-		typename std::enable_if<std::is_trivially_destructible<T>::value, void>::type addDestructor()
-		{
-		}
-		template<typename T>
-		typename std::enable_if<!std::is_trivially_destructible<T>::value, void>::type addDestructor()
+		// Returns nullptr if the object is heap allocated or if empty
+		inline TypelessAllocator* getAllocator() const
 		{
-			destructorFunctions[typeHashCode] = [](void* data)
-			{
-				T& t = dynamic_cast<T&>(*(T*)data);
-				t.~T();
-			};
+			return allocator;
 		}
 
-		// Write to buffer
-		template<typename T>
-		typename std::enable_if<
-			!std::is_class<T>::value,
-				void>::type addWriteToBufferFunction()
-		{
-			// Is not class
-			writeToBufferFunctions[typeHashCode] = [](WriteBuffer& writeBuffer, const void* data)
-			{
-				const T& t = *((const T*)data);
-				writeBuffer.write(t);
-			};
-		}
-		template<typename T>
-		typename std::enable_if<
-			std::is_class<T>::value &&
-			WriteBuffer::has_member_write<T, void(T::*)(WriteBuffer&) const>::value,
-				void>::type addWriteToBufferFunction()
-		{
-			// Is class, has write member function
-			writeToBufferFunctions[typeHashCode] = [](WriteBuffer& writeBuffer, const void* data)
-			{
-				const T& t = *((const T*)data);
-				t.write(writeBuffer);
-			};
-		}
-		template<typename T>
-		typename std::enable_if<
-			std::is_class<T>::value &&
-			!WriteBuffer::has_member_write<T, void(T::*)(WriteBuffer&) const>::value &&
-			WriteBuffer::has_free_write<T>::value,
-				void>::type addWriteToBufferFunction()
-		{
-			// Is class, doesn't have write member function but has free write function
-			writeToBufferFunctions[typeHashCode] = [](WriteBuffer& writeBuffer, const void* data)
-			{
-				const T& t = *((const T*)data);
-				writeToBuffer(writeBuffer, t);
-			};
-		}
-		template<typename T>
-		typename std::enable_if<
-			std::is_class<T>::value &&
-			!WriteBuffer::has_member_write<T, void(T::*)(WriteBuffer&) const>::value &&
-			!WriteBuffer::has_free_write<T>::value,
-				void>::type addWriteToBufferFunction()
-		{
-			// Is class, doesn't have write member function or free write function
-		}
+		void write(se::WriteBuffer& buffer) const;
+		bool read(se::ReadBuffer& readBuffer);
+		bool read(se::ReadBuffer& readBuffer, TypelessAllocator& allocator);
 
-		// Read from buffer
-		template<typename T>
-		typename std::enable_if<
-			!std::is_class<T>::value,
-			void>::type addReadFromBufferFunction()
-		{
-			// Is not class
-			readFromBufferFunctions[typeHashCode] = [](ReadBuffer& readBuffer, void* data)
-			{
-				T& t = *((T*)data);
-				return readBuffer.read(t);
-			};
-		}
-		template<typename T>
-		typename std::enable_if<
-			std::is_class<T>::value &&
-			ReadBuffer::has_member_read<T, bool(T::*)(ReadBuffer&)>::value,
-			void>::type addReadFromBufferFunction()
-		{
-			// Is class, has read member function
-			readFromBufferFunctions[typeHashCode] = [](ReadBuffer& readBuffer, void* data)
-			{
-				T& t = *((T*)data);
-				return t.read(readBuffer);
-			};
-		}
-		template<typename T>
-		typename std::enable_if<
-			std::is_class<T>::value &&
-			!ReadBuffer::has_member_read<T, bool(T::*)(ReadBuffer&)>::value&&
-			ReadBuffer::has_free_read<T>::value,
-			void>::type addReadFromBufferFunction()
-		{
-			// Is class, doesn't have read member function but has free read function
-			readFromBufferFunctions[typeHashCode] = [](ReadBuffer& readBuffer, void* data)
-			{
-				T& t = *((T*)data);
-				return readFromBuffer(readBuffer, t);
-			};
-		}
-		template<typename T>
-		typename std::enable_if<
-			std::is_class<T>::value &&
-			!ReadBuffer::has_member_read<T, bool(T::*)(ReadBuffer&)>::value &&
-			!ReadBuffer::has_free_read<T>::value,
-			void>::type addReadFromBufferFunction()
-		{
-			// Is class, doesn't have read member function or free read function
-		}
+		// Compact type headers using a negotiated per-connection dictionary
+		void write(se::WriteBuffer& buffer, const TypelessTypeDictionary& dictionary) const;
+		bool read(se::ReadBuffer& readBuffer, const TypelessTypeDictionary& dictionary);
+		bool read(se::ReadBuffer& readBuffer, const TypelessTypeDictionary& dictionary, TypelessAllocator& allocator);
 
-		template<typename T>
-		void updateTypeData()
-		{
-			typeHashCode = typeid(T).hash_code();
-			if (destructorFunctions.find(typeHashCode) == destructorFunctions.end())
-			{
-				typeNames[typeHashCode] = typeid(T).name();
-				addDefaultConstructor<T>();
-				addDestructor<T>();
-				addWriteToBufferFunction<T>();
-				addReadFromBufferFunction<T>();
-			}
-		}
+	private:
 
-		size_t typeHashCode = 0;
-		std::byte* data = nullptr;
+		friend class TypelessView;
+		friend class LazyTypelessPointer;
+		friend class TypelessMessageRouter;
+		friend class TypelessSnapshot;
+		friend class TypelessSnapshotWriter;
+
+		bool readImpl(se::ReadBuffer& readBuffer, const TypelessTypeDictionary* const dictionary, TypelessAllocator* const allocator);
 
-		// Function pointers
-		static std::unordered_map<size_t, std::string> typeNames;
-		static std::unordered_map<size_t, std::function<void(TypelessPointer& typelessPointer)>> defaultConstructorFunctions;
-		static std::unordered_map<size_t, std::function<void(void*)>> destructorFunctions;
-		static std::unordered_map<size_t, std::function<void(WriteBuffer&, const void*)>> writeToBufferFunctions;
-		static std::unordered_map<size_t, std::function<bool(ReadBuffer&, void*)>> readFromBufferFunctions;
+		const TypelessTypeInfo* typeInfo = nullptr;
+		std::byte* data = nullptr;
+		TypelessAllocator* allocator = nullptr;
 	};
 }
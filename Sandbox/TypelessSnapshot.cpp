@@ -0,0 +1,355 @@
+#include "stdafx.h"
+#include "Sandbox/TypelessSnapshot.h"
+
+#include "SpehsEngine/Core/WriteBuffer.h"
+#include "SpehsEngine/Core/ReadBuffer.h"
+#include "SpehsEngine/Core/StringUtilityFunctions.h"
+#include <fstream>
+#include <string.h>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace se
+{
+	/*
+		File layout:
+		FileHeader
+		IndexEntry[entryCount]
+		padding to dataAlignment
+		data region, each entry aligned to max(type alignment, 8)
+	*/
+	static constexpr char snapshotMagic[8] = { 'S', 'E', 'S', 'N', 'A', 'P', 'S', 'H' };
+
+	static size_t alignUp(const size_t value, const size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	uint32_t TypelessSnapshotWriter::getPlatform()
+	{
+		const uint16_t one = 1;
+		uint8_t littleEndian = 0;
+		memcpy(&littleEndian, &one, 1);
+		return uint32_t(littleEndian) | (uint32_t(sizeof(void*)) << 8);
+	}
+
+	size_t TypelessSnapshotWriter::add(const TypelessPointer& typelessPointer)
+	{
+		return addImpl(typelessPointer.getTypeInfo(), typelessPointer.data);
+	}
+
+	size_t TypelessSnapshotWriter::addImpl(const TypelessTypeInfo* const typeInfo, const void* const object)
+	{
+		IndexEntry& entry = entries.emplace_back();
+		if (!typeInfo || !object)
+		{
+			return entries.size() - 1;
+		}
+
+		if (!typeInfo->registered)
+		{
+			log::error(formatString("Type is not registered because of a type id collision or a frozen type registry: %s. Storing null in the snapshot.", typeInfo->name));
+			se_assert(false && "Storing an unregistered type.");
+			return entries.size() - 1;
+		}
+
+		// Pointers would not be valid in the process that loads the snapshot
+		const bool inPlace = typeInfo->triviallyCopyable && !typeInfo->hasPointers;
+		if (!inPlace && !typeInfo->isSerializable())
+		{
+			se_assert(false && "Object can't be stored in a snapshot, its type is not serializable and it can't be stored in place.");
+			return entries.size() - 1;
+		}
+
+		entry.typeId = typeInfo->typeId;
+		if (inPlace)
+		{
+			entry.flags |= inPlaceFlag;
+			entry.layoutFingerprint = typeInfo->layoutFingerprint;
+			append(object, typeInfo->size, typeInfo->alignment, entry);
+		}
+		else
+		{
+			WriteBuffer writeBuffer;
+			typeInfo->writeToBufferFunction(writeBuffer, object);
+			append(writeBuffer.getData(), writeBuffer.getSize(), 1, entry);
+		}
+		return entries.size() - 1;
+	}
+
+	void TypelessSnapshotWriter::append(const void* const bytes, const size_t size, const size_t alignment, IndexEntry& entry)
+	{
+		const size_t offset = alignUp(data.size(), std::max(alignment, size_t(8)));
+		data.resize(offset + size);
+		if (size > 0)
+		{
+			memcpy(data.data() + offset, bytes, size);
+		}
+		entry.offset = uint64_t(offset);
+		entry.size = uint64_t(size);
+	}
+
+	bool TypelessSnapshotWriter::writeToFile(const std::string& path) const
+	{
+		FileHeader header;
+		memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+		header.version = version;
+		header.platform = getPlatform();
+		header.entryCount = uint64_t(entries.size());
+		header.dataOffset = uint64_t(alignUp(sizeof(FileHeader) + sizeof(IndexEntry) * entries.size(), dataAlignment));
+		header.dataSize = uint64_t(data.size());
+
+		std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			log::warning("TypelessSnapshotWriter: failed to open file for writing: " + path);
+			return false;
+		}
+		file.write((const char*)&header, sizeof(header));
+		if (!entries.empty())
+		{
+			file.write((const char*)entries.data(), std::streamsize(sizeof(IndexEntry) * entries.size()));
+		}
+		const size_t padding = size_t(header.dataOffset) - sizeof(FileHeader) - sizeof(IndexEntry) * entries.size();
+		const char zeros[dataAlignment] = {};
+		file.write(zeros, std::streamsize(padding));
+		if (!data.empty())
+		{
+			file.write((const char*)data.data(), std::streamsize(data.size()));
+		}
+		if (!file.good())
+		{
+			log::warning("TypelessSnapshotWriter: failed to write file: " + path);
+			return false;
+		}
+		return true;
+	}
+
+	void TypelessSnapshotWriter::clear()
+	{
+		entries.clear();
+		data.clear();
+	}
+
+	TypelessSnapshot::~TypelessSnapshot()
+	{
+		close();
+	}
+
+	bool TypelessSnapshot::open(const std::string& path)
+	{
+		close();
+
+#ifdef _WIN32
+		const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			log::warning("TypelessSnapshot: failed to open file: " + path);
+			return false;
+		}
+		fileHandle = file;
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < LONGLONG(sizeof(TypelessSnapshotWriter::FileHeader)))
+		{
+			log::warning("TypelessSnapshot: invalid file: " + path);
+			close();
+			return false;
+		}
+		mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mappingHandle)
+		{
+			log::warning("TypelessSnapshot: failed to map file: " + path);
+			close();
+			return false;
+		}
+		mappedData = (const std::byte*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+		mappedSize = size_t(fileSize.QuadPart);
+#else
+		const int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			log::warning("TypelessSnapshot: failed to open file: " + path);
+			return false;
+		}
+		struct stat fileStat;
+		if (fstat(file, &fileStat) != 0 || size_t(fileStat.st_size) < sizeof(TypelessSnapshotWriter::FileHeader))
+		{
+			log::warning("TypelessSnapshot: invalid file: " + path);
+			::close(file);
+			return false;
+		}
+		void* const mapping = mmap(nullptr, size_t(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		::close(file); // The mapping keeps the file open
+		if (mapping != MAP_FAILED)
+		{
+			mappedData = (const std::byte*)mapping;
+			mappedSize = size_t(fileStat.st_size);
+		}
+#endif
+		if (!mappedData)
+		{
+			log::warning("TypelessSnapshot: failed to map file: " + path);
+			close();
+			return false;
+		}
+
+		const auto fail = [&](const char* const reason)
+		{
+			log::warning(formatString("TypelessSnapshot: %s: %s", reason, path.c_str()));
+			close();
+			return false;
+		};
+
+		TypelessSnapshotWriter::FileHeader header;
+		memcpy(&header, mappedData, sizeof(header));
+		if (memcmp(header.magic, snapshotMagic, sizeof(snapshotMagic)) != 0 || header.version != TypelessSnapshotWriter::version)
+		{
+			return fail("unknown file format or version");
+		}
+		if (header.platform != TypelessSnapshotWriter::getPlatform())
+		{
+			return fail("file was written on an incompatible platform");
+		}
+		const uint64_t indexEnd = uint64_t(sizeof(header)) + header.entryCount * sizeof(TypelessSnapshotWriter::IndexEntry);
+		if (header.entryCount > uint64_t(mappedSize) / sizeof(TypelessSnapshotWriter::IndexEntry)
+			|| indexEnd > header.dataOffset
+			|| header.dataOffset > uint64_t(mappedSize)
+			|| header.dataSize > uint64_t(mappedSize) - header.dataOffset)
+		{
+			return fail("corrupted index");
+		}
+
+		// The index follows the 8 aligned header in a page aligned mapping, so it can be read in place
+		const TypelessSnapshotWriter::IndexEntry* const index = (const TypelessSnapshotWriter::IndexEntry*)(mappedData + sizeof(header));
+		const std::byte* const dataBegin = mappedData + header.dataOffset;
+		entries.resize(size_t(header.entryCount));
+		size_t unknownCount = 0;
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			const TypelessSnapshotWriter::IndexEntry& indexEntry = index[i];
+			if (indexEntry.offset > header.dataSize || indexEntry.size > header.dataSize - indexEntry.offset)
+			{
+				return fail("corrupted index entry");
+			}
+			if (indexEntry.typeId == 0)
+			{
+				continue;
+			}
+			const TypelessTypeInfo* const typeInfo = TypelessTypeInfo::find(indexEntry.typeId);
+			if (!typeInfo)
+			{
+				unknownCount++;
+				continue;
+			}
+			Entry& entry = entries[i];
+			entry.inPlace = (indexEntry.flags & TypelessSnapshotWriter::inPlaceFlag) != 0;
+			if (entry.inPlace)
+			{
+				if (!typeInfo->triviallyCopyable
+					|| typeInfo->hasPointers
+					|| typeInfo->layoutFingerprint != indexEntry.layoutFingerprint
+					|| typeInfo->size != indexEntry.size
+					|| indexEntry.offset % typeInfo->alignment != 0)
+				{
+					return fail(formatString("in place object layout does not match type %s", typeInfo->name).c_str());
+				}
+			}
+			else if (!typeInfo->isSerializable())
+			{
+				return fail(formatString("type %s is not serializable", typeInfo->name).c_str());
+			}
+			entry.typeInfo = typeInfo;
+			entry.data = dataBegin + indexEntry.offset;
+			entry.size = size_t(indexEntry.size);
+		}
+		if (unknownCount > 0)
+		{
+			log::warning(formatString("TypelessSnapshot: %zu entries of unregistered types in: %s", unknownCount, path.c_str()));
+		}
+		return true;
+	}
+
+	void TypelessSnapshot::close()
+	{
+		entries.clear();
+#ifdef _WIN32
+		if (mappedData)
+		{
+			UnmapViewOfFile(mappedData);
+		}
+		if (mappingHandle)
+		{
+			CloseHandle(mappingHandle);
+			mappingHandle = nullptr;
+		}
+		if (fileHandle)
+		{
+			CloseHandle(fileHandle);
+			fileHandle = nullptr;
+		}
+#else
+		if (mappedData)
+		{
+			munmap((void*)mappedData, mappedSize);
+		}
+#endif
+		mappedData = nullptr;
+		mappedSize = 0;
+	}
+
+	const TypelessTypeInfo* TypelessSnapshot::getTypeInfo(const size_t index) const
+	{
+		se_assert(index < entries.size());
+		return entries[index].typeInfo;
+	}
+
+	bool TypelessSnapshot::isInPlace(const size_t index) const
+	{
+		se_assert(index < entries.size());
+		return entries[index].inPlace;
+	}
+
+	const void* TypelessSnapshot::getData(const size_t index)
+	{
+		se_assert(index < entries.size());
+		Entry& entry = entries[index];
+		if (!entry.typeInfo)
+		{
+			return nullptr;
+		}
+		if (entry.inPlace)
+		{
+			return entry.data;
+		}
+		if (entry.decoded)
+		{
+			return entry.decoded.data;
+		}
+		if (entry.decodeFailed)
+		{
+			return nullptr;
+		}
+
+		ReadBuffer readBuffer(entry.data, entry.size);
+		entry.decoded.data = (std::byte*)entry.typeInfo->defaultConstruct();
+		entry.decoded.typeInfo = entry.typeInfo;
+		if (!entry.typeInfo->readFromBufferFunction(readBuffer, entry.decoded.data) || readBuffer.getBytesRemaining() != 0)
+		{
+			log::warning(formatString("TypelessSnapshot: failed to decode object of type %s at index %zu.", entry.typeInfo->name, index));
+			entry.decoded.reset();
+			entry.decodeFailed = true;
+			return nullptr;
+		}
+		return entry.decoded.data;
+	}
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "Sandbox/TypelessTypeInfo.h"
+#include "Sandbox/TypelessPointer.h"
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+
+namespace se
+{
+	/*
+		Builds a snapshot file from type erased objects, see TypelessSnapshot for loading.
+		Trivially copyable objects are stored as raw bytes at an offset aligned for the type so that they can be used directly from the mapped file.
+		Other objects, and objects that hold pointers, are stored in their serialized form and decoded on access.
+		Raw objects are only loaded if the layout fingerprint of their type still matches, see AggregateReflection::getLayoutFingerprint().
+	*/
+	class TypelessSnapshotWriter
+	{
+	public:
+
+		// Returns the index of the added object. Empty pointers are stored as empty entries.
+		size_t add(const TypelessPointer& typelessPointer);
+
+		template<typename T>
+		size_t add(const T& t)
+		{
+			return addImpl(&TypelessTypeInfo::get<T>(), &t);
+		}
+
+		bool writeToFile(const std::string& path) const;
+
+		inline size_t getCount() const
+		{
+			return entries.size();
+		}
+
+		void clear();
+
+	private:
+
+		friend class TypelessSnapshot;
+
+		struct FileHeader
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t platform;		// Byte order and pointer size of the writer, in place objects are only valid on a matching platform
+			uint64_t entryCount;
+			uint64_t dataOffset;	// File offset of the data region, entry offsets are relative to it
+			uint64_t dataSize;
+		};
+
+		struct IndexEntry
+		{
+			uint32_t typeId;		// 0 for an empty entry
+			uint32_t flags;
+			uint64_t offset;
+			uint64_t size;
+			uint64_t layoutFingerprint;	// Of in place objects
+		};
+
+		static constexpr uint32_t inPlaceFlag = 1u << 0;
+		static constexpr uint32_t version = 2;
+		static constexpr size_t dataAlignment = 64;
+
+		static uint32_t getPlatform();
+		size_t addImpl(const TypelessTypeInfo* const typeInfo, const void* const data);
+		void append(const void* const bytes, const size_t size, const size_t alignment, IndexEntry& entry);
+
+		std::vector<IndexEntry> entries;
+		std::vector<std::byte> data;
+	};
+
+	/*
+		Read only snapshot loaded by memory mapping the file.
+		Opening only validates the index, in place objects are never copied and serialized objects are decoded on their first access.
+		Types must be registered before opening, entries of unknown types are reported as empty.
+		Returned objects are valid until the snapshot is closed. Not thread safe.
+	*/
+	class TypelessSnapshot
+	{
+	public:
+
+		TypelessSnapshot() = default;
+		~TypelessSnapshot();
+
+		TypelessSnapshot(const TypelessSnapshot& copy) = delete;
+		void operator=(const TypelessSnapshot& copy) = delete;
+
+		bool open(const std::string& path);
+		void close();
+
+		inline bool isOpen() const
+		{
+			return mappedData != nullptr;
+		}
+
+		inline size_t getCount() const
+		{
+			return entries.size();
+		}
+
+		// Returns nullptr for empty entries and entries of unknown types
+		const TypelessTypeInfo* getTypeInfo(const size_t index) const;
+
+		// Is the object used directly from the mapped file
+		bool isInPlace(const size_t index) const;
+
+		// Decodes the object on first access if it is not stored in place. Returns nullptr if the entry is empty or if decoding fails.
+		const void* getData(const size_t index);
+
+		template<typename T>
+		const T* get(const size_t index)
+		{
+			if (getTypeInfo(index) == &TypelessTypeInfo::get<T>())
+			{
+				return (const T*)getData(index);
+			}
+			else
+			{
+				return nullptr;
+			}
+		}
+
+	private:
+
+		struct Entry
+		{
+			const TypelessTypeInfo* typeInfo = nullptr;
+			const std::byte* data = nullptr;
+			size_t size = 0;
+			bool inPlace = false;
+			bool decodeFailed = false;
+			TypelessPointer decoded;
+		};
+
+		const std::byte* mappedData = nullptr;
+		size_t mappedSize = 0;
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+		std::vector<Entry> entries;
+	};
+}
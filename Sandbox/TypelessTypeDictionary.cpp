@@ -0,0 +1,123 @@
+#include "stdafx.h"
+#include "Sandbox/TypelessTypeDictionary.h"
+
+#include "SpehsEngine/Core/WriteBuffer.h"
+#include "SpehsEngine/Core/ReadBuffer.h"
+#include "SpehsEngine/Core/StringUtilityFunctions.h"
+#include "Sandbox/TypelessTypeInfo.h"
+#include "Sandbox/VarInt.h"
+#include <algorithm>
+
+
+namespace se
+{
+	std::vector<uint32_t> TypelessTypeDictionary::getOfferedTypeIds()
+	{
+		std::vector<uint32_t> typeIds;
+		for (const TypelessTypeInfo* const typeInfo : TypelessTypeInfo::getRegistered())
+		{
+			if (typeInfo->isSerializable())
+			{
+				typeIds.push_back(typeInfo->typeId);
+			}
+		}
+		std::sort(typeIds.begin(), typeIds.end());
+		return typeIds;
+	}
+
+	void TypelessTypeDictionary::writeOffer(WriteBuffer& writeBuffer)
+	{
+		// Types register on first use, so the registry may have grown by the time the remote offer arrives
+		offeredTypeIds = getOfferedTypeIds();
+		offered = true;
+		writeVarUInt(writeBuffer, offeredTypeIds.size());
+		for (const uint32_t typeId : offeredTypeIds)
+		{
+			writeBuffer.write(typeId);
+		}
+	}
+
+	bool TypelessTypeDictionary::readOffer(ReadBuffer& readBuffer)
+	{
+		se_assert(offered && "The local offer must be written before the remote offer is read.");
+		uint64_t count = 0;
+		if (!readVarUInt(readBuffer, count) || count > readBuffer.getBytesRemaining() / sizeof(uint32_t))
+		{
+			return false;
+		}
+		std::vector<uint32_t> remoteTypeIds(size_t(count), 0);
+		for (uint32_t& typeId : remoteTypeIds)
+		{
+			se_read(readBuffer, typeId);
+		}
+		std::sort(remoteTypeIds.begin(), remoteTypeIds.end());
+
+		std::vector<uint32_t> sharedTypeIds;
+		std::set_intersection(offeredTypeIds.begin(), offeredTypeIds.end(), remoteTypeIds.begin(), remoteTypeIds.end(), std::back_inserter(sharedTypeIds));
+
+		typeInfos.clear();
+		indices.clear();
+		for (const uint32_t typeId : sharedTypeIds)
+		{
+			indices[typeId] = uint32_t(typeInfos.size());
+			typeInfos.push_back(TypelessTypeInfo::find(typeId));
+		}
+		negotiated = true;
+		return true;
+	}
+
+	bool TypelessTypeDictionary::writeType(WriteBuffer& writeBuffer, const TypelessTypeInfo* const typeInfo) const
+	{
+		se_assert(negotiated);
+		if (typeInfo)
+		{
+			if (!typeInfo->registered)
+			{
+				log::error(formatString("Type is not registered because of a type id collision or a frozen type registry: %s. Writing null to stream.", typeInfo->name));
+				se_assert(false && "Writing an unregistered type.");
+				writeVarUInt(writeBuffer, 0);
+				return false;
+			}
+			const std::unordered_map<uint32_t, uint32_t>::const_iterator it = indices.find(typeInfo->typeId);
+			if (it != indices.end())
+			{
+				se_assert(typeInfos[it->second] == typeInfo);
+				// Index 0 is reserved for null
+				writeVarUInt(writeBuffer, uint64_t(it->second) + 1);
+				return true;
+			}
+			log::warning(formatString("Type is not in the negotiated type dictionary: %s. Writing null to stream.", typeInfo->name));
+		}
+		writeVarUInt(writeBuffer, 0);
+		return false;
+	}
+
+	bool TypelessTypeDictionary::readType(ReadBuffer& readBuffer, const TypelessTypeInfo*& typeInfo) const
+	{
+		se_assert(negotiated);
+		uint64_t index = 0;
+		if (!readVarUInt(readBuffer, index))
+		{
+			return false;
+		}
+		if (index == 0)
+		{
+			typeInfo = nullptr;
+			return true;
+		}
+		if (index > typeInfos.size())
+		{
+			log::warning(formatString("Type dictionary index out of range: %u", unsigned(index)));
+			typeInfo = nullptr;
+			return false;
+		}
+		typeInfo = typeInfos[size_t(index - 1)];
+		if (!typeInfo || !typeInfo->registered)
+		{
+			log::warning(formatString("Type dictionary index refers to an unregistered type: %u", unsigned(index)));
+			typeInfo = nullptr;
+			return false;
+		}
+		return true;
+	}
+}
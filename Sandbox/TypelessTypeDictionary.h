@@ -0,0 +1,45 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+
+namespace se
+{
+	class WriteBuffer;
+	class ReadBuffer;
+	class TypelessTypeInfo;
+
+	/*
+		Per-connection mapping between wire type ids and compact varint indices.
+		Both ends send an offer listing the serializable types they know, then index the sorted intersection of the two offers.
+		Because both ends derive the same indices, typed objects can afterwards be sent with 1-2 byte type headers, also over unreliable channels.
+		Register all types before writing the offer, types registered afterwards cannot be sent through the dictionary.
+		The offer must be written before the remote offer is read, the intersection is taken with the type ids that were actually offered.
+	*/
+	class TypelessTypeDictionary
+	{
+	public:
+
+		void writeOffer(WriteBuffer& writeBuffer);
+		bool readOffer(ReadBuffer& readBuffer);
+
+		inline bool isNegotiated() const { return negotiated; }
+		inline size_t getTypeCount() const { return typeInfos.size(); }
+
+		// Same semantics as TypelessTypeInfo::writeType()/readType(), but the type header is a varint index.
+		bool writeType(WriteBuffer& writeBuffer, const TypelessTypeInfo* const typeInfo) const;
+		bool readType(ReadBuffer& readBuffer, const TypelessTypeInfo*& typeInfo) const;
+
+	private:
+
+		static std::vector<uint32_t> getOfferedTypeIds();
+
+		bool offered = false;
+		bool negotiated = false;
+		std::vector<uint32_t> offeredTypeIds; // Sorted
+		std::vector<const TypelessTypeInfo*> typeInfos; // Index -> type
+		std::unordered_map<uint32_t, uint32_t> indices; // Type id -> index
+	};
+}
@@ -0,0 +1,219 @@
+#include "stdafx.h"
+#include "Sandbox/TypelessTypeInfo.h"
+
+#include "SpehsEngine/Core/WriteBuffer.h"
+#include "SpehsEngine/Core/ReadBuffer.h"
+#include "SpehsEngine/Core/StringUtilityFunctions.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+
+namespace se
+{
+	namespace
+	{
+		/*
+			Insert-only open addressing table.
+			Readers only do atomic loads, writers are serialized by Registry::mutex.
+			When a table fills up, a larger copy is published and the old one is kept alive for readers that may still be probing it.
+		*/
+		struct Table
+		{
+			Table(const size_t _capacity)
+				: capacity(_capacity)
+				, slots(new std::atomic<const TypelessTypeInfo*>[_capacity])
+			{
+				se_assert((capacity & (capacity - 1)) == 0);
+				for (size_t i = 0; i < capacity; i++)
+				{
+					slots[i].store(nullptr, std::memory_order_relaxed);
+				}
+			}
+
+			const TypelessTypeInfo* find(const uint32_t typeId) const
+			{
+				const size_t mask = capacity - 1;
+				for (size_t index = typeId & mask;; index = (index + 1) & mask)
+				{
+					const TypelessTypeInfo* const typeInfo = slots[index].load(std::memory_order_acquire);
+					if (!typeInfo || typeInfo->typeId == typeId)
+					{
+						return typeInfo;
+					}
+				}
+			}
+
+			void insert(const TypelessTypeInfo& typeInfo)
+			{
+				const size_t mask = capacity - 1;
+				size_t index = typeInfo.typeId & mask;
+				while (slots[index].load(std::memory_order_relaxed))
+				{
+					index = (index + 1) & mask;
+				}
+				slots[index].store(&typeInfo, std::memory_order_release);
+				count++;
+			}
+
+			const size_t capacity;
+			std::unique_ptr<std::atomic<const TypelessTypeInfo*>[]> slots;
+			size_t count = 0;
+		};
+
+		struct Registry
+		{
+			std::mutex mutex;
+			std::atomic<const Table*> table = nullptr;
+			std::vector<std::unique_ptr<Table>> tables;
+			std::atomic<bool> frozen = false;
+		};
+
+		Registry& getRegistry()
+		{
+			static Registry registry;
+			return registry;
+		}
+	}
+
+	uint32_t TypelessTypeInfo::allocateLocalIndex()
+	{
+		static std::atomic<uint32_t> nextLocalIndex = 0;
+		return nextLocalIndex.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	bool TypelessTypeInfo::registerTypeInfo(TypelessTypeInfo& typeInfo)
+	{
+		se_assert(typeInfo.typeId != 0);
+		Registry& registry = getRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		if (registry.frozen.load(std::memory_order_relaxed))
+		{
+			log::warning(formatString("Type used for the first time after the type registry was frozen: %s. It cannot be read from buffers.", typeInfo.name));
+			return false;
+		}
+
+		Table* table = registry.tables.empty() ? nullptr : registry.tables.back().get();
+		if (table)
+		{
+			const TypelessTypeInfo* const registeredTypeInfo = table->find(typeInfo.typeId);
+			if (registeredTypeInfo)
+			{
+				if (registeredTypeInfo != &typeInfo)
+				{
+					log::error(formatString("Type id collision between types: %s and %s. Give one of the types a different SE_TYPELESS_TYPE_NAME.", registeredTypeInfo->name, typeInfo.name));
+					return false;
+				}
+				return true;
+			}
+		}
+
+		// Keep the load factor at or below 1/2
+		if (!table || (table->count + 1) * 2 > table->capacity)
+		{
+			std::unique_ptr<Table> newTable = std::make_unique<Table>(table ? table->capacity * 2 : 64);
+			if (table)
+			{
+				for (size_t i = 0; i < table->capacity; i++)
+				{
+					if (const TypelessTypeInfo* const existing = table->slots[i].load(std::memory_order_relaxed))
+					{
+						newTable->insert(*existing);
+					}
+				}
+			}
+			table = newTable.get();
+			registry.tables.push_back(std::move(newTable));
+		}
+
+		// Set before publishing so that readers that find the type through the table always see it as registered
+		typeInfo.registered = true;
+		table->insert(typeInfo);
+		registry.table.store(table, std::memory_order_release);
+		return true;
+	}
+
+	void TypelessTypeInfo::freezeRegistry()
+	{
+		Registry& registry = getRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.frozen.store(true, std::memory_order_relaxed);
+	}
+
+	bool TypelessTypeInfo::isRegistryFrozen()
+	{
+		return getRegistry().frozen.load(std::memory_order_relaxed);
+	}
+
+	const TypelessTypeInfo* TypelessTypeInfo::find(const uint32_t typeId)
+	{
+		const Table* const table = getRegistry().table.load(std::memory_order_acquire);
+		return table ? table->find(typeId) : nullptr;
+	}
+
+	std::vector<const TypelessTypeInfo*> TypelessTypeInfo::getRegistered()
+	{
+		std::vector<const TypelessTypeInfo*> registered;
+		if (const Table* const table = getRegistry().table.load(std::memory_order_acquire))
+		{
+			for (size_t i = 0; i < table->capacity; i++)
+			{
+				if (const TypelessTypeInfo* const typeInfo = table->slots[i].load(std::memory_order_acquire))
+				{
+					registered.push_back(typeInfo);
+				}
+			}
+		}
+		return registered;
+	}
+
+	bool TypelessTypeInfo::writeType(WriteBuffer& writeBuffer, const TypelessTypeInfo* const typeInfo)
+	{
+		uint32_t writtenTypeId = typeInfo ? typeInfo->typeId : 0;
+		if (typeInfo)
+		{
+			if (!typeInfo->registered)
+			{
+				log::error(formatString("Type is not registered because of a type id collision or a frozen type registry: %s. Writing null to stream.", typeInfo->name));
+				se_assert(false && "Writing an unregistered type.");
+				writtenTypeId = 0;
+			}
+			if (!typeInfo->defaultConstruct)
+			{
+				log::warning(formatString("Type is not default constructible: %s. Writing null to stream.", typeInfo->name));
+				writtenTypeId = 0;
+			}
+			if (!typeInfo->writeToBufferFunction)
+			{
+				log::warning(formatString("Type does not implement writing to WriteBuffer: %s. Writing null to stream.", typeInfo->name));
+				writtenTypeId = 0;
+			}
+			if (!typeInfo->readFromBufferFunction)
+			{
+				log::warning(formatString("Type does not implement reading from ReadBuffer: %s. Writing null to stream.", typeInfo->name));
+				writtenTypeId = 0;
+			}
+		}
+		writeBuffer.write(writtenTypeId);
+		return writtenTypeId != 0;
+	}
+
+	bool TypelessTypeInfo::readType(ReadBuffer& readBuffer, const TypelessTypeInfo*& typeInfo)
+	{
+		uint32_t writtenTypeId = 0;
+		se_read(readBuffer, writtenTypeId);
+		if (writtenTypeId == 0)
+		{
+			typeInfo = nullptr;
+			return true;
+		}
+		typeInfo = find(writtenTypeId);
+		if (!typeInfo || !typeInfo->registered || !typeInfo->isSerializable())
+		{
+			log::warning(formatString("Cannot read unknown or unreadable type from ReadBuffer. Type id: %u", unsigned(writtenTypeId)));
+			typeInfo = nullptr;
+			return false;
+		}
+		return true;
+	}
+}
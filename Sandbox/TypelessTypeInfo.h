@@ -0,0 +1,427 @@
+#pragma once
+
+#include "SpehsEngine/Core/WriteBuffer.h"
+#include "SpehsEngine/Core/ReadBuffer.h"
+#include "Sandbox/AggregateReflection.h"
+#include <typeinfo>
+#include <type_traits>
+#include <utility>
+#include <new>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace se
+{
+	/*
+		Specialize with SE_TYPELESS_TYPE_NAME to give a type a stable wire type id.
+		The id is a hash of the name, so it is the same across builds, compilers and binaries.
+		Types without a registered name fall back to hashing typeid(T).name(), which is only stable between identical builds.
+	*/
+	template<typename T>
+	struct TypelessTypeName
+	{
+	};
+
+	/*
+		Per-type operation table for type erased storage.
+		Exactly one instance exists for each type T, so comparing TypelessTypeInfo pointers is a valid type check.
+		Operations that the type cannot support are left as nullptr.
+		Aggregates without write/read functions are serialized through AggregateReflection, see AggregateReflection.h.
+	*/
+	class TypelessTypeInfo
+	{
+	public:
+
+		template<typename T>
+		static const TypelessTypeInfo& get()
+		{
+			static TypelessTypeInfo typeInfo = make<T>();
+			static const bool registered = registerTypeInfo(typeInfo);
+			(void)registered;
+			return typeInfo;
+		}
+
+		// FNV-1a
+		static constexpr uint32_t hashTypeName(const char* const name)
+		{
+			uint32_t hash = 2166136261u;
+			for (const char* c = name; *c; c++)
+			{
+				hash = (hash ^ uint32_t(uint8_t(*c))) * 16777619u;
+			}
+			return hash;
+		}
+
+		// Types are registered on first use, registering them explicitly at startup guarantees that they can be read from buffers.
+		template<typename... Types>
+		static void registerTypes()
+		{
+			(get<Types>(), ...);
+		}
+
+		/*
+			The registry can be read from any thread without locking.
+			Registration is thread safe too, but freezing the registry after startup makes the set of readable types deterministic.
+			Types first used after freezing still work locally, but cannot be found by type id and are written to buffers as null.
+		*/
+		static void freezeRegistry();
+		static bool isRegistryFrozen();
+
+		// Returns nullptr if no type with the given id has been registered
+		static const TypelessTypeInfo* find(const uint32_t typeId);
+		static std::vector<const TypelessTypeInfo*> getRegistered();
+
+		// Writes the type header of a serialized object. Returns false if the object body should not be written, in which case null was written.
+		// Types that could not be registered, because of a type id collision or a frozen registry, are written as null.
+		static bool writeType(WriteBuffer& writeBuffer, const TypelessTypeInfo* const typeInfo);
+		// Reads the type header of a serialized object. Null is read as typeInfo = nullptr.
+		static bool readType(ReadBuffer& readBuffer, const TypelessTypeInfo*& typeInfo);
+
+		inline bool isSerializable() const
+		{
+			return defaultConstruct && writeToBufferFunction && readFromBufferFunction;
+		}
+
+		const char* name = "";
+		uint32_t typeId = 0;			// Wire type id, never 0
+		uint32_t localIndex = 0;		// Dense index in order of first use, only meaningful within this process. Useful for table lookups.
+		bool hasStableName = false;		// Is typeId stable across builds
+		bool registered = false;		// Can this type be found by typeId. False if the id collides with another type or the type was first used after freezeRegistry().
+		size_t size = 0;
+		size_t alignment = 0;
+		bool triviallyCopyable = false;
+		bool hasPointers = false;			// See AggregateReflection::hasPointers()
+		uint64_t layoutFingerprint = 0;		// AggregateReflection::getLayoutFingerprint() of trivially copyable types, 0 for other types
+
+		// Allocates and default constructs a new object. Objects must be released with destroy().
+		void* (*defaultConstruct)() = nullptr;
+		// Destructs and deallocates an object created with new T or defaultConstruct().
+		void (*destroy)(void* data) = nullptr;
+		// Default constructs an object into the given memory.
+		void (*defaultConstructAt)(void* memory) = nullptr;
+		// Destructs an object without deallocating it. nullptr if the type is trivially destructible.
+		void (*destruct)(void* data) = nullptr;
+		// Move constructs an object into the given memory and destructs the source. Only available for nothrow move constructible types.
+		void (*relocate)(void* memory, void* source) = nullptr;
+		// Allocates a copy of the object. Objects must be released with destroy(). nullptr if the type is not copy constructible.
+		void* (*clone)(const void* data) = nullptr;
+		// Copy constructs an object into the given memory, trivially copyable types are copied with memcpy. nullptr if the type is not copy constructible.
+		void (*copyConstructAt)(void* memory, const void* source) = nullptr;
+		void (*writeToBufferFunction)(WriteBuffer& writeBuffer, const void* data) = nullptr;
+		bool (*readFromBufferFunction)(ReadBuffer& readBuffer, void* data) = nullptr;
+
+	private:
+
+		template<typename T>
+		static TypelessTypeInfo make()
+		{
+			TypelessTypeInfo typeInfo;
+			setName<T>(typeInfo);
+			typeInfo.localIndex = allocateLocalIndex();
+			typeInfo.size = sizeof(T);
+			typeInfo.alignment = alignof(T);
+			typeInfo.triviallyCopyable = std::is_trivially_copyable<T>::value;
+			typeInfo.hasPointers = AggregateReflection::hasPointers<T>();
+			if constexpr (std::is_trivially_copyable<T>::value)
+			{
+				typeInfo.layoutFingerprint = AggregateReflection::getLayoutFingerprint<T>();
+			}
+			typeInfo.defaultConstruct = getDefaultConstructor<T>();
+			typeInfo.destroy = [](void* data)
+			{
+				delete static_cast<T*>(data);
+			};
+			typeInfo.defaultConstructAt = getDefaultConstructAtFunction<T>();
+			typeInfo.destruct = getDestructor<T>();
+			typeInfo.relocate = getRelocateFunction<T>();
+			typeInfo.clone = getCloneFunction<T>();
+			typeInfo.copyConstructAt = getCopyConstructAtFunction<T>();
+			typeInfo.writeToBufferFunction = getWriteToBufferFunction<T>();
+			typeInfo.readFromBufferFunction = getReadFromBufferFunction<T>();
+			return typeInfo;
+		}
+
+		static bool registerTypeInfo(TypelessTypeInfo& typeInfo);
+		static uint32_t allocateLocalIndex();
+
+		// Name
+		template<typename T, typename = void>
+		struct HasStableName : std::false_type {};
+		template<typename T>
+		struct HasStableName<T, std::void_t<decltype(TypelessTypeName<T>::value)>> : std::true_type {};
+		template<typename T>
+		static typename std::enable_if<HasStableName<T>::value, void>::type setName(TypelessTypeInfo& typeInfo)
+		{
+			constexpr uint32_t typeId = hashTypeName(TypelessTypeName<T>::value);
+			typeInfo.name = TypelessTypeName<T>::value;
+			typeInfo.typeId = typeId;
+			typeInfo.hasStableName = true;
+		}
+		template<typename T>
+		static typename std::enable_if<!HasStableName<T>::value, void>::type setName(TypelessTypeInfo& typeInfo)
+		{
+			typeInfo.name = typeid(T).name();
+			typeInfo.typeId = hashTypeName(typeInfo.name);
+			typeInfo.hasStableName = false;
+		}
+
+		// Default constructor
+		template<typename T>
+		static typename std::enable_if<std::is_default_constructible<T>::value, void* (*)()>::type getDefaultConstructor()
+		{
+			return []() -> void*
+			{
+				return new T();
+			};
+		}
+		template<typename T>
+		static typename std::enable_if<!std::is_default_constructible<T>::value, void* (*)()>::type getDefaultConstructor()
+		{
+			return nullptr;
+		}
+		template<typename T>
+		static typename std::enable_if<std::is_default_constructible<T>::value, void (*)(void*)>::type getDefaultConstructAtFunction()
+		{
+			return [](void* memory)
+			{
+				new (memory) T();
+			};
+		}
+		template<typename T>
+		static typename std::enable_if<!std::is_default_constructible<T>::value, void (*)(void*)>::type getDefaultConstructAtFunction()
+		{
+			return nullptr;
+		}
+
+		// Destructor
+		template<typename T>
+		static typename std::enable_if<std::is_trivially_destructible<T>::value, void (*)(void*)>::type getDestructor()
+		{
+			return nullptr;
+		}
+		template<typename T>
+		static typename std::enable_if<!std::is_trivially_destructible<T>::value, void (*)(void*)>::type getDestructor()
+		{
+			return [](void* data)
+			{
+				static_cast<T*>(data)->~T();
+			};
+		}
+
+		// Relocate
+		template<typename T>
+		static typename std::enable_if<std::is_nothrow_move_constructible<T>::value, void (*)(void*, void*)>::type getRelocateFunction()
+		{
+			return [](void* memory, void* source)
+			{
+				T& t = *static_cast<T*>(source);
+				new (memory) T(std::move(t));
+				t.~T();
+			};
+		}
+		template<typename T>
+		static typename std::enable_if<!std::is_nothrow_move_constructible<T>::value, void (*)(void*, void*)>::type getRelocateFunction()
+		{
+			return nullptr;
+		}
+
+		// Copy
+		template<typename T>
+		static typename std::enable_if<std::is_copy_constructible<T>::value, void* (*)(const void*)>::type getCloneFunction()
+		{
+			return [](const void* data) -> void*
+			{
+				return new T(*static_cast<const T*>(data));
+			};
+		}
+		template<typename T>
+		static typename std::enable_if<!std::is_copy_constructible<T>::value, void* (*)(const void*)>::type getCloneFunction()
+		{
+			return nullptr;
+		}
+		template<typename T>
+		static typename std::enable_if<std::is_trivially_copyable<T>::value, void (*)(void*, const void*)>::type getCopyConstructAtFunction()
+		{
+			return [](void* memory, const void* source)
+			{
+				memcpy(memory, source, sizeof(T));
+			};
+		}
+		template<typename T>
+		static typename std::enable_if<!std::is_trivially_copyable<T>::value && std::is_copy_constructible<T>::value, void (*)(void*, const void*)>::type getCopyConstructAtFunction()
+		{
+			return [](void* memory, const void* source)
+			{
+				new (memory) T(*static_cast<const T*>(source));
+			};
+		}
+		template<typename T>
+		static typename std::enable_if<!std::is_trivially_copyable<T>::value && !std::is_copy_constructible<T>::value, void (*)(void*, const void*)>::type getCopyConstructAtFunction()
+		{
+			return nullptr;
+		}
+
+		// Write to buffer
+		template<typename T>
+		static typename std::enable_if<
+			!std::is_class<T>::value,
+				void (*)(WriteBuffer&, const void*)>::type getWriteToBufferFunction()
+		{
+			// Is not class
+			return [](WriteBuffer& writeBuffer, const void* data)
+			{
+				const T& t = *((const T*)data);
+				writeBuffer.write(t);
+			};
+		}
+		template<typename T>
+		static typename std::enable_if<
+			std::is_class<T>::value &&
+			WriteBuffer::has_member_write<T, void(T::*)(WriteBuffer&) const>::value,
+				void (*)(WriteBuffer&, const void*)>::type getWriteToBufferFunction()
+		{
+			// Is class, has write member function
+			return [](WriteBuffer& writeBuffer, const void* data)
+			{
+				const T& t = *((const T*)data);
+				t.write(writeBuffer);
+			};
+		}
+		template<typename T>
+		static typename std::enable_if<
+			std::is_class<T>::value &&
+			!WriteBuffer::has_member_write<T, void(T::*)(WriteBuffer&) const>::value &&
+			WriteBuffer::has_free_write<T>::value,
+				void (*)(WriteBuffer&, const void*)>::type getWriteToBufferFunction()
+		{
+			// Is class, doesn't have write member function but has free write function
+			return [](WriteBuffer& writeBuffer, const void* data)
+			{
+				const T& t = *((const T*)data);
+				writeToBuffer(writeBuffer, t);
+			};
+		}
+		template<typename T>
+		static typename std::enable_if<
+			std::is_class<T>::value &&
+			!WriteBuffer::has_member_write<T, void(T::*)(WriteBuffer&) const>::value &&
+			!WriteBuffer::has_free_write<T>::value &&
+			AggregateReflection::isReflectable<T>(),
+				void (*)(WriteBuffer&, const void*)>::type getWriteToBufferFunction()
+		{
+			// Is class, doesn't have write member function or free write function but is a reflectable aggregate
+			return [](WriteBuffer& writeBuffer, const void* data)
+			{
+				const T& t = *((const T*)data);
+				AggregateReflection::write(writeBuffer, t);
+			};
+		}
+		template<typename T>
+		static typename std::enable_if<
+			std::is_class<T>::value &&
+			!WriteBuffer::has_member_write<T, void(T::*)(WriteBuffer&) const>::value &&
+			!WriteBuffer::has_free_write<T>::value &&
+			!AggregateReflection::isReflectable<T>(),
+				void (*)(WriteBuffer&, const void*)>::type getWriteToBufferFunction()
+		{
+			// Is class, doesn't have write member function or free write function
+			return nullptr;
+		}
+
+		// Read from buffer
+		template<typename T>
+		static typename std::enable_if<
+			!std::is_class<T>::value,
+				bool (*)(ReadBuffer&, void*)>::type getReadFromBufferFunction()
+		{
+			// Is not class
+			return [](ReadBuffer& readBuffer, void* data)
+			{
+				T& t = *((T*)data);
+				return readBuffer.read(t);
+			};
+		}
+		template<typename T>
+		static typename std::enable_if<
+			std::is_class<T>::value &&
+			ReadBuffer::has_member_read<T, bool(T::*)(ReadBuffer&)>::value,
+				bool (*)(ReadBuffer&, void*)>::type getReadFromBufferFunction()
+		{
+			// Is class, has read member function
+			return [](ReadBuffer& readBuffer, void* data)
+			{
+				T& t = *((T*)data);
+				return t.read(readBuffer);
+			};
+		}
+		template<typename T>
+		static typename std::enable_if<
+			std::is_class<T>::value &&
+			!ReadBuffer::has_member_read<T, bool(T::*)(ReadBuffer&)>::value &&
+			ReadBuffer::has_free_read<T>::value,
+				bool (*)(ReadBuffer&, void*)>::type getReadFromBufferFunction()
+		{
+			// Is class, doesn't have read member function but has free read function
+			return [](ReadBuffer& readBuffer, void* data)
+			{
+				T& t = *((T*)data);
+				return readFromBuffer(readBuffer, t);
+			};
+		}
+		template<typename T>
+		static typename std::enable_if<
+			std::is_class<T>::value &&
+			!ReadBuffer::has_member_read<T, bool(T::*)(ReadBuffer&)>::value &&
+			!ReadBuffer::has_free_read<T>::value &&
+			AggregateReflection::isReflectable<T>(),
+				bool (*)(ReadBuffer&, void*)>::type getReadFromBufferFunction()
+		{
+			// Is class, doesn't have read member function or free read function but is a reflectable aggregate
+			return [](ReadBuffer& readBuffer, void* data)
+			{
+				T& t = *((T*)data);
+				return AggregateReflection::read(readBuffer, t);
+			};
+		}
+		template<typename T>
+		static typename std::enable_if<
+			std::is_class<T>::value &&
+			!ReadBuffer::has_member_read<T, bool(T::*)(ReadBuffer&)>::value &&
+			!ReadBuffer::has_free_read<T>::value &&
+			!AggregateReflection::isReflectable<T>(),
+				bool (*)(ReadBuffer&, void*)>::type getReadFromBufferFunction()
+		{
+			// Is class, doesn't have read member function or free read function
+			return nullptr;
+		}
+	};
+}
+
+// Gives a type a stable wire type id. Use in the global namespace.
+#define SE_TYPELESS_TYPE_NAME(p_Type, p_Name) \
+	namespace se \
+	{ \
+		template<> \
+		struct TypelessTypeName<p_Type> \
+		{ \
+			static constexpr const char* value = p_Name; \
+		}; \
+	}
+
+SE_TYPELESS_TYPE_NAME(bool, "bool")
+SE_TYPELESS_TYPE_NAME(char, "char")
+SE_TYPELESS_TYPE_NAME(int8_t, "int8")
+SE_TYPELESS_TYPE_NAME(int16_t, "int16")
+SE_TYPELESS_TYPE_NAME(int32_t, "int32")
+SE_TYPELESS_TYPE_NAME(int64_t, "int64")
+SE_TYPELESS_TYPE_NAME(uint8_t, "uint8")
+SE_TYPELESS_TYPE_NAME(uint16_t, "uint16")
+SE_TYPELESS_TYPE_NAME(uint32_t, "uint32")
+SE_TYPELESS_TYPE_NAME(uint64_t, "uint64")
+SE_TYPELESS_TYPE_NAME(float, "float")
+SE_TYPELESS_TYPE_NAME(double, "double")
+SE_TYPELESS_TYPE_NAME(std::string, "string")
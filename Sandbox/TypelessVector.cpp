@@ -0,0 +1,258 @@
+#include "stdafx.h"
+#include "Sandbox/TypelessVector.h"
+
+#include "SpehsEngine/Core/WriteBuffer.h"
+#include "SpehsEngine/Core/ReadBuffer.h"
+#include "SpehsEngine/Core/StringUtilityFunctions.h"
+#include "Sandbox/TypelessTypeDictionary.h"
+#include "Sandbox/VarInt.h"
+#include <algorithm>
+#include <limits>
+#include <new>
+
+
+namespace se
+{
+	namespace
+	{
+		// Returns nullptr if the allocation fails
+		std::byte* allocateSegment(const TypelessTypeInfo& typeInfo, const size_t capacity)
+		{
+			if (capacity > std::numeric_limits<size_t>::max() / std::max(size_t(1), typeInfo.size))
+			{
+				return nullptr;
+			}
+			if (typeInfo.alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+			{
+				return (std::byte*)::operator new(typeInfo.size * capacity, std::align_val_t(typeInfo.alignment), std::nothrow);
+			}
+			else
+			{
+				return (std::byte*)::operator new(typeInfo.size * capacity, std::nothrow);
+			}
+		}
+
+		void deallocateSegment(const TypelessTypeInfo& typeInfo, std::byte* const data, const size_t capacity)
+		{
+			if (typeInfo.alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+			{
+				::operator delete(data, typeInfo.size * capacity, std::align_val_t(typeInfo.alignment));
+			}
+			else
+			{
+				::operator delete(data, typeInfo.size * capacity);
+			}
+		}
+
+		void destructElements(const TypelessTypeInfo& typeInfo, std::byte* const data, const size_t count)
+		{
+			if (typeInfo.destruct)
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					typeInfo.destruct(data + i * typeInfo.size);
+				}
+			}
+		}
+	}
+
+	size_t TypelessVector::getCount() const
+	{
+		size_t count = 0;
+		for (const Segment& segment : segments)
+		{
+			count += segment.count;
+		}
+		return count;
+	}
+
+	void TypelessVector::clear()
+	{
+		for (Segment& segment : segments)
+		{
+			destructElements(*segment.typeInfo, segment.data, segment.count);
+			segment.count = 0;
+		}
+	}
+
+	void TypelessVector::shrink()
+	{
+		clear();
+		for (Segment& segment : segments)
+		{
+			if (segment.data)
+			{
+				deallocateSegment(*segment.typeInfo, segment.data, segment.capacity);
+			}
+		}
+		segments.clear();
+	}
+
+	TypelessVector::Segment& TypelessVector::findOrAddSegment(const TypelessTypeInfo& typeInfo)
+	{
+		if (Segment* const segment = findSegment(typeInfo))
+		{
+			return *segment;
+		}
+		segments.emplace_back();
+		segments.back().typeInfo = &typeInfo;
+		return segments.back();
+	}
+
+	bool TypelessVector::reserveImpl(Segment& segment, const size_t capacity)
+	{
+		if (capacity <= segment.capacity)
+		{
+			return true;
+		}
+		const TypelessTypeInfo& typeInfo = *segment.typeInfo;
+		if (segment.count > 0 && !typeInfo.triviallyCopyable && !typeInfo.relocate)
+		{
+			return false;
+		}
+		const size_t newCapacity = std::max(capacity, std::max(size_t(8), segment.capacity * 2));
+		std::byte* const newData = allocateSegment(typeInfo, newCapacity);
+		if (!newData)
+		{
+			return false;
+		}
+		if (segment.data)
+		{
+			if (typeInfo.triviallyCopyable)
+			{
+				memcpy(newData, segment.data, segment.count * typeInfo.size);
+			}
+			else
+			{
+				for (size_t i = 0; i < segment.count; i++)
+				{
+					typeInfo.relocate(newData + i * typeInfo.size, segment.data + i * typeInfo.size);
+				}
+			}
+			deallocateSegment(typeInfo, segment.data, segment.capacity);
+		}
+		segment.data = newData;
+		segment.capacity = newCapacity;
+		return true;
+	}
+
+	void TypelessVector::write(WriteBuffer& writeBuffer) const
+	{
+		writeImpl(writeBuffer, nullptr);
+	}
+
+	void TypelessVector::write(WriteBuffer& writeBuffer, const TypelessTypeDictionary& dictionary) const
+	{
+		writeImpl(writeBuffer, &dictionary);
+	}
+
+	bool TypelessVector::read(ReadBuffer& readBuffer)
+	{
+		return readImpl(readBuffer, nullptr);
+	}
+
+	bool TypelessVector::read(ReadBuffer& readBuffer, const TypelessTypeDictionary& dictionary)
+	{
+		return readImpl(readBuffer, &dictionary);
+	}
+
+	void TypelessVector::writeImpl(WriteBuffer& writeBuffer, const TypelessTypeDictionary* const dictionary) const
+	{
+		uint64_t segmentCount = 0;
+		for (const Segment& segment : segments)
+		{
+			if (segment.count > 0)
+			{
+				if (segment.typeInfo->isSerializable())
+				{
+					segmentCount++;
+				}
+				else
+				{
+					log::warning(formatString("Type is not serializable: %s. Skipping %zu TypelessVector elements.", segment.typeInfo->name, segment.count));
+				}
+			}
+		}
+
+		writeVarUInt(writeBuffer, segmentCount);
+		for (const Segment& segment : segments)
+		{
+			if (segment.count > 0 && segment.typeInfo->isSerializable())
+			{
+				const TypelessTypeInfo& typeInfo = *segment.typeInfo;
+				const bool typeWritten = dictionary
+					? dictionary->writeType(writeBuffer, &typeInfo)
+					: TypelessTypeInfo::writeType(writeBuffer, &typeInfo);
+				if (typeWritten)
+				{
+					writeVarUInt(writeBuffer, segment.count);
+					for (size_t i = 0; i < segment.count; i++)
+					{
+						typeInfo.writeToBufferFunction(writeBuffer, segment.data + i * typeInfo.size);
+					}
+				}
+			}
+		}
+	}
+
+	bool TypelessVector::readImpl(ReadBuffer& readBuffer, const TypelessTypeDictionary* const dictionary)
+	{
+		clear();
+		uint64_t segmentCount = 0;
+		if (!readVarUInt(readBuffer, segmentCount))
+		{
+			return false;
+		}
+		for (uint64_t s = 0; s < segmentCount; s++)
+		{
+			const TypelessTypeInfo* typeInfo = nullptr;
+			const bool typeRead = dictionary
+				? dictionary->readType(readBuffer, typeInfo)
+				: TypelessTypeInfo::readType(readBuffer, typeInfo);
+			if (!typeRead)
+			{
+				return false;
+			}
+			if (!typeInfo)
+			{
+				// The writer could not resolve the type header, nothing follows it
+				continue;
+			}
+			uint64_t count = 0;
+			if (!readVarUInt(readBuffer, count))
+			{
+				return false;
+			}
+
+			Segment& segment = findOrAddSegment(*typeInfo);
+			if (segment.count > 0 && !typeInfo->triviallyCopyable && !typeInfo->relocate)
+			{
+				log::warning(formatString("Type cannot be relocated: %s. It cannot be read into a TypelessVector.", typeInfo->name));
+				return false;
+			}
+			// Don't trust the count with more memory than the remaining bytes could hold, growth past that is geometric
+			const uint64_t maxReserveCount = uint64_t(readBuffer.getBytesRemaining() / std::max(size_t(1), typeInfo->size));
+			if (!reserveImpl(segment, segment.count + size_t(std::min(count, maxReserveCount))))
+			{
+				log::warning(formatString("Failed to allocate memory for %u elements of type: %s", unsigned(std::min(count, maxReserveCount)), typeInfo->name));
+				return false;
+			}
+			for (uint64_t i = 0; i < count; i++)
+			{
+				if (!reserveImpl(segment, segment.count + 1))
+				{
+					log::warning(formatString("Failed to allocate memory for %u elements of type: %s", unsigned(segment.count + 1), typeInfo->name));
+					return false;
+				}
+				std::byte* const element = segment.data + segment.count * typeInfo->size;
+				typeInfo->defaultConstructAt(element);
+				segment.count++;
+				if (!typeInfo->readFromBufferFunction(readBuffer, element))
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+}
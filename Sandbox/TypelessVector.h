@@ -0,0 +1,184 @@
+#pragma once
+
+#include "Sandbox/TypelessTypeInfo.h"
+#include <new>
+#include <vector>
+#include <stddef.h>
+
+
+namespace se
+{
+	class WriteBuffer;
+	class ReadBuffer;
+	class TypelessTypeDictionary;
+
+	/*
+		Heterogeneous container that stores its elements in one contiguous segment per type.
+		Iterating the elements of a type with visit<T>() touches a plain array, and the type header is written once per segment instead of once per element.
+		The relative order of elements is only kept between elements of the same type.
+		Elements may move when their segment grows, do not hold on to element pointers across insertions.
+	*/
+	class TypelessVector
+	{
+	public:
+
+		TypelessVector() = default;
+
+		~TypelessVector()
+		{
+			shrink();
+		}
+
+		TypelessVector(TypelessVector&& move)
+		{
+			std::swap(segments, move.segments);
+		}
+
+		void operator=(TypelessVector&& move)
+		{
+			std::swap(segments, move.segments);
+		}
+
+		TypelessVector(const TypelessVector& copy) = delete;
+		void operator=(const TypelessVector& copy) = delete;
+
+		template<typename T, typename... Args>
+		T& emplace(Args&&... args)
+		{
+			static_assert(std::is_nothrow_move_constructible<T>::value || std::is_trivially_copyable<T>::value,
+				"TypelessVector segments relocate their elements when growing.");
+			Segment& segment = findOrAddSegment(TypelessTypeInfo::get<T>());
+			if (!reserveImpl(segment, segment.count + 1))
+			{
+				throw std::bad_alloc();
+			}
+			T* const t = new (segment.data + segment.count * sizeof(T)) T(std::forward<Args>(args)...);
+			segment.count++;
+			return *t;
+		}
+
+		template<typename T>
+		T& push(T&& t)
+		{
+			return emplace<typename std::decay<T>::type>(std::forward<T>(t));
+		}
+
+		template<typename T>
+		void reserve(const size_t count)
+		{
+			reserveImpl(findOrAddSegment(TypelessTypeInfo::get<T>()), count);
+		}
+
+		// Calls function(T&) for each element of type T
+		template<typename T, typename Function>
+		void visit(Function&& function)
+		{
+			if (Segment* const segment = findSegment(TypelessTypeInfo::get<T>()))
+			{
+				T* const begin = (T*)segment->data;
+				T* const end = begin + segment->count;
+				for (T* t = begin; t != end; t++)
+				{
+					function(*t);
+				}
+			}
+		}
+
+		template<typename T, typename Function>
+		void visit(Function&& function) const
+		{
+			if (const Segment* const segment = findSegment(TypelessTypeInfo::get<T>()))
+			{
+				const T* const begin = (const T*)segment->data;
+				const T* const end = begin + segment->count;
+				for (const T* t = begin; t != end; t++)
+				{
+					function(*t);
+				}
+			}
+		}
+
+		// Calls a generic function for each element of the listed types, one type segment at a time
+		template<typename... Types, typename Function>
+		void forEach(Function&& function)
+		{
+			(visit<Types>(function), ...);
+		}
+
+		template<typename... Types, typename Function>
+		void forEach(Function&& function) const
+		{
+			(visit<Types>(function), ...);
+		}
+
+		// Returns the elements of type T as an array, nullptr if there are none
+		template<typename T>
+		T* getData(size_t& count)
+		{
+			Segment* const segment = findSegment(TypelessTypeInfo::get<T>());
+			count = segment ? segment->count : 0;
+			return segment ? (T*)segment->data : nullptr;
+		}
+
+		template<typename T>
+		size_t getCount() const
+		{
+			const Segment* const segment = findSegment(TypelessTypeInfo::get<T>());
+			return segment ? segment->count : 0;
+		}
+
+		size_t getCount() const;
+		inline size_t getSegmentCount() const { return segments.size(); }
+		inline bool isEmpty() const { return getCount() == 0; }
+
+		// Destructs all elements. Segment memory is kept for reuse.
+		void clear();
+		// Destructs all elements and releases all memory.
+		void shrink();
+
+		/*
+			Writes a varint segment count followed by each segment: type header, varint element count and the elements.
+			Segments of types that cannot be serialized are skipped with a warning.
+		*/
+		void write(WriteBuffer& writeBuffer) const;
+		void write(WriteBuffer& writeBuffer, const TypelessTypeDictionary& dictionary) const;
+		// Clears the container before reading
+		bool read(ReadBuffer& readBuffer);
+		bool read(ReadBuffer& readBuffer, const TypelessTypeDictionary& dictionary);
+
+	private:
+
+		struct Segment
+		{
+			const TypelessTypeInfo* typeInfo = nullptr;
+			std::byte* data = nullptr;
+			size_t count = 0;
+			size_t capacity = 0;
+		};
+
+		inline Segment* findSegment(const TypelessTypeInfo& typeInfo)
+		{
+			for (Segment& segment : segments)
+			{
+				if (segment.typeInfo == &typeInfo)
+				{
+					return &segment;
+				}
+			}
+			return nullptr;
+		}
+
+		inline const Segment* findSegment(const TypelessTypeInfo& typeInfo) const
+		{
+			return const_cast<TypelessVector*>(this)->findSegment(typeInfo);
+		}
+
+		Segment& findOrAddSegment(const TypelessTypeInfo& typeInfo);
+		// Returns false if the segment's elements cannot be relocated or the allocation fails
+		static bool reserveImpl(Segment& segment, const size_t capacity);
+		void writeImpl(WriteBuffer& writeBuffer, const TypelessTypeDictionary* const dictionary) const;
+		bool readImpl(ReadBuffer& readBuffer, const TypelessTypeDictionary* const dictionary);
+
+		std::vector<Segment> segments;
+	};
+}
@@ -0,0 +1,162 @@
+#include "stdafx.h"
+#include "Sandbox/TypelessView.h"
+
+#include "SpehsEngine/Core/WriteBuffer.h"
+#include "SpehsEngine/Core/ReadBuffer.h"
+#include "SpehsEngine/Core/StringUtilityFunctions.h"
+#include "Sandbox/TypelessAllocator.h"
+#include <new>
+#include <string.h>
+
+
+namespace se
+{
+	namespace
+	{
+		// Allocates memory that typeInfo.destroy() can release, which deletes the object as its own type
+		void* allocateObject(const TypelessTypeInfo& typeInfo)
+		{
+			if (typeInfo.alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+			{
+				return ::operator new(typeInfo.size, std::align_val_t(typeInfo.alignment));
+			}
+			else
+			{
+				return ::operator new(typeInfo.size);
+			}
+		}
+	}
+
+	/*
+		Format:
+		uint32_t typeId (0 = null)
+		uint32_t size
+		uint64_t layoutFingerprint
+		uint8_t padding
+		padding bytes, so that the object is aligned relative to the start of the buffer
+		size bytes of object memory
+	*/
+
+	void TypelessView::write(WriteBuffer& writeBuffer, const TypelessTypeInfo* const typeInfo, const void* const data)
+	{
+		if (typeInfo && data && !typeInfo->triviallyCopyable)
+		{
+			log::warning(formatString("Type is not trivially copyable: %s. Writing null to stream.", typeInfo->name));
+		}
+		if (typeInfo && data && typeInfo->hasPointers)
+		{
+			log::warning(formatString("Type holds pointers: %s. Writing null to stream.", typeInfo->name));
+		}
+		if (typeInfo && data && !typeInfo->registered)
+		{
+			log::error(formatString("Type is not registered because of a type id collision or a frozen type registry: %s. Writing null to stream.", typeInfo->name));
+			se_assert(false && "Writing an unregistered type.");
+		}
+		if (!typeInfo || !data || !typeInfo->triviallyCopyable || typeInfo->hasPointers || !typeInfo->registered)
+		{
+			writeBuffer.write(uint32_t(0));
+			return;
+		}
+
+		writeBuffer.write(typeInfo->typeId);
+		writeBuffer.write(uint32_t(typeInfo->size));
+		writeBuffer.write(typeInfo->layoutFingerprint);
+		const size_t objectOffset = writeBuffer.getOffset() + 1;
+		const uint8_t padding = uint8_t((typeInfo->alignment - objectOffset % typeInfo->alignment) % typeInfo->alignment);
+		writeBuffer.write(padding);
+		for (uint8_t i = 0; i < padding; i++)
+		{
+			writeBuffer.write(uint8_t(0));
+		}
+		writeBuffer.write(data, typeInfo->size);
+	}
+
+	void TypelessView::write(WriteBuffer& writeBuffer, const TypelessPointer& typelessPointer)
+	{
+		write(writeBuffer, typelessPointer.typeInfo, typelessPointer.data);
+	}
+
+	bool TypelessView::read(ReadBuffer& readBuffer)
+	{
+		reset();
+		uint32_t typeId = 0;
+		se_read(readBuffer, typeId);
+		if (typeId == 0)
+		{
+			return true;
+		}
+
+		uint32_t size = 0;
+		uint64_t layoutFingerprint = 0;
+		uint8_t padding = 0;
+		se_read(readBuffer, size);
+		se_read(readBuffer, layoutFingerprint);
+		se_read(readBuffer, padding);
+		if (readBuffer.getBytesRemaining() < size_t(padding) + size)
+		{
+			return false;
+		}
+		const std::byte* const objectData = (const std::byte*)readBuffer.getData() + readBuffer.getOffset() + padding;
+		// The object is skipped even if it cannot be viewed, so that the rest of the buffer can still be read
+		readBuffer.translate(int(padding + size));
+
+		const TypelessTypeInfo* const writtenTypeInfo = TypelessTypeInfo::find(typeId);
+		if (!writtenTypeInfo || !writtenTypeInfo->registered || !writtenTypeInfo->triviallyCopyable || writtenTypeInfo->hasPointers)
+		{
+			log::warning(formatString("Cannot view unknown, non trivially copyable or pointer holding type. Type id: %u", unsigned(typeId)));
+			return false;
+		}
+		if (size != writtenTypeInfo->size)
+		{
+			log::warning(formatString("Type size mismatch for %s. Local size: %u, written size: %u", writtenTypeInfo->name, unsigned(writtenTypeInfo->size), unsigned(size)));
+			return false;
+		}
+		if (layoutFingerprint != writtenTypeInfo->layoutFingerprint)
+		{
+			log::warning(formatString("Type layout mismatch for %s.", writtenTypeInfo->name));
+			return false;
+		}
+
+		typeInfo = writtenTypeInfo;
+		if (reinterpret_cast<uintptr_t>(objectData) % writtenTypeInfo->alignment == 0)
+		{
+			data = objectData;
+		}
+		else
+		{
+			// Trivially copyable, so copying the memory creates the object
+			void* const copy = allocateObject(*writtenTypeInfo);
+			memcpy(copy, objectData, size);
+			ownedData = std::shared_ptr<const void>(copy, writtenTypeInfo->destroy);
+			data = (const std::byte*)copy;
+		}
+		return true;
+	}
+
+	TypelessPointer TypelessView::toPointer() const
+	{
+		TypelessPointer typelessPointer;
+		if (data)
+		{
+			// Trivially copyable, so copying the memory creates the object. Released with typeInfo->destroy() by the pointer.
+			typelessPointer.data = (std::byte*)allocateObject(*typeInfo);
+			typelessPointer.typeInfo = typeInfo;
+			memcpy(typelessPointer.data, data, typeInfo->size);
+		}
+		return typelessPointer;
+	}
+
+	TypelessPointer TypelessView::toPointer(TypelessAllocator& allocator) const
+	{
+		TypelessPointer typelessPointer;
+		if (data)
+		{
+			// Trivially copyable, so copying the memory creates the object
+			typelessPointer.data = (std::byte*)allocator.allocate(typeInfo->size, typeInfo->alignment);
+			typelessPointer.typeInfo = typeInfo;
+			typelessPointer.allocator = &allocator;
+			memcpy(typelessPointer.data, data, typeInfo->size);
+		}
+		return typelessPointer;
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "Sandbox/TypelessTypeInfo.h"
+#include "Sandbox/TypelessPointer.h"
+#include <memory>
+#include <stddef.h>
+
+
+namespace se
+{
+	class WriteBuffer;
+	class ReadBuffer;
+	class TypelessAllocator;
+
+	/*
+		Non-owning, read only view to a trivially copyable object without pointers inside a received buffer.
+		Objects must be written with TypelessView::write(), which stores the object's memory as is, aligned relative to the start of the buffer.
+		read() validates the type id, size and layout fingerprint and then points straight into the buffer, nothing is constructed or copied.
+		The writer can only align the object relative to its own buffer. If the object ends up misaligned in memory on the receiving end,
+		for example behind a header or at an odd buffer address, read() falls back to an owned, aligned copy of the object.
+		The view is only valid for the lifetime of the buffer memory. Use toPointer() to keep the object longer than that.
+		The raw format assumes that both ends share the same endianness and type layout.
+	*/
+	class TypelessView
+	{
+	public:
+
+		// Writes null with a warning if the type is not trivially copyable or holds pointers
+		static void write(WriteBuffer& writeBuffer, const TypelessTypeInfo* const typeInfo, const void* const data);
+		static void write(WriteBuffer& writeBuffer, const TypelessPointer& typelessPointer);
+		template<typename T>
+		static void write(WriteBuffer& writeBuffer, const T& t)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "TypelessView requires trivially copyable types.");
+			static_assert(!AggregateReflection::hasPointers<T>(), "Pointers can't be viewed in another process.");
+			write(writeBuffer, &TypelessTypeInfo::get<T>(), &t);
+		}
+
+		bool read(ReadBuffer& readBuffer);
+
+		inline explicit operator bool() const
+		{
+			return data != nullptr;
+		}
+
+		inline bool hasValue() const
+		{
+			return data != nullptr;
+		}
+
+		template<typename T>
+		inline const T* get() const
+		{
+			if (typeInfo == &TypelessTypeInfo::get<T>())
+			{
+				return (const T*)data;
+			}
+			else
+			{
+				return nullptr;
+			}
+		}
+
+		inline const TypelessTypeInfo* getTypeInfo() const
+		{
+			return typeInfo;
+		}
+
+		inline const void* getData() const
+		{
+			return data;
+		}
+
+		// The object was misaligned in the read buffer and had to be copied
+		inline bool isCopy() const
+		{
+			return ownedData != nullptr;
+		}
+
+		// Copies the viewed object into an owning pointer
+		TypelessPointer toPointer() const;
+		TypelessPointer toPointer(TypelessAllocator& allocator) const;
+
+		void reset()
+		{
+			typeInfo = nullptr;
+			data = nullptr;
+			ownedData.reset();
+		}
+
+	private:
+
+		const TypelessTypeInfo* typeInfo = nullptr;
+		const std::byte* data = nullptr;
+		std::shared_ptr<const void> ownedData;
+	};
+}
@@ -0,0 +1,155 @@
+#include "stdafx.h"
+#include "Sandbox/UpdateLoop.h"
+
+#include <algorithm>
+
+
+namespace se
+{
+	UpdateLoop::UpdateLoop(const std::function<void()>& _update)
+		: UpdateLoop(_update, Settings())
+	{
+	}
+
+	UpdateLoop::UpdateLoop(const std::function<void()>& _update, const Settings& _settings)
+		: update(_update)
+		, settings(_settings)
+	{
+		se_assert(update);
+		se_assert(settings.minIdleWait <= settings.maxIdleWait);
+	}
+
+	bool UpdateLoop::waitAndUpdate(const Clock::duration timeout)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (stopRequested)
+			{
+				return false;
+			}
+		}
+
+		activity = false;
+		update();
+		runTimers();
+		updateCount++;
+
+		if (activity)
+		{
+			idleWait = Clock::duration::zero();
+		}
+		else
+		{
+			idleWait = idleWait == Clock::duration::zero()
+				? Clock::duration(settings.minIdleWait)
+				: std::min(idleWait * 2, Clock::duration(settings.maxIdleWait));
+		}
+
+		const Clock::time_point now = Clock::now();
+		const Clock::time_point waitEnd = getNextExpiry(now + std::min(idleWait, timeout));
+		std::unique_lock<std::mutex> lock(mutex);
+		if (waitEnd > now)
+		{
+			condition.wait_until(lock, waitEnd, [this]() { return wakeUpRequested || stopRequested; });
+		}
+		if (wakeUpRequested)
+		{
+			wakeUpRequested = false;
+			wakeUpCount++;
+			// Whoever woke the loop up has work for it
+			idleWait = Clock::duration::zero();
+		}
+		return !stopRequested;
+	}
+
+	void UpdateLoop::run()
+	{
+		while (waitAndUpdate(Clock::duration(settings.maxIdleWait)))
+		{
+		}
+	}
+
+	void UpdateLoop::stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopRequested = true;
+		}
+		condition.notify_one();
+	}
+
+	void UpdateLoop::wakeUp()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			wakeUpRequested = true;
+		}
+		condition.notify_one();
+	}
+
+	void UpdateLoop::notifyActivity()
+	{
+		activity = true;
+	}
+
+	UpdateLoop::TimerId UpdateLoop::addTimer(const Clock::duration delay, const std::function<void()>& callback, const Clock::duration interval)
+	{
+		se_assert(callback);
+		Timer& timer = timers.emplace_back();
+		timer.id = nextTimerId++;
+		timer.expiry = Clock::now() + delay;
+		timer.interval = interval;
+		timer.callback = callback;
+		return timer.id;
+	}
+
+	void UpdateLoop::removeTimer(const TimerId timerId)
+	{
+		timers.erase(std::remove_if(timers.begin(), timers.end(), [timerId](const Timer& timer) { return timer.id == timerId; }), timers.end());
+	}
+
+	void UpdateLoop::runTimers()
+	{
+		const Clock::time_point now = Clock::now();
+		expiredTimerIds.clear();
+		for (const Timer& timer : timers)
+		{
+			if (timer.expiry <= now)
+			{
+				expiredTimerIds.push_back(timer.id);
+			}
+		}
+
+		// Callbacks may add or remove timers, so each expired timer is looked up again before it runs
+		for (const TimerId timerId : expiredTimerIds)
+		{
+			const std::vector<Timer>::iterator it = std::find_if(timers.begin(), timers.end(), [timerId](const Timer& timer) { return timer.id == timerId; });
+			if (it == timers.end())
+			{
+				continue;
+			}
+			const std::function<void()> callback = it->callback;
+			if (it->interval > Clock::duration::zero())
+			{
+				// Skip missed expiries instead of running them back to back
+				it->expiry = std::max(it->expiry + it->interval, now);
+			}
+			else
+			{
+				timers.erase(it);
+			}
+			callback();
+			activity = true;
+		}
+	}
+
+	UpdateLoop::Clock::time_point UpdateLoop::getNextExpiry(const Clock::time_point limit) const
+	{
+		Clock::time_point nextExpiry = limit;
+		for (const Timer& timer : timers)
+		{
+			nextExpiry = std::min(nextExpiry, timer.expiry);
+		}
+		return nextExpiry;
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+
+
+namespace se
+{
+	/*
+		Drives a polled update function, like ConnectionManager2::update(), without spinning a core.
+		After an update the loop blocks until the next timer, an explicit wakeUp() or the idle poll interval, whichever comes first.
+		The idle poll interval starts at zero and doubles up to maxIdleWait while updates report no activity, so a busy loop polls continuously and an idle one costs next to nothing.
+		Activity is reported with notifyActivity(), typically from receive handlers that the update function invokes.
+		The worst case added latency for the first packet after an idle period is maxIdleWait.
+		run() and waitAndUpdate() must be called from a single thread. wakeUp() and stop() can be called from any thread.
+	*/
+	class UpdateLoop
+	{
+	public:
+
+		typedef std::chrono::steady_clock Clock;
+		typedef uint64_t TimerId;
+
+		struct Settings
+		{
+			std::chrono::microseconds minIdleWait = std::chrono::microseconds(50);	// First wait after the loop goes idle
+			std::chrono::microseconds maxIdleWait = std::chrono::milliseconds(5);
+		};
+
+		UpdateLoop(const std::function<void()>& update);
+		UpdateLoop(const std::function<void()>& update, const Settings& settings);
+
+		UpdateLoop(const UpdateLoop& copy) = delete;
+		void operator=(const UpdateLoop& copy) = delete;
+
+		// Runs the update function and expired timers, then waits for at most timeout. Returns false once stopped.
+		bool waitAndUpdate(const Clock::duration timeout);
+
+		// Calls waitAndUpdate() until stopped
+		void run();
+
+		void stop();
+
+		// Ends the current wait immediately
+		void wakeUp();
+
+		// Resets the idle backoff so that the next wait returns immediately
+		void notifyActivity();
+
+		// Timer callbacks run on the loop thread. A zero interval makes a one shot timer.
+		TimerId addTimer(const Clock::duration delay, const std::function<void()>& callback, const Clock::duration interval = Clock::duration::zero());
+		void removeTimer(const TimerId timerId);
+
+		inline uint64_t getUpdateCount() const
+		{
+			return updateCount;
+		}
+
+		inline uint64_t getWakeUpCount() const
+		{
+			return wakeUpCount;
+		}
+
+	private:
+
+		struct Timer
+		{
+			TimerId id = 0;
+			Clock::time_point expiry;
+			Clock::duration interval;
+			std::function<void()> callback;
+		};
+
+		void runTimers();
+		Clock::time_point getNextExpiry(const Clock::time_point limit) const;
+
+		const std::function<void()> update;
+		const Settings settings;
+		std::vector<Timer> timers;
+		std::vector<TimerId> expiredTimerIds;
+		TimerId nextTimerId = 1;
+		Clock::duration idleWait = Clock::duration::zero();
+		bool activity = false;
+		uint64_t updateCount = 0;
+		uint64_t wakeUpCount = 0;
+
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool wakeUpRequested = false;
+		bool stopRequested = false;
+	};
+}
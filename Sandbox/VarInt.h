@@ -0,0 +1,69 @@
+#pragma once
+
+#include "SpehsEngine/Core/WriteBuffer.h"
+#include "SpehsEngine/Core/ReadBuffer.h"
+#include <stdint.h>
+
+
+namespace se
+{
+	/*
+		LEB128 style variable length unsigned integers: 7 bits per byte, high bit set on all but the last byte.
+		Values below 128 take one byte, values below 16384 take two.
+	*/
+	inline void writeVarUInt(WriteBuffer& writeBuffer, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			writeBuffer.write(uint8_t(value | 0x80));
+			value >>= 7;
+		}
+		writeBuffer.write(uint8_t(value));
+	}
+
+	inline bool readVarUInt(ReadBuffer& readBuffer, uint64_t& value)
+	{
+		value = 0;
+		for (unsigned shift = 0; shift < 64; shift += 7)
+		{
+			uint8_t byte = 0;
+			if (!readBuffer.read(byte))
+			{
+				return false;
+			}
+			value |= uint64_t(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Maps signed integers to unsigned so that values close to zero encode short: 0, -1, 1, -2, 2... -> 0, 1, 2, 3, 4...
+	inline uint64_t zigzagEncode(const int64_t value)
+	{
+		return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+	}
+
+	inline int64_t zigzagDecode(const uint64_t value)
+	{
+		return int64_t(value >> 1) ^ -int64_t(value & 1);
+	}
+
+	inline void writeVarInt(WriteBuffer& writeBuffer, const int64_t value)
+	{
+		writeVarUInt(writeBuffer, zigzagEncode(value));
+	}
+
+	inline bool readVarInt(ReadBuffer& readBuffer, int64_t& value)
+	{
+		uint64_t encoded = 0;
+		if (!readVarUInt(readBuffer, encoded))
+		{
+			return false;
+		}
+		value = zigzagDecode(encoded);
+		return true;
+	}
+}
@@ -0,0 +1,117 @@
+#include "stdafx.h"
+#include "SandboxBenchmark/Benchmark.h"
+
+#include "SpehsEngine/Core/StringUtilityFunctions.h"
+#include "Sandbox/JsonUtilityFunctions.h"
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+
+namespace
+{
+	std::atomic<size_t> allocationCount = 0;
+	std::atomic<size_t> allocatedByteCount = 0;
+
+	void* countedAllocate(const size_t size)
+	{
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		allocatedByteCount.fetch_add(size, std::memory_order_relaxed);
+		if (void* const data = std::malloc(size ? size : 1))
+		{
+			return data;
+		}
+		throw std::bad_alloc();
+	}
+
+	void* countedAllocate(const size_t size, const std::align_val_t alignment)
+	{
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		allocatedByteCount.fetch_add(size, std::memory_order_relaxed);
+#ifdef _MSC_VER
+		if (void* const data = _aligned_malloc(size ? size : 1, size_t(alignment)))
+#else
+		if (void* const data = std::aligned_alloc(size_t(alignment), ((size ? size : 1) + size_t(alignment) - 1) / size_t(alignment) * size_t(alignment)))
+#endif
+		{
+			return data;
+		}
+		throw std::bad_alloc();
+	}
+
+	void countedDeallocate(void* const data, const std::align_val_t)
+	{
+#ifdef _MSC_VER
+		_aligned_free(data);
+#else
+		std::free(data);
+#endif
+	}
+}
+
+void* operator new(const size_t size) { return countedAllocate(size); }
+void* operator new[](const size_t size) { return countedAllocate(size); }
+void* operator new(const size_t size, const std::align_val_t alignment) { return countedAllocate(size, alignment); }
+void* operator new[](const size_t size, const std::align_val_t alignment) { return countedAllocate(size, alignment); }
+void operator delete(void* const data) noexcept { std::free(data); }
+void operator delete[](void* const data) noexcept { std::free(data); }
+void operator delete(void* const data, const size_t) noexcept { std::free(data); }
+void operator delete[](void* const data, const size_t) noexcept { std::free(data); }
+void operator delete(void* const data, const std::align_val_t alignment) noexcept { countedDeallocate(data, alignment); }
+void operator delete[](void* const data, const std::align_val_t alignment) noexcept { countedDeallocate(data, alignment); }
+void operator delete(void* const data, const size_t, const std::align_val_t alignment) noexcept { countedDeallocate(data, alignment); }
+void operator delete[](void* const data, const size_t, const std::align_val_t alignment) noexcept { countedDeallocate(data, alignment); }
+
+namespace benchmark
+{
+	volatile size_t sink = 0;
+
+	AllocationCounters getAllocationCounters()
+	{
+		AllocationCounters counters;
+		counters.allocations = allocationCount.load(std::memory_order_relaxed);
+		counters.allocatedBytes = allocatedByteCount.load(std::memory_order_relaxed);
+		return counters;
+	}
+
+	void logResults(const std::vector<Result>& results)
+	{
+		se::log::info(se::formatString("%-28s %-10s %-22s %10s %10s %12s %10s", "implementation", "type", "operation", "ns/op", "allocs/op", "alloc B/op", "wire B/op"));
+		for (const Result& result : results)
+		{
+			se::log::info(se::formatString("%-28s %-10s %-22s %10.2f %10.2f %12.1f %10.1f",
+				result.implementation.c_str(), result.type.c_str(), result.operation.c_str(),
+				result.nanosecondsPerOperation, result.allocationsPerOperation, result.allocatedBytesPerOperation, result.wireBytesPerOperation));
+		}
+	}
+
+	bool writeJson(const std::vector<Result>& results, const size_t iterations, const std::string& path)
+	{
+		std::ofstream file(path, std::ios::out | std::ios::trunc);
+		if (!file)
+		{
+			se::log::error("Failed to open benchmark output file: " + path);
+			return false;
+		}
+		file << "{\n";
+		file << "\t\"iterations\": " << iterations << ",\n";
+		file << "\t\"results\": [\n";
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const Result& result = results[i];
+			file << "\t\t{ "
+				<< "\"implementation\": \"" << se::escapeJson(result.implementation) << "\", "
+				<< "\"type\": \"" << se::escapeJson(result.type) << "\", "
+				<< "\"operation\": \"" << se::escapeJson(result.operation) << "\", "
+				<< "\"nsPerOp\": " << se::formatJsonNumber(result.nanosecondsPerOperation) << ", "
+				<< "\"allocationsPerOp\": " << se::formatJsonNumber(result.allocationsPerOperation) << ", "
+				<< "\"allocatedBytesPerOp\": " << se::formatJsonNumber(result.allocatedBytesPerOperation) << ", "
+				<< "\"wireBytesPerOp\": " << se::formatJsonNumber(result.wireBytesPerOperation)
+				<< " }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		file << "\t]\n";
+		file << "}\n";
+		return bool(file);
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+
+namespace benchmark
+{
+	// Global operator new/delete are replaced in Benchmark.cpp to count heap allocations
+	struct AllocationCounters
+	{
+		size_t allocations = 0;
+		size_t allocatedBytes = 0;
+	};
+	AllocationCounters getAllocationCounters();
+
+	struct Result
+	{
+		std::string implementation;
+		std::string type;
+		std::string operation;
+		double nanosecondsPerOperation = 0.0;
+		double allocationsPerOperation = 0.0;
+		double allocatedBytesPerOperation = 0.0;
+		double wireBytesPerOperation = 0.0;		// Serialized bytes, 0 for operations that don't serialize
+	};
+
+	// Prevents the optimizer from discarding benchmarked work
+	extern volatile size_t sink;
+
+	// Runs function(i) for each iteration and measures time and allocations per operation. operationsPerIteration divides the totals further.
+	template<typename Function>
+	Result measure(const char* const implementation, const char* const type, const char* const operation,
+		const size_t iterations, const size_t operationsPerIteration, Function&& function)
+	{
+		const AllocationCounters countersBegin = getAllocationCounters();
+		const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < iterations; i++)
+		{
+			function(i);
+		}
+		const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		const AllocationCounters countersEnd = getAllocationCounters();
+
+		const double operations = double(iterations) * double(operationsPerIteration);
+		Result result;
+		result.implementation = implementation;
+		result.type = type;
+		result.operation = operation;
+		result.nanosecondsPerOperation = double(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()) / operations;
+		result.allocationsPerOperation = double(countersEnd.allocations - countersBegin.allocations) / operations;
+		result.allocatedBytesPerOperation = double(countersEnd.allocatedBytes - countersBegin.allocatedBytes) / operations;
+		return result;
+	}
+
+	void logResults(const std::vector<Result>& results);
+	// Machine readable output for diffing runs. Returns false if the file could not be written.
+	bool writeJson(const std::vector<Result>& results, const size_t iterations, const std::string& path);
+}
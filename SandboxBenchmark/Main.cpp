@@ -0,0 +1,798 @@
+#include "stdafx.h"
+
+#include "SpehsEngine/Core/CoreLib.h"
+#include "SpehsEngine/Core/WriteBuffer.h"
+#include "SpehsEngine/Core/ReadBuffer.h"
+#include "SpehsEngine/Core/StringUtilityFunctions.h"
+#include "Sandbox/TypelessPointer.h"
+#include "Sandbox/SmallTypelessPointer.h"
+#include "Sandbox/TypelessArena.h"
+#include "Sandbox/TypelessObjectPool.h"
+#include "Sandbox/TypelessVector.h"
+#include "Sandbox/LazyTypelessPointer.h"
+#include "Sandbox/IntegerCoding.h"
+#include "Sandbox/ArraySerialization.h"
+#include "Sandbox/TypelessSnapshot.h"
+#include "SandboxBenchmark/Benchmark.h"
+#include <algorithm>
+#include <any>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <variant>
+
+
+namespace
+{
+	using benchmark::sink;
+
+	struct Message
+	{
+		void write(se::WriteBuffer& writeBuffer) const
+		{
+			writeBuffer.write(id);
+			writeBuffer.write(value);
+			writeBuffer.write(text);
+		}
+		bool read(se::ReadBuffer& readBuffer)
+		{
+			se_read(readBuffer, id);
+			se_read(readBuffer, value);
+			se_read(readBuffer, text);
+			return true;
+		}
+		uint32_t id = 0;
+		float value = 0.0f;
+		std::string text = "message";
+	};
+
+	/*
+		Replica of the previous TypelessPointer dispatch: per-operation hash map lookups and std::function calls.
+		Only kept here so that the benchmark can show the cost difference.
+	*/
+	class LegacyTypelessPointer
+	{
+	public:
+		~LegacyTypelessPointer()
+		{
+			reset();
+		}
+		template<typename T>
+		void reset(T* ptr)
+		{
+			reset();
+			typeHashCode = typeid(T).hash_code();
+			if (destructorFunctions.find(typeHashCode) == destructorFunctions.end())
+			{
+				typeNames[typeHashCode] = typeid(T).name();
+				defaultConstructorFunctions[typeHashCode] = [](LegacyTypelessPointer& typelessPointer)
+				{
+					typelessPointer.reset(new T());
+				};
+				destructorFunctions[typeHashCode] = [](void* data)
+				{
+					delete (T*)data;
+				};
+				writeToBufferFunctions[typeHashCode] = [](se::WriteBuffer& writeBuffer, const void* data)
+				{
+					writeBuffer.write(*(const T*)data);
+				};
+				readFromBufferFunctions[typeHashCode] = [](se::ReadBuffer& readBuffer, void* data)
+				{
+					return readBuffer.read(*(T*)data);
+				};
+			}
+			data = ptr;
+		}
+		void reset()
+		{
+			if (data)
+			{
+				const std::unordered_map<size_t, std::function<void(void*)>>::iterator destructorIt = destructorFunctions.find(typeHashCode);
+				destructorIt->second(data);
+				data = nullptr;
+				typeHashCode = 0;
+			}
+		}
+		template<typename T>
+		T* get()
+		{
+			return typeid(T).hash_code() == typeHashCode ? (T*)data : nullptr;
+		}
+		void write(se::WriteBuffer& writeBuffer) const
+		{
+			size_t writtenTypeHashCode = typeHashCode;
+			if (defaultConstructorFunctions.find(typeHashCode) == defaultConstructorFunctions.end())
+			{
+				writtenTypeHashCode = 0;
+			}
+			const std::unordered_map<size_t, std::function<void(se::WriteBuffer&, const void*)>>::iterator writeIt = writeToBufferFunctions.find(typeHashCode);
+			if (writeIt == writeToBufferFunctions.end() || readFromBufferFunctions.find(typeHashCode) == readFromBufferFunctions.end())
+			{
+				writtenTypeHashCode = 0;
+			}
+			writeBuffer.write(writtenTypeHashCode);
+			if (writtenTypeHashCode != 0)
+			{
+				writeIt->second(writeBuffer, data);
+			}
+		}
+		bool read(se::ReadBuffer& readBuffer)
+		{
+			size_t writtenTypeHashCode = 0;
+			se_read(readBuffer, writtenTypeHashCode);
+			defaultConstructorFunctions[writtenTypeHashCode](*this);
+			return readFromBufferFunctions[typeHashCode](readBuffer, data);
+		}
+	private:
+		size_t typeHashCode = 0;
+		void* data = nullptr;
+		static std::unordered_map<size_t, std::string> typeNames;
+		static std::unordered_map<size_t, std::function<void(LegacyTypelessPointer&)>> defaultConstructorFunctions;
+		static std::unordered_map<size_t, std::function<void(void*)>> destructorFunctions;
+		static std::unordered_map<size_t, std::function<void(se::WriteBuffer&, const void*)>> writeToBufferFunctions;
+		static std::unordered_map<size_t, std::function<bool(se::ReadBuffer&, void*)>> readFromBufferFunctions;
+	};
+	std::unordered_map<size_t, std::string> LegacyTypelessPointer::typeNames;
+	std::unordered_map<size_t, std::function<void(LegacyTypelessPointer&)>> LegacyTypelessPointer::defaultConstructorFunctions;
+	std::unordered_map<size_t, std::function<void(void*)>> LegacyTypelessPointer::destructorFunctions;
+	std::unordered_map<size_t, std::function<void(se::WriteBuffer&, const void*)>> LegacyTypelessPointer::writeToBufferFunctions;
+	std::unordered_map<size_t, std::function<bool(se::ReadBuffer&, void*)>> LegacyTypelessPointer::readFromBufferFunctions;
+
+	// Serialized type tags for the standard library alternatives, which have no type registry of their own
+	enum class TypeTag : uint8_t
+	{
+		None,
+		Int,
+		Message,
+	};
+	template<typename T> constexpr TypeTag getTypeTag();
+	template<> constexpr TypeTag getTypeTag<int>() { return TypeTag::Int; }
+	template<> constexpr TypeTag getTypeTag<Message>() { return TypeTag::Message; }
+
+	/*
+		Each implementation provides the same set of static operations so that they can be benchmarked by the same code.
+		"release" takes the object out of the pointer and destroys it, for std::any and std::variant this is a move out and reset.
+	*/
+	struct LegacyImplementation
+	{
+		static constexpr const char* name = "LegacyTypelessPointer";
+		static constexpr bool hasMoveAndRelease = false;
+		using Pointer = LegacyTypelessPointer;
+		template<typename T> static void assign(Pointer& pointer) { pointer.reset(new T()); }
+		template<typename T> static const T* get(Pointer& pointer) { return pointer.template get<T>(); }
+		static void write(const Pointer& pointer, se::WriteBuffer& writeBuffer) { pointer.write(writeBuffer); }
+		static bool read(Pointer& pointer, se::ReadBuffer& readBuffer) { return pointer.read(readBuffer); }
+	};
+
+	struct TypelessPointerImplementation
+	{
+		static constexpr const char* name = "TypelessPointer";
+		static constexpr bool hasMoveAndRelease = true;
+		using Pointer = se::TypelessPointer;
+		template<typename T> static void assign(Pointer& pointer) { pointer.reset(new T()); }
+		template<typename T> static const T* get(const Pointer& pointer) { return pointer.template get<T>(); }
+		template<typename T> static void release(Pointer& pointer) { delete pointer.template release<T>(); }
+		static void write(const Pointer& pointer, se::WriteBuffer& writeBuffer) { pointer.write(writeBuffer); }
+		static bool read(Pointer& pointer, se::ReadBuffer& readBuffer) { return pointer.read(readBuffer); }
+	};
+
+	struct SmallTypelessPointerImplementation
+	{
+		static constexpr const char* name = "SmallTypelessPointer<64>";
+		static constexpr bool hasMoveAndRelease = true;
+		using Pointer = se::SmallTypelessPointer<64>;
+		template<typename T> static void assign(Pointer& pointer) { pointer.template emplace<T>(); }
+		template<typename T> static const T* get(const Pointer& pointer) { return pointer.template get<T>(); }
+		template<typename T> static void release(Pointer& pointer) { delete pointer.template release<T>(); }
+		static void write(const Pointer& pointer, se::WriteBuffer& writeBuffer) { pointer.write(writeBuffer); }
+		static bool read(Pointer& pointer, se::ReadBuffer& readBuffer) { return pointer.read(readBuffer); }
+	};
+
+	struct AnyImplementation
+	{
+		static constexpr const char* name = "std::any";
+		static constexpr bool hasMoveAndRelease = true;
+		using Pointer = std::any;
+		template<typename T> static void assign(Pointer& pointer) { pointer.template emplace<T>(); }
+		template<typename T> static const T* get(const Pointer& pointer) { return std::any_cast<T>(&pointer); }
+		template<typename T> static void release(Pointer& pointer)
+		{
+			T t(std::move(*std::any_cast<T>(&pointer)));
+			pointer.reset();
+			sink = sink + sizeof(t);
+		}
+		static void write(const Pointer& pointer, se::WriteBuffer& writeBuffer)
+		{
+			if (const int* const i = std::any_cast<int>(&pointer))
+			{
+				writeBuffer.write(TypeTag::Int);
+				writeBuffer.write(*i);
+			}
+			else if (const Message* const message = std::any_cast<Message>(&pointer))
+			{
+				writeBuffer.write(TypeTag::Message);
+				message->write(writeBuffer);
+			}
+			else
+			{
+				writeBuffer.write(TypeTag::None);
+			}
+		}
+		static bool read(Pointer& pointer, se::ReadBuffer& readBuffer)
+		{
+			TypeTag typeTag = TypeTag::None;
+			se_read(readBuffer, typeTag);
+			switch (typeTag)
+			{
+			case TypeTag::None: pointer.reset(); return true;
+			case TypeTag::Int: return readBuffer.read(pointer.emplace<int>());
+			case TypeTag::Message: return pointer.emplace<Message>().read(readBuffer);
+			}
+			return false;
+		}
+	};
+
+	struct VirtualBase
+	{
+		virtual ~VirtualBase() = default;
+		virtual TypeTag getTypeTag() const = 0;
+		virtual void write(se::WriteBuffer& writeBuffer) const = 0;
+		virtual bool read(se::ReadBuffer& readBuffer) = 0;
+	};
+	template<typename T>
+	struct VirtualDerived : public VirtualBase
+	{
+		TypeTag getTypeTag() const override { return ::getTypeTag<T>(); }
+		void write(se::WriteBuffer& writeBuffer) const override { writeBuffer.write(value); }
+		bool read(se::ReadBuffer& readBuffer) override { return readBuffer.read(value); }
+		T value;
+	};
+	struct UniquePtrImplementation
+	{
+		static constexpr const char* name = "std::unique_ptr<Base>";
+		static constexpr bool hasMoveAndRelease = true;
+		using Pointer = std::unique_ptr<VirtualBase>;
+		template<typename T> static void assign(Pointer& pointer) { pointer.reset(new VirtualDerived<T>()); }
+		template<typename T> static const T* get(const Pointer& pointer)
+		{
+			const VirtualDerived<T>* const derived = dynamic_cast<const VirtualDerived<T>*>(pointer.get());
+			return derived ? &derived->value : nullptr;
+		}
+		template<typename T> static void release(Pointer& pointer) { delete pointer.release(); }
+		static void write(const Pointer& pointer, se::WriteBuffer& writeBuffer)
+		{
+			writeBuffer.write(pointer ? pointer->getTypeTag() : TypeTag::None);
+			if (pointer)
+			{
+				pointer->write(writeBuffer);
+			}
+		}
+		static bool read(Pointer& pointer, se::ReadBuffer& readBuffer)
+		{
+			TypeTag typeTag = TypeTag::None;
+			se_read(readBuffer, typeTag);
+			switch (typeTag)
+			{
+			case TypeTag::None: pointer.reset(); return true;
+			case TypeTag::Int: pointer.reset(new VirtualDerived<int>()); return pointer->read(readBuffer);
+			case TypeTag::Message: pointer.reset(new VirtualDerived<Message>()); return pointer->read(readBuffer);
+			}
+			return false;
+		}
+	};
+
+	struct VariantImplementation
+	{
+		static constexpr const char* name = "std::variant";
+		static constexpr bool hasMoveAndRelease = true;
+		using Pointer = std::variant<std::monostate, int, Message>;
+		template<typename T> static void assign(Pointer& pointer) { pointer.template emplace<T>(); }
+		template<typename T> static const T* get(const Pointer& pointer) { return std::get_if<T>(&pointer); }
+		template<typename T> static void release(Pointer& pointer)
+		{
+			T t(std::move(std::get<T>(pointer)));
+			pointer.template emplace<std::monostate>();
+			sink = sink + sizeof(t);
+		}
+		static void write(const Pointer& pointer, se::WriteBuffer& writeBuffer)
+		{
+			writeBuffer.write(TypeTag(pointer.index()));
+			if (const int* const i = std::get_if<int>(&pointer))
+			{
+				writeBuffer.write(*i);
+			}
+			else if (const Message* const message = std::get_if<Message>(&pointer))
+			{
+				message->write(writeBuffer);
+			}
+		}
+		static bool read(Pointer& pointer, se::ReadBuffer& readBuffer)
+		{
+			TypeTag typeTag = TypeTag::None;
+			se_read(readBuffer, typeTag);
+			switch (typeTag)
+			{
+			case TypeTag::None: pointer.emplace<std::monostate>(); return true;
+			case TypeTag::Int: return readBuffer.read(pointer.emplace<int>());
+			case TypeTag::Message: return pointer.emplace<Message>().read(readBuffer);
+			}
+			return false;
+		}
+	};
+
+	template<typename Implementation, typename T>
+	void benchmarkPointer(std::vector<benchmark::Result>& results, const char* const typeName, const size_t iterations)
+	{
+		using Pointer = typename Implementation::Pointer;
+		const char* const name = Implementation::name;
+
+		results.push_back(benchmark::measure(name, typeName, "construct+reset", iterations, 1, [](const size_t)
+			{
+				Pointer pointer;
+				Implementation::template assign<T>(pointer);
+			}));
+
+		Pointer pointer;
+		Implementation::template assign<T>(pointer);
+		results.push_back(benchmark::measure(name, typeName, "get", iterations, 1, [&pointer](const size_t)
+			{
+				sink = sink + size_t(Implementation::template get<T>(pointer) != nullptr);
+			}));
+
+		if constexpr (Implementation::hasMoveAndRelease)
+		{
+			results.push_back(benchmark::measure(name, typeName, "construct+release", iterations, 1, [](const size_t)
+				{
+					Pointer released;
+					Implementation::template assign<T>(released);
+					Implementation::template release<T>(released);
+				}));
+
+			Pointer other;
+			results.push_back(benchmark::measure(name, typeName, "move", iterations, 2, [&pointer, &other](const size_t)
+				{
+					other = std::move(pointer);
+					pointer = std::move(other);
+				}));
+			results.push_back(benchmark::measure(name, typeName, "swap", iterations, 1, [&pointer, &other](const size_t)
+				{
+					std::swap(pointer, other);
+				}));
+			if (Implementation::template get<T>(other))
+			{
+				std::swap(pointer, other);
+			}
+		}
+
+		se::WriteBuffer writeBuffer;
+		benchmark::Result writeResult = benchmark::measure(name, typeName, "write", iterations, 1, [&pointer, &writeBuffer](const size_t)
+			{
+				Implementation::write(pointer, writeBuffer);
+			});
+		writeResult.wireBytesPerOperation = double(writeBuffer.getSize()) / double(iterations);
+		results.push_back(writeResult);
+
+		se::ReadBuffer readBuffer(writeBuffer.getData(), writeBuffer.getSize());
+		benchmark::Result readResult = benchmark::measure(name, typeName, "read", iterations, 1, [&pointer, &readBuffer](const size_t)
+			{
+				const bool success = Implementation::read(pointer, readBuffer);
+				se_assert(success);
+				sink = sink + size_t(success);
+			});
+		readResult.wireBytesPerOperation = writeResult.wireBytesPerOperation;
+		results.push_back(readResult);
+	}
+
+	template<typename T>
+	void benchmarkPointers(std::vector<benchmark::Result>& results, const char* const typeName, const size_t iterations)
+	{
+		benchmarkPointer<LegacyImplementation, T>(results, typeName, iterations);
+		benchmarkPointer<TypelessPointerImplementation, T>(results, typeName, iterations);
+		benchmarkPointer<SmallTypelessPointerImplementation, T>(results, typeName, iterations);
+		benchmarkPointer<AnyImplementation, T>(results, typeName, iterations);
+		benchmarkPointer<UniquePtrImplementation, T>(results, typeName, iterations);
+		benchmarkPointer<VariantImplementation, T>(results, typeName, iterations);
+	}
+
+	// Materializes a packet of objects per iteration and releases them all at the end of the "tick"
+	template<typename T>
+	void benchmarkPacketRead(std::vector<benchmark::Result>& results, const char* const typeName, const size_t packetObjectCount, const size_t iterations)
+	{
+		se::WriteBuffer writeBuffer;
+		for (size_t i = 0; i < packetObjectCount; i++)
+		{
+			se::TypelessPointer pointer(new T());
+			pointer.write(writeBuffer);
+		}
+		std::vector<se::TypelessPointer> pointers(packetObjectCount);
+		const double wireBytesPerObject = double(writeBuffer.getSize()) / double(packetObjectCount);
+
+		results.push_back(benchmark::measure("TypelessPointer heap", typeName, "packet read", iterations, packetObjectCount, [&writeBuffer, &pointers](const size_t)
+			{
+				se::ReadBuffer readBuffer(writeBuffer.getData(), writeBuffer.getSize());
+				for (se::TypelessPointer& pointer : pointers)
+				{
+					pointer.read(readBuffer);
+				}
+				for (se::TypelessPointer& pointer : pointers)
+				{
+					pointer.reset();
+				}
+			}));
+		results.back().wireBytesPerOperation = wireBytesPerObject;
+
+		se::TypelessArena arena;
+		results.push_back(benchmark::measure("TypelessPointer arena", typeName, "packet read", iterations, packetObjectCount, [&writeBuffer, &pointers, &arena](const size_t)
+			{
+				se::ReadBuffer readBuffer(writeBuffer.getData(), writeBuffer.getSize());
+				for (se::TypelessPointer& pointer : pointers)
+				{
+					pointer.read(readBuffer, arena);
+				}
+				for (se::TypelessPointer& pointer : pointers)
+				{
+					pointer.reset();
+				}
+				arena.reset();
+			}));
+		results.back().wireBytesPerOperation = wireBytesPerObject;
+
+		se::TypelessObjectPool pool;
+		results.push_back(benchmark::measure("TypelessPointer pool", typeName, "packet read", iterations, packetObjectCount, [&writeBuffer, &pointers, &pool](const size_t)
+			{
+				se::ReadBuffer readBuffer(writeBuffer.getData(), writeBuffer.getSize());
+				for (se::TypelessPointer& pointer : pointers)
+				{
+					pointer.read(readBuffer, pool);
+				}
+				for (se::TypelessPointer& pointer : pointers)
+				{
+					pointer.reset();
+				}
+			}));
+		results.back().wireBytesPerOperation = wireBytesPerObject;
+	}
+
+	// Relays a packet of objects, reading and writing every object while only inspecting one of them
+	void benchmarkRelay(std::vector<benchmark::Result>& results, const size_t packetObjectCount, const size_t iterations)
+	{
+		se::WriteBuffer eagerBuffer;
+		se::WriteBuffer lazyBuffer;
+		for (size_t i = 0; i < packetObjectCount; i++)
+		{
+			const se::TypelessPointer pointer(new Message());
+			pointer.write(eagerBuffer);
+			se::LazyTypelessPointer::write(lazyBuffer, pointer);
+		}
+
+		std::vector<se::TypelessPointer> pointers(packetObjectCount);
+		results.push_back(benchmark::measure("TypelessPointer", "Message", "relay", iterations, packetObjectCount, [&eagerBuffer, &pointers](const size_t)
+			{
+				se::ReadBuffer readBuffer(eagerBuffer.getData(), eagerBuffer.getSize());
+				for (se::TypelessPointer& pointer : pointers)
+				{
+					pointer.read(readBuffer);
+				}
+				sink = sink + size_t(pointers.front().get<Message>()->id);
+				se::WriteBuffer writeBuffer;
+				for (const se::TypelessPointer& pointer : pointers)
+				{
+					pointer.write(writeBuffer);
+				}
+			}));
+		results.back().wireBytesPerOperation = double(eagerBuffer.getSize()) / double(packetObjectCount);
+
+		std::vector<se::LazyTypelessPointer> lazyPointers(packetObjectCount);
+		results.push_back(benchmark::measure("LazyTypelessPointer", "Message", "relay", iterations, packetObjectCount, [&lazyBuffer, &lazyPointers](const size_t)
+			{
+				se::ReadBuffer readBuffer(lazyBuffer.getData(), lazyBuffer.getSize());
+				for (se::LazyTypelessPointer& lazyPointer : lazyPointers)
+				{
+					lazyPointer.read(readBuffer);
+				}
+				sink = sink + size_t(lazyPointers.front().get<Message>()->id);
+				se::WriteBuffer writeBuffer;
+				for (const se::LazyTypelessPointer& lazyPointer : lazyPointers)
+				{
+					lazyPointer.write(writeBuffer);
+				}
+			}));
+		results.back().wireBytesPerOperation = double(lazyBuffer.getSize()) / double(packetObjectCount);
+	}
+
+	// Decodes a packet of sequential counters, like NetServer's continuous transfer mode sends
+	void benchmarkCounterDecode(std::vector<benchmark::Result>& results, const size_t valueCount, const size_t iterations)
+	{
+		std::vector<uint64_t> values(valueCount);
+		for (size_t i = 0; i < valueCount; i++)
+		{
+			values[i] = 1000000 + i;
+		}
+		std::vector<uint64_t> decoded(valueCount);
+
+		se::WriteBuffer rawBuffer;
+		for (const uint64_t value : values)
+		{
+			rawBuffer.write(value);
+		}
+		// Lower bound for every decoder below
+		results.push_back(benchmark::measure("memcpy", "uint64_t", "decode", iterations, valueCount, [&rawBuffer, &decoded](const size_t)
+			{
+				memcpy(decoded.data(), rawBuffer.getData(), decoded.size() * sizeof(uint64_t));
+				sink = sink + size_t(decoded.back());
+			}));
+		results.back().wireBytesPerOperation = double(rawBuffer.getSize()) / double(valueCount);
+		results.push_back(benchmark::measure("raw uint64_t", "uint64_t", "decode", iterations, valueCount, [&rawBuffer, &decoded](const size_t)
+			{
+				se::ReadBuffer readBuffer(rawBuffer.getData(), rawBuffer.getSize());
+				for (uint64_t& value : decoded)
+				{
+					readBuffer.read(value);
+				}
+				sink = sink + size_t(decoded.back());
+			}));
+		results.back().wireBytesPerOperation = double(rawBuffer.getSize()) / double(valueCount);
+
+		se::WriteBuffer varIntBuffer;
+		uint64_t previous = 0;
+		se::writeDeltaVarInts(varIntBuffer, values.data(), valueCount, previous);
+		results.push_back(benchmark::measure("delta varints", "uint64_t", "decode", iterations, valueCount, [&varIntBuffer, &decoded](const size_t)
+			{
+				se::ReadBuffer readBuffer(varIntBuffer.getData(), varIntBuffer.getSize());
+				uint64_t previousDecoded = 0;
+				se::readDeltaVarInts(readBuffer, decoded.data(), decoded.size(), previousDecoded);
+				sink = sink + size_t(decoded.back());
+			}));
+		results.back().wireBytesPerOperation = double(varIntBuffer.getSize()) / double(valueCount);
+
+		se::WriteBuffer blockBuffer;
+		previous = 0;
+		se::writeDeltaBlock(blockBuffer, values.data(), valueCount, previous);
+		results.push_back(benchmark::measure("delta block", "uint64_t", "decode", iterations, valueCount, [&blockBuffer, &decoded](const size_t)
+			{
+				se::ReadBuffer readBuffer(blockBuffer.getData(), blockBuffer.getSize());
+				uint64_t previousDecoded = 0;
+				se::readDeltaBlock(readBuffer, decoded, previousDecoded);
+				sink = sink + size_t(decoded.back());
+			}));
+		results.back().wireBytesPerOperation = double(blockBuffer.getSize()) / double(valueCount);
+	}
+
+	// Reads a float array payload element by element versus in bulk
+	void benchmarkArrayRead(std::vector<benchmark::Result>& results, const size_t valueCount, const size_t iterations)
+	{
+		std::vector<float> values(valueCount);
+		for (size_t i = 0; i < valueCount; i++)
+		{
+			values[i] = float(i) * 0.5f;
+		}
+		std::vector<float> decoded(valueCount);
+		se::WriteBuffer nativeBuffer;
+		se::writeArray(nativeBuffer, values);
+		se::WriteBuffer swappedBuffer;
+		se::writeArray(swappedBuffer, values, se::getNativeByteOrder() == se::ByteOrder::Little ? se::ByteOrder::Big : se::ByteOrder::Little);
+
+		results.push_back(benchmark::measure("per element", "float", "array read", iterations, valueCount, [&nativeBuffer, &decoded](const size_t)
+			{
+				se::ReadBuffer readBuffer(nativeBuffer.getData(), nativeBuffer.getSize());
+				for (float& value : decoded)
+				{
+					readBuffer.read(value);
+				}
+				sink = sink + size_t(decoded.back());
+			}));
+		results.push_back(benchmark::measure("bulk native order", "float", "array read", iterations, valueCount, [&nativeBuffer, &decoded](const size_t)
+			{
+				se::ReadBuffer readBuffer(nativeBuffer.getData(), nativeBuffer.getSize());
+				se::readArray(readBuffer, decoded.data(), decoded.size());
+				sink = sink + size_t(decoded.back());
+			}));
+		results.push_back(benchmark::measure("bulk swapped order", "float", "array read", iterations, valueCount, [&swappedBuffer, &decoded](const size_t)
+			{
+				se::ReadBuffer readBuffer(swappedBuffer.getData(), swappedBuffer.getSize());
+				se::readArray(readBuffer, decoded.data(), decoded.size(), se::getNativeByteOrder() == se::ByteOrder::Little ? se::ByteOrder::Big : se::ByteOrder::Little);
+				sink = sink + size_t(decoded.back());
+			}));
+	}
+
+	struct SnapshotTransform
+	{
+		float x = 0.0f;
+		float y = 0.0f;
+		float z = 0.0f;
+		uint32_t id = 0;
+	};
+
+	// Loads server state from a file with a full deserialization pass versus a mapped snapshot
+	void benchmarkSnapshotLoad(std::vector<benchmark::Result>& results, const size_t objectCount, const size_t iterations)
+	{
+		const std::filesystem::path directory = std::filesystem::temp_directory_path();
+		const std::string bufferPath = (directory / "sandbox_benchmark_state.bin").string();
+		const std::string snapshotPath = (directory / "sandbox_benchmark_state.snapshot").string();
+		{
+			se::WriteBuffer writeBuffer;
+			se::TypelessSnapshotWriter snapshotWriter;
+			for (size_t i = 0; i < objectCount; i++)
+			{
+				se::TypelessPointer pointer;
+				if (i % 4)
+				{
+					pointer.reset(new SnapshotTransform{ float(i), 0.0f, 0.0f, uint32_t(i) });
+				}
+				else
+				{
+					pointer.reset(new Message());
+				}
+				pointer.write(writeBuffer);
+				snapshotWriter.add(pointer);
+			}
+			std::ofstream file(bufferPath, std::ios::out | std::ios::binary | std::ios::trunc);
+			file.write((const char*)writeBuffer.getData(), std::streamsize(writeBuffer.getSize()));
+			if (!file.good() || !snapshotWriter.writeToFile(snapshotPath))
+			{
+				se::log::warning("Snapshot benchmark skipped, failed to write files.");
+				return;
+			}
+		}
+
+		results.push_back(benchmark::measure("read and deserialize", "SnapshotTransform", "state load", iterations, objectCount, [&bufferPath, objectCount](const size_t)
+			{
+				std::ifstream file(bufferPath, std::ios::in | std::ios::binary | std::ios::ate);
+				std::vector<char> bytes(size_t(file.tellg()));
+				file.seekg(0);
+				file.read(bytes.data(), std::streamsize(bytes.size()));
+				se::ReadBuffer readBuffer(bytes.data(), bytes.size());
+				std::vector<se::TypelessPointer> pointers(objectCount);
+				for (se::TypelessPointer& pointer : pointers)
+				{
+					pointer.read(readBuffer);
+				}
+				sink = sink + pointers.size();
+			}));
+		results.push_back(benchmark::measure("mapped snapshot", "SnapshotTransform", "state load", iterations, objectCount, [&snapshotPath](const size_t)
+			{
+				se::TypelessSnapshot snapshot;
+				snapshot.open(snapshotPath);
+				sink = sink + snapshot.getCount();
+			}));
+		results.push_back(benchmark::measure("mapped snapshot, touch all", "SnapshotTransform", "state load", iterations, objectCount, [&snapshotPath](const size_t)
+			{
+				se::TypelessSnapshot snapshot;
+				snapshot.open(snapshotPath);
+				for (size_t i = 0; i < snapshot.getCount(); i++)
+				{
+					if (const SnapshotTransform* const transform = snapshot.get<SnapshotTransform>(i))
+					{
+						sink = sink + transform->id;
+					}
+					else
+					{
+						sink = sink + size_t(snapshot.getData(i) != nullptr);
+					}
+				}
+			}));
+
+		std::error_code error;
+		std::filesystem::remove(bufferPath, error);
+		std::filesystem::remove(snapshotPath, error);
+	}
+
+	// Iterates and serializes a mixed event list stored per element versus per type segment
+	void benchmarkMixedEvents(std::vector<benchmark::Result>& results, const size_t eventCount, const size_t iterations)
+	{
+		std::vector<se::TypelessPointer> pointers;
+		se::TypelessVector typelessVector;
+		std::vector<int> ints;
+		std::vector<Message> messages;
+		for (size_t i = 0; i < eventCount; i++)
+		{
+			if (i % 2)
+			{
+				pointers.emplace_back(new int(int(i)));
+				typelessVector.emplace<int>(int(i));
+				ints.push_back(int(i));
+			}
+			else
+			{
+				pointers.emplace_back(new Message());
+				typelessVector.emplace<Message>();
+				messages.emplace_back();
+			}
+		}
+
+		se::WriteBuffer pointersBuffer;
+		for (const se::TypelessPointer& pointer : pointers)
+		{
+			pointer.write(pointersBuffer);
+		}
+		se::WriteBuffer typelessVectorBuffer;
+		typelessVector.write(typelessVectorBuffer);
+
+		results.push_back(benchmark::measure("std::vector<TypelessPointer>", "mixed", "iterate", iterations, eventCount, [&pointers](const size_t)
+			{
+				for (se::TypelessPointer& pointer : pointers)
+				{
+					if (const int* const i = pointer.get<int>())
+					{
+						sink = sink + size_t(*i);
+					}
+					else if (const Message* const message = pointer.get<Message>())
+					{
+						sink = sink + size_t(message->id);
+					}
+				}
+			}));
+		results.back().wireBytesPerOperation = double(pointersBuffer.getSize()) / double(eventCount);
+
+		results.push_back(benchmark::measure("TypelessVector", "mixed", "iterate", iterations, eventCount, [&typelessVector](const size_t)
+			{
+				typelessVector.visit<int>([](const int i) { sink = sink + size_t(i); });
+				typelessVector.visit<Message>([](const Message& message) { sink = sink + size_t(message.id); });
+			}));
+		results.back().wireBytesPerOperation = double(typelessVectorBuffer.getSize()) / double(eventCount);
+
+		results.push_back(benchmark::measure("std::vector<T>", "mixed", "iterate", iterations, eventCount, [&ints, &messages](const size_t)
+			{
+				for (const int i : ints)
+				{
+					sink = sink + size_t(i);
+				}
+				for (const Message& message : messages)
+				{
+					sink = sink + size_t(message.id);
+				}
+			}));
+	}
+}
+
+/*
+	Usage: SandboxBenchmark [--iterations <count>] [--json <path>]
+	Results are always logged, --json additionally writes them to a file that can be diffed against an earlier run.
+*/
+int main(int argc, char** argv)
+{
+	se::CoreLib core;
+
+	size_t iterations = 1000000;
+	std::string jsonPath;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string argument = argv[i];
+		if (argument == "--iterations" && i + 1 < argc)
+		{
+			iterations = size_t(std::max(1ll, std::atoll(argv[++i])));
+		}
+		else if (argument == "--json" && i + 1 < argc)
+		{
+			jsonPath = argv[++i];
+		}
+		else
+		{
+			se::log::error("Unknown argument: " + argument + ". Usage: SandboxBenchmark [--iterations <count>] [--json <path>]");
+			return 1;
+		}
+	}
+
+	std::vector<benchmark::Result> results;
+	benchmarkPointers<int>(results, "int", iterations);
+	benchmarkPointers<Message>(results, "Message", iterations);
+	benchmarkPacketRead<int>(results, "int", 256, std::max(size_t(1), iterations / 256));
+	benchmarkPacketRead<Message>(results, "Message", 256, std::max(size_t(1), iterations / 256));
+	benchmarkRelay(results, 256, std::max(size_t(1), iterations / 256));
+	benchmarkCounterDecode(results, 4096, std::max(size_t(1), iterations / 4096));
+	benchmarkArrayRead(results, 4096, std::max(size_t(1), iterations / 4096));
+	benchmarkMixedEvents(results, 100000, std::max(size_t(1), iterations / 10000));
+	benchmarkSnapshotLoad(results, 100000, std::max(size_t(1), iterations / 100000));
+
+	benchmark::logResults(results);
+	if (!jsonPath.empty() && !benchmark::writeJson(results, iterations, jsonPath))
+	{
+		return 1;
+	}
+	return 0;
+}
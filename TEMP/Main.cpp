@@ -31,6 +31,7 @@
 #include "SpehsEngine/Debug/DebugLib.h"
 #include "SpehsEngine/Debug/ScopeProfilerVisualizer.h"
 #include "SpehsEngine/Debug/ConnectionManagerVisualizer.h"
+#include "Sandbox/UpdateLoop.h"
 #include <set>
 
 
@@ -767,8 +768,10 @@ void runClient()
 	//std::shared_ptr<se::net::Connection2> connection = connectionManager.connect(se::net::Endpoint(se::net::Address("192.168.100.41"), se::net::Port(41623)));
 	if (connection)
 	{
-		connection->setReceiveHandler([](se::ReadBuffer& readBuffer, const bool reliable)
+		se::UpdateLoop updateLoop([&connectionManager]() { connectionManager.update(); });
+		connection->setReceiveHandler([&updateLoop](se::ReadBuffer& readBuffer, const bool reliable)
 			{
+				updateLoop.notifyActivity();
 				std::string message;
 				if (readBuffer.read(message))
 				{
@@ -776,10 +779,7 @@ void runClient()
 					//se::time::sleep(se::time::fromSeconds(0.2f));
 				}
 			});
-		while (true)
-		{
-			connectionManager.update();
-		}
+		updateLoop.run();
 	}
 	else
 	{
@@ -799,29 +799,46 @@ void runServer()
 	boost::signals2::scoped_connection incomingConnectionScopedConnection;
 	std::vector<std::shared_ptr<se::net::Connection2>> connections;
 	std::vector<std::shared_ptr<se::net::Connection2>> connectingConnections;
-	connectionManager.connectToIncomingConnectionSignal(incomingConnectionScopedConnection, [&connections, &connectingConnections](std::shared_ptr<se::net::Connection2>& connection)
+	std::vector<std::chrono::steady_clock::time_point> connectDeadlines; // Parallel to connectingConnections
+	connectionManager.connectToIncomingConnectionSignal(incomingConnectionScopedConnection, [&connections, &connectingConnections, &connectDeadlines](std::shared_ptr<se::net::Connection2>& connection)
 		{
 			connections.push_back(connection);
 			connectingConnections.push_back(connection);
+			connectDeadlines.push_back(std::chrono::steady_clock::now() + std::chrono::seconds(10));
 		});
-	while (true)
-	{
-		connectionManager.update();
-		for (size_t i = 0; i < connectingConnections.size(); i++)
+	// Sending keeps the loop active, otherwise it would back off to the idle poll interval
+	std::unique_ptr<se::UpdateLoop> updateLoop;
+	updateLoop = std::make_unique<se::UpdateLoop>([&connectionManager, &connectingConnections, &connectDeadlines, &updateLoop]()
 		{
-			if (connectingConnections[i]->isConnected())
+			connectionManager.update();
+			const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < connectingConnections.size(); i++)
 			{
-				std::string message = "welcome";
-				se::WriteBuffer writeBuffer;
-				writeBuffer.write(message);
-				connectingConnections[i]->sendPacket(writeBuffer, true);
-
+				if (connectingConnections[i]->isConnected())
+				{
+					std::string message = "welcome";
+					se::WriteBuffer writeBuffer;
+					writeBuffer.write(message);
+					connectingConnections[i]->sendPacket(writeBuffer, true);
+					updateLoop->notifyActivity();
+				}
+				else if (now < connectDeadlines[i])
+				{
+					continue;
+				}
+				else
+				{
+					// Connection2 can't tell a connection that is still connecting from one that has failed to connect
+					se::log::warning("Server: connection timed out while connecting.");
+				}
 				connectingConnections[i] = connectingConnections.back();
 				connectingConnections.pop_back();
+				connectDeadlines[i] = connectDeadlines.back();
+				connectDeadlines.pop_back();
 				i--;
 			}
-		}
-	}
+		});
+	updateLoop->run();
 }
 
 int main(int argc, const char* argv[])